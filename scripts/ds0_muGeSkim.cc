@@ -1,106 +1,135 @@
-void ds0_muGeSkim()
-{
-	TChain *skim = new TChain("skimTree");
-	skim->Add("~/dev/datasets/ds0/*.root");
-	long entries = skim->GetEntries();
-
-	// initialize
-	int run=0,event=0,mH=0,mL=0;
-	double startTime=0,stopTime=0,sumEH=0,sumEL=0;
-	vector<int> *channel=0,*gain=0,*str=0,*row=0,*mageID=0,*detID=0,*muType=0;
-	vector<bool> *isEnr=0,*isGood=0,*badScaler=0,*muVeto1ms=0;
-	vector<double> *trapECal=0,*aenorm=0,*toe=0,*trapETailMin=0,*tloc_s=0,*time_s=0,*mAct_g=0,*dtmu_s=0;
-	if(1){
-		skim->SetBranchAddress("run",&run);
-		skim->SetBranchAddress("startTime",&startTime);
-		skim->SetBranchAddress("stopTime",&stopTime);
-		skim->SetBranchAddress("event",&event);
-		skim->SetBranchAddress("trapECal",&trapECal);
-		skim->SetBranchAddress("aenorm",&aenorm);
-		skim->SetBranchAddress("toe",&toe);
-		skim->SetBranchAddress("trapETailMin",&trapETailMin);
-		skim->SetBranchAddress("sumEH",&sumEH);
-		skim->SetBranchAddress("mH",&mH);
-		skim->SetBranchAddress("sumEL",&sumEL);
-		skim->SetBranchAddress("mL",&mL);
-		skim->SetBranchAddress("tloc_s",&tloc_s);
-		skim->SetBranchAddress("time_s",&time_s);
-		skim->SetBranchAddress("channel",&channel);
-		skim->SetBranchAddress("gain",&gain);
-		skim->SetBranchAddress("str",&str);
-		skim->SetBranchAddress("row",&row);
-		skim->SetBranchAddress("mageID",&mageID);
-		skim->SetBranchAddress("detID",&detID);
-		// skim->SetBranchAddress("detName",&detName);
-		skim->SetBranchAddress("isEnr",&isEnr);
-		skim->SetBranchAddress("mAct_g",&mAct_g);
-		skim->SetBranchAddress("isGood",&isGood);
-		skim->SetBranchAddress("dtmu_s",&dtmu_s);
-		skim->SetBranchAddress("muType",&muType);
-		skim->SetBranchAddress("badScaler",&badScaler);
-		skim->SetBranchAddress("muVeto1ms",&muVeto1ms);
+// Calculate veto-germanium coincidence rate
+// for DS0 skim files.
+// Clint Wiseman, USC
+//
+// Only the columns used here are read (code/SkimReader.hh), and the files
+// are scanned in parallel, each into its own histograms.
+//   root[0] .X ds0_muGeSkim.cc+
+
+#include "TH1D.h"
+#include "TCanvas.h"
+#include "TLegend.h"
+#include "../vetoScan-dev/code/SkimReader.hh"
+#include "../vetoScan-dev/code/vetoHist.hh"
+using namespace std;
+
+// what each file adds up
+struct DS0Skim {
+	VetoHist mult_all, mult_veto, vetoSpec_hit, vetoSpec_sum;
+	int gEventsOver2650;	// total events over 2650
+	int vEventsOver2650;	// only veto coincidences
+	string log;
+	DS0Skim() : mult_all(21,0,21), mult_veto(21,0,21),
+		vetoSpec_hit(129,100,13000),	// 100 keV/bin
+		vetoSpec_sum(39,1000,40000),	// 1000 keV/bin
+		gEventsOver2650(0), vEventsOver2650(0) {}
+	void Add(const DS0Skim &o) {
+		mult_all.Add(o.mult_all); mult_veto.Add(o.mult_veto);
+		vetoSpec_hit.Add(o.vetoSpec_hit); vetoSpec_sum.Add(o.vetoSpec_sum);
+		gEventsOver2650 += o.gEventsOver2650;
+		vEventsOver2650 += o.vEventsOver2650;
 	}
+};
 
-	TH1D *mult_all = new TH1D("mult_all","",21,0,21);
-	TH1D *mult_veto = new TH1D("mult_veto","",21,0,21);
-
-	TH1D *vetoSpec_hit = new TH1D("hit","",129,100,13000);	// 100 keV/bin
-	TH1D *vetoSpec_sum = new TH1D("sum","",39,1000,40000);	// 1000 keV/bin
+void ds0_muGeSkim(int nThreads = 0)
+{
+	vector<string> files = SkimFiles("~/dev/datasets/ds0/*.root");
+	int nFiles = (int)files.size();
+	vector<DS0Skim> res(nFiles);
+	vector<long> nEntries(nFiles,0);
 
-	int gEventsOver2650 = 0;	// total events over 2650
-	int vEventsOver2650 = 0;	// only veto coincidences
-	for (long i = 0; i < entries; i++)
+	SkimParallel(nFiles, nThreads, [&](int f)
 	{
-		skim->GetEntry(i);
-
-		bool good = 0;
-		double dtmu = dtmu_s->at(0);
-		bool bads = badScaler->at(0);
-
-		for (int j = 0; j < (int)channel->size(); j++)
-		{
-			if (isGood->at(j)) good=1;
+		TFile *file = TFile::Open(files[f].c_str());
+		TTree *skim = (file != NULL) ? (TTree*)file->Get("skimTree") : NULL;
+		if (skim == NULL) {
+			printf("Couldn't read skimTree from %s\n",files[f].c_str());
+			if (file != NULL) delete file;
+			return;
+		}
+		SkimReader r(skim);
+		const int &run = r.Scalar<int>("run");
+		const int &event = r.Scalar<int>("event");
+		const int &mH = r.Scalar<int>("mH");
+		const int &mL = r.Scalar<int>("mL");
+		const double &sumEL = r.Scalar<double>("sumEL");
+		const vector<int> &channel = r.Vector<int>("channel");
+		const vector<bool> &isGood = r.Vector<bool>("isGood");
+		const vector<bool> &badScaler = r.Vector<bool>("badScaler");
+		const vector<double> &dtmu_s = r.Vector<double>("dtmu_s");
+		const vector<double> &trapECal = r.Vector<double>("trapECal");
+		if (!r.IsOK()) {
+			delete file;
+			return;
 		}
+		nEntries[f] = r.GetEntries();
+		DS0Skim &h = res[f];
+		char line[300];
 
-		if(good && sumEL > 1000) {
-			mult_all->Fill(mL);
+		while (r.Next())
+		{
+			bool good = 0;
+			double dtmu = dtmu_s[0];
+			bool bads = badScaler[0];
 
-			if (dtmu > -0.2e-3 && dtmu < 1)
+			for (int j = 0; j < (int)channel.size(); j++)
 			{
-				mult_veto->Fill(mL);
+				if (isGood[j]) good=1;
 			}
 
-			// what's that weird event?
-			if (mH > 15){
-				printf("run %i  event %i  dtmu_s %.2f  badScaler %i  mL %i  sumEL %.2f\n",run,event,dtmu,bads,mL,sumEL);
-			}
-		}
+			if(good && sumEL > 1000) {
+				h.mult_all.Fill(mL);
 
-		if (dtmu > -0.2e-3 && dtmu < 1 && good)
-		{
-			if (mL !=0) {
-				// printf("run %i  dtmu %.3f  mL %i  sumEL %.2f\n",run,dtmu,mL,sumEL);
-				vetoSpec_sum->Fill(sumEL);
+				if (dtmu > -0.2e-3 && dtmu < 1)
+				{
+					h.mult_veto.Fill(mL);
+				}
+
+				// what's that weird event?
+				if (mH > 15){
+					sprintf(line,"run %i  event %i  dtmu_s %.2f  badScaler %i  mL %i  sumEL %.2f\n",run,event,dtmu,bads,mL,sumEL);
+					h.log += line;
+				}
 			}
 
-			int chans = (int)channel->size();
-			for (int j = 0; j < chans; j++)
+			if (dtmu > -0.2e-3 && dtmu < 1 && good)
 			{
-				if ((int)channel->at(j)%2==1)	// low gain channels only
+				if (mL !=0) {
+					h.vetoSpec_sum.Fill(sumEL);
+				}
+
+				int chans = (int)channel.size();
+				for (int j = 0; j < chans; j++)
 				{
-					vetoSpec_hit->Fill(trapECal->at(j));
+					if (channel[j]%2==1)	// low gain channels only
+					{
+						h.vetoSpec_hit.Fill(trapECal[j]);
+					}
 				}
+
+				if (sumEL > 2650) h.vEventsOver2650++;
 			}
 
-			if (sumEL > 2650) vEventsOver2650++;
+			if (sumEL > 2650 && good) h.gEventsOver2650++;
 		}
-		else if (!badScaler) cout << " bad scaler ! " << endl;
-
-		if (sumEL > 2650 && good) gEventsOver2650++;
+		delete file;
+	});
+
+	// add up the files in order
+	DS0Skim tot;
+	long entries = 0;
+	for (int f = 0; f < nFiles; f++) {
+		cout << res[f].log;
+		tot.Add(res[f]);
+		entries += nEntries[f];
 	}
+	TH1D *mult_all = tot.mult_all.ToTH1D("mult_all");
+	TH1D *mult_veto = tot.mult_veto.ToTH1D("mult_veto");
+	TH1D *vetoSpec_hit = tot.vetoSpec_hit.ToTH1D("hit");
+	TH1D *vetoSpec_sum = tot.vetoSpec_sum.ToTH1D("sum");
 
-	printf("Done with scan.\n");
-	printf("Total events over 2650: %i  Veto-Coin events over 2650: %i\n",gEventsOver2650,vEventsOver2650);
+	printf("Done with scan.  %li entries in %i files.\n",entries,nFiles);
+	printf("Total events over 2650: %i  Veto-Coin events over 2650: %i\n",tot.gEventsOver2650,tot.vEventsOver2650);
 
 	// ================== make some plots ====================
 
@@ -2,102 +2,110 @@
 // for DS1 skim files.
 // Clint Wiseman, USC
 // 5/29/16
+//
+// Only the columns used here are read (code/SkimReader.hh), and the files
+// are scanned in parallel, each into its own histograms.
+//   root[0] .X ds1_muGeSkim.cc+
 
-void ds1_muGeSkim()
-{
-	TChain *skim = new TChain("skimTree");
-	skim->Add("~/dev/datasets/ds1/*.root");
-	long entries = skim->GetEntries();
-	printf("Scanning skim files ... \nFound %li entries.\n",entries);
+#include "TH1D.h"
+#include "TCanvas.h"
+#include "../vetoScan-dev/code/SkimReader.hh"
+#include "../vetoScan-dev/code/vetoHist.hh"
+using namespace std;
 
-	// skim file branches.
-	// May 2016 version.
-	unsigned int gatrev=0,EventDC1Bits=0;
-	int run=0,iEvent=0,mH=0,mL=0;
-	double startTime=0,stopTime=0,sumEH=0,sumEL=0;
-	vector<int> *iHit=0,*channel=0,*P=0,*D=0,*gain=0,*mageID=0,*detID=0,*dateMT=0,*muType=0;
-	vector<double> *mAct_g=0,*tloc_s=0,*time_s=0,*timeMT=0,*trapECal=0,*trapENFCal=0,*aenorm=0,*kvorrT=0,*toe=0,*dcrSlope95=0,*dcrSlope99=0,*trapETailMin=0,*dtmu_s=0,*trap4usMax=0,*t150=0;
-	vector<bool> *isEnr=0,*isNat=0,*isGood=0,*isLNFill=0,*badScaler=0,*muVeto1ms=0;
-	// vector<string> *detName;
-	if (1) {
-		vector<unsigned int> *wfDCBits=0;
-		skim->SetBranchAddress("gatrev",&gatrev);
-		skim->SetBranchAddress("EventDC1Bits",&EventDC1Bits);
-		skim->SetBranchAddress("run",&run);
-		skim->SetBranchAddress("iEvent",&iEvent);
-		skim->SetBranchAddress("mH",&mH);
-		skim->SetBranchAddress("mL",&mL);
-		skim->SetBranchAddress("t150",&t150);
-		skim->SetBranchAddress("startTime",&startTime);
-		skim->SetBranchAddress("stopTime",&stopTime);
-		skim->SetBranchAddress("sumEH",&sumEH);
-		skim->SetBranchAddress("sumEL",&sumEL);
-		skim->SetBranchAddress("iHit",&iHit);
-		skim->SetBranchAddress("channel",&channel);
-		skim->SetBranchAddress("P",&P);
-		skim->SetBranchAddress("D",&D);
-		skim->SetBranchAddress("gain",&gain);
-		skim->SetBranchAddress("mageID",&mageID);
-		skim->SetBranchAddress("detID",&detID);
-		skim->SetBranchAddress("dateMT",&dateMT);
-		skim->SetBranchAddress("muType",&muType);
-		skim->SetBranchAddress("mAct_g",&mAct_g);
-		skim->SetBranchAddress("tloc_s",&tloc_s);
-		skim->SetBranchAddress("time_s",&time_s);
-		skim->SetBranchAddress("timeMT",&timeMT);
-		skim->SetBranchAddress("trapECal",&trapECal);
-		skim->SetBranchAddress("trapENFCal",&trapENFCal);
-		skim->SetBranchAddress("trap4usMax",&trap4usMax);
-		skim->SetBranchAddress("aenorm",&aenorm);
-		skim->SetBranchAddress("kvorrT",&kvorrT);  // in GAT: trirt100nsft10nsMax / trapECal 
-		skim->SetBranchAddress("toe",&toe);
-		skim->SetBranchAddress("dcrSlope95",&dcrSlope95);
-		skim->SetBranchAddress("dcrSlope99",&dcrSlope99);
-		skim->SetBranchAddress("trapETailMin",&trapETailMin);	// events with positive trapETailMin are removed
-		skim->SetBranchAddress("dtmu_s",&dtmu_s);
-		skim->SetBranchAddress("isEnr",&isEnr);
-		skim->SetBranchAddress("isNat",&isNat);
-		skim->SetBranchAddress("isGood",&isGood);
-		skim->SetBranchAddress("isLNFill",&isLNFill);
-		skim->SetBranchAddress("badScaler",&badScaler);
-		skim->SetBranchAddress("muVeto1ms",&muVeto1ms);
+// what each file adds up
+struct DS1Skim {
+	VetoHist vetoSpec_hit, vetoSpec_sum;
+	int gEventsOver2650;	// total events over 2650
+	int vEventsOver2650;	// only veto coincidences
+	string log;
+	DS1Skim() : vetoSpec_hit(129,100,13000),	// 100 keV/bin
+		vetoSpec_sum(39,1000,40000),	// 1000 keV/bin
+		gEventsOver2650(0), vEventsOver2650(0) {}
+	void Add(const DS1Skim &o) {
+		vetoSpec_hit.Add(o.vetoSpec_hit); vetoSpec_sum.Add(o.vetoSpec_sum);
+		gEventsOver2650 += o.gEventsOver2650;
+		vEventsOver2650 += o.vEventsOver2650;
 	}
+};
 
-	TH1D *vetoSpec_hit = new TH1D("h0","",129,100,13000);	// 100 keV/bin
-	TH1D *vetoSpec_sum = new TH1D("h0","",39,1000,40000);	// 1000 keV/bin
+void ds1_muGeSkim(int nThreads = 0)
+{
+	vector<string> files = SkimFiles("~/dev/datasets/ds1/*.root");
+	int nFiles = (int)files.size();
+	vector<DS1Skim> res(nFiles);
+	vector<long> nEntries(nFiles,0);
 
-	int gEventsOver2650 = 0;	// total events over 2650
-	int vEventsOver2650 = 0;	// only veto coincidences
-	for (long i = 0; i < entries; i++)
+	SkimParallel(nFiles, nThreads, [&](int f)
 	{
-		skim->GetEntry(i);
-		double dtmu = dtmu_s->at(0);
+		TFile *file = TFile::Open(files[f].c_str());
+		TTree *skim = (file != NULL) ? (TTree*)file->Get("skimTree") : NULL;
+		if (skim == NULL) {
+			printf("Couldn't read skimTree from %s\n",files[f].c_str());
+			if (file != NULL) delete file;
+			return;
+		}
+		// skim file branches.
+		// May 2016 version.
+		SkimReader r(skim);
+		const unsigned int &EventDC1Bits = r.Scalar<unsigned int>("EventDC1Bits");
+		const int &run = r.Scalar<int>("run");
+		const int &mL = r.Scalar<int>("mL");
+		const double &sumEL = r.Scalar<double>("sumEL");
+		const vector<int> &channel = r.Vector<int>("channel");
+		const vector<double> &dtmu_s = r.Vector<double>("dtmu_s");
+		const vector<double> &trapENFCal = r.Vector<double>("trapENFCal");
+		if (!r.IsOK()) {
+			delete file;
+			return;
+		}
+		nEntries[f] = r.GetEntries();
+		DS1Skim &h = res[f];
+		char line[300];
 
-		if (dtmu > -0.2e-3 && dtmu < 1 && EventDC1Bits==0)
+		while (r.Next())
 		{
-			if (mL !=0) {
-				printf("run %i  dtmu %.3f  mL %i  sumEL %.2f\n",run,dtmu,mL,sumEL);
-				vetoSpec_sum->Fill(sumEL);
-			}
+			double dtmu = dtmu_s[0];
 
-			int chans = (int)channel->size();
-			for (int j = 0; j < chans; j++)
+			if (dtmu > -0.2e-3 && dtmu < 1 && EventDC1Bits==0)
 			{
-				if ((int)channel->at(j)%2==1)	// low gain channels only
+				if (mL !=0) {
+					sprintf(line,"run %i  dtmu %.3f  mL %i  sumEL %.2f\n",run,dtmu,mL,sumEL);
+					h.log += line;
+					h.vetoSpec_sum.Fill(sumEL);
+				}
+
+				int chans = (int)channel.size();
+				for (int j = 0; j < chans; j++)
 				{
-					vetoSpec_hit->Fill(trapENFCal->at(j));
+					if (channel[j]%2==1)	// low gain channels only
+					{
+						h.vetoSpec_hit.Fill(trapENFCal[j]);
+					}
 				}
+
+				if (sumEL > 2650) h.vEventsOver2650++;
 			}
 
-			if (sumEL > 2650) vEventsOver2650++;
+			if (sumEL > 2650 && EventDC1Bits==0) h.gEventsOver2650++;
 		}
-		else if (!badScaler) cout << " bad scaler ! " << endl;
+		delete file;
+	});
 
-		if (sumEL > 2650 && EventDC1Bits==0) gEventsOver2650++;
+	// add up the files in order
+	DS1Skim tot;
+	long entries = 0;
+	for (int f = 0; f < nFiles; f++) {
+		cout << res[f].log;
+		tot.Add(res[f]);
+		entries += nEntries[f];
 	}
+	TH1D *vetoSpec_hit = tot.vetoSpec_hit.ToTH1D("h0");
+	TH1D *vetoSpec_sum = tot.vetoSpec_sum.ToTH1D("h1");
+	printf("Scanning skim files ... \nFound %li entries.\n",entries);
 
 	printf("Done with scan.\n");
-	printf("Total events over 2650: %i  Veto-Coin events over 2650: %i\n",gEventsOver2650,vEventsOver2650);
+	printf("Total events over 2650: %i  Veto-Coin events over 2650: %i\n",tot.gEventsOver2650,tot.vEventsOver2650);
 
 	// ============= make some plots ==============
 
@@ -4,6 +4,9 @@
 //
 // To be used in auto-processing, run by run.
 // Takes one input argument, a run number.
+// With -w, follows a data directory and checks each run as it finishes,
+// appending a line per run to ./vetoCheck_follow.txt.  Each run starts from
+// the one before it, so its entries are read once (see the first loop).
 //
 // Known Error types:
 // 1. Missing channels (< 32 veto datas in event)
@@ -45,20 +48,52 @@
 #include "TLine.h"
 #include "MJVetoEvent.hh"
 #include "GATDataSet.hh"
+#include "../vetoScan-dev/code/RunWatcher.hh"
+#include "../vetoScan-dev/code/VetoSource.hh"
+#include "../vetoScan-dev/code/vetoHist.hh"
+#include "../vetoScan-dev/code/vetoErrorPolicy.hh"
+#include "../vetoScan-dev/code/VetoSnapshot.hh"
+#include "../vetoScan-dev/code/RunState.hh"
+#include "../vetoScan-dev/code/CounterCheck.hh"
 
 using namespace std;
 
-bool CheckForBadErrors(MJVetoEvent veto, int entry, int isGood, bool verbose);
 double InterpTime(int entry, vector<double> times, vector<double> entries, vector<bool> badScaler);
 int FindQDCThreshold(TH1F *qdcHist);
-void vetoCheck(int run, bool draw);
+int vetoCheck(int run, bool draw, RunState *state = NULL, string built = "");
+VetoErrorPolicy& GetErrorPolicy();
 
 int main(int argc, char* argv[])
 {
 	if (argc < 2) {
-		cout << "Usage:\n ./vetoCheck [run number] ([-d] draws qdc plot)\n\n";
+		cout << "Usage:\n ./vetoCheck [run number] ([-d] draws qdc plot)\n"
+			 << " ./vetoCheck -w [data directory] ([first run])  follows the directory\n\n";
 		return 1;
 	}
+
+	// Which errors make an entry unusable ("vetoCheck" entry of vetoErrorPolicy.txt, or "default")
+	GetErrorPolicy().Load("vetoCheck");
+
+	// Live-follow mode: check runs as they land.
+	string mode = argv[1];
+	if (mode == "-w" && argc > 2)
+	{
+		int firstRun = 0;
+		if (argc > 3) firstRun = atoi(argv[3]);
+		RunWatcher follow(argv[2],firstRun);
+		ofstream summary("vetoCheck_follow.txt",ios::app);
+		int run = 0;
+		RunState last;
+		RunWatcher::RunFiles files;
+		while (follow.Next(run,&files)) {
+			int serious = vetoCheck(run,false,&last,files.built);	// read from the watched directory
+			summary << run << " " << serious << " " << (serious > 0 ? "BAD" : "OK") << endl;
+			cout.flush();
+		}
+		summary.close();
+		return 0;
+	}
+
 	int run = atoi(argv[1]);
 
 	bool draw = false;
@@ -70,7 +105,7 @@ int main(int argc, char* argv[])
 	vetoCheck(run,draw);
 }
 
-void vetoCheck(int run, bool draw)
+int vetoCheck(int run, bool draw, RunState *state, string built)
 {
 	const int nErrs = 29; // error 0 is unused
 	int SeriousErrorCount = 0;
@@ -80,7 +115,7 @@ void vetoCheck(int run, bool draw)
 	// Specify which error types to print during the loop over events
 	vector<int> SeriousErrors = {1, 13, 14, 18, 19, 20, 21, 22, 23, 24};
 
-	GATDataSet *ds = new GATDataSet(run);
+	VetoSource *ds = new VetoSource(run,built);	// built "": GATDataSet finds the run
 	TChain *v = ds->GetVetoChain();
 	long vEntries = v->GetEntries();
 
@@ -116,10 +151,16 @@ void vetoCheck(int run, bool draw)
 		sprintf(hname,"hRunQDC%d",i);
 		hRunQDC[i] = new TH1F(hname,hname,4200,0,4200);
 	}
-
-	MJVetoEvent prev;
-	MJVetoEvent first;
-	MJVetoEvent last;
+	VetoHistSet runQDC(32,4200,0,4200);	// copied into hRunQDC after the loop
+	int qdc[32];
+
+	VetoRing<2> measureHistory;	// previous good entries
+	CounterCheck counters;		// every entry's event counts, for errors 18-24
+	counters.Reserve(vEntries);
+	VetoSnapshot first;
+	VetoSnapshot last;
+	first.Clear();
+	last.Clear();
 	bool foundFirst = false;
 	bool foundFirstSTS = false;
 	int firstGoodEntry = 0;
@@ -130,19 +171,23 @@ void vetoCheck(int run, bool draw)
 	double SBCOffset = 0;
 	double firstGoodSTS = 0;	//to accurately calculate duration and livetime if start/stop = 0
 
+	// QDC software threshold (used for multiplicity calculation)
+	int swThresh[32];
+	fill(swThresh, swThresh + 32, 400);
+
 	// ====================== First loop over entries =========================
-	for (int i = 0; i < vEntries; i++)
+	//
+	// Following a directory, a run starts warm from the run before it
+	// (code/RunState.hh): this loop stops at the first good entry, and the second
+	// loop does the rest of its job as it goes, so each entry is read once.
+	// If the SBC offset isn't the one the last run predicts, this loop goes on
+	// as usual.  If the second loop turns out to need the whole of this one (the
+	// first good entry moves, or a time has to be interpolated), the run is
+	// checked again the old way.
+	//
+	auto measure = [&](MJVetoEvent &veto, int i, int isGood)
 	{
-		v->GetEntry(i);
-		MJVetoEvent veto;
-
-		// Set QDC software threshold (used for multiplicity calculation)
-		int thresh[32];
-		fill(thresh, thresh + 32, 400);
-		veto.SetSWThresh(thresh);
-
-		// true: force-write an event with errors.
-    	int isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);
+		counters.Push(veto,true);
 
     	// find event time and fill vectors
 		if (!veto.GetBadScaler()) {
@@ -169,94 +214,113 @@ void vetoCheck(int run, bool draw)
 		}
 
 		// skip bad entries (true = print contents of skipped event)
-    	if (CheckForBadErrors(veto,i,isGood,false)) continue;
+    	if (GetErrorPolicy().Check(veto,i,isGood)) return;
 
 		// save the first good entry number for the SBC offset
 		if (!foundFirst && veto.GetTimeSBC() > 0 && veto.GetTimeSec() > 0 && !veto.GetError(4)) {
-			first = veto;
+			first.Set(veto,isGood,i);
 			foundFirst = true;
 			firstGoodEntry = i;
 		}
 
     	// very simple LED tag (fMultip is number of channels above QDC threshold)
 		if (veto.GetMultip() > 15) {
-			LEDDeltaT->Fill(veto.GetTimeSec()-prev.GetTimeSec());
+			LEDDeltaT->Fill(veto.GetTimeSec()-measureHistory.Back().GetTimeSec());
 			pureLEDcount++;
 		}
 
 		// end of loop
-		prev = veto;
+		measureHistory.Push(veto,isGood,i);
 		lastGoodTime = xTime;
+	};
+	bool warm = (state != NULL && state->WarmFor(run,(long)start));
+	int measured = vEntries;
+	MJVetoEvent veto;
+	for (int i = 0; i < vEntries; i++)
+	{
+		v->GetEntry(i);
 		veto.Clear();
+		veto.SetSWThresh(swThresh);
+
+		// true: force-write an event with errors.
+    	int isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);
+		measure(veto,i,isGood);
+		if (warm && foundFirst) {
+			if (state->SBCHolds(first.GetTimeSBC()-first.GetTimeSec(),(long)start)) {
+				measured = i+1;
+				break;
+			}
+			cout << "SBC offset isn't the one run " << state->run << " predicts.  Not starting from it.\n";
+			warm = false;
+		}
 	}
 
 	SBCOffset = first.GetTimeSBC() - first.GetTimeSec();
 
-	if (duration == 0)
-	{
-		cout << "Corrupted duration.  Last good timestamp: " << lastGoodTime-firstGoodSTS << endl;
-		duration = lastGoodTime-firstGoodSTS;
-	}
-	livetime = duration - (first.GetTimeSec() - firstGoodSTS);
-
-	// find the LED frequency
+	// the first loop's results (the rest of it, when starting warm)
 	double LEDrms = 0;
 	double LEDfreq = 0;
-	int dtEntries = LEDDeltaT->GetEntries();
-	if (dtEntries > 0) {
-		int maxbin = LEDDeltaT->GetMaximumBin();
-		LEDDeltaT->GetXaxis()->SetRange(maxbin-100,maxbin+100); // looks at +/- 0.1 seconds of max bin.
-		LEDrms = LEDDeltaT->GetRMS();
-		LEDfreq = 1/LEDDeltaT->GetMean();
-	}
-	else {
-		cout << "Warning! No multiplicity > 15 events.  LED may be off.\n";
-		LEDrms = 9999;
-		LEDfreq = 9999;
-		badLEDFreq = true;
-	}
-	double LEDperiod = 1/LEDfreq;
-	delete LEDDeltaT;
-	if (LEDperiod > 9 || vEntries < 100)
+	double LEDperiod = 0;
+	auto finishMeasure = [&]()
 	{
-		cout << "Warning: Short run.\n";
-		if (pureLEDcount > 3) {
-			cout << "   From histo method, LED freq is " << LEDfreq
-				 << "  Using approximate rate: " << pureLEDcount/duration << endl;
-			LEDperiod = duration/pureLEDcount;
+		if (duration == 0)
+		{
+			cout << "Corrupted duration.  Last good timestamp: " << lastGoodTime-firstGoodSTS << endl;
+			duration = lastGoodTime-firstGoodSTS;
+		}
+		livetime = duration - (first.GetTimeSec() - firstGoodSTS);
+
+		// find the LED frequency
+		LEDrms = 0;
+		LEDfreq = 0;
+		int dtEntries = LEDDeltaT->GetEntries();
+		if (dtEntries > 0) {
+			int maxbin = LEDDeltaT->GetMaximumBin();
+			LEDDeltaT->GetXaxis()->SetRange(maxbin-100,maxbin+100); // looks at +/- 0.1 seconds of max bin.
+			LEDrms = LEDDeltaT->GetRMS();
+			LEDfreq = 1/LEDDeltaT->GetMean();
 		}
 		else {
-			LEDperiod = 9999;
+			cout << "Warning! No multiplicity > 15 events.  LED may be off.\n";
+			LEDrms = 9999;
+			LEDfreq = 9999;
 			badLEDFreq = true;
 		}
-	}
-	if (LEDperiod > 9 || LEDperiod < 5 || badLEDFreq) {
-		ErrorCount[25]++;
-		Error[25] = true;
-	}
+		LEDperiod = 1/LEDfreq;
+		delete LEDDeltaT;
+		if (LEDperiod > 9 || vEntries < 100)
+		{
+			cout << "Warning: Short run.\n";
+			if (pureLEDcount > 3) {
+				cout << "   From histo method, LED freq is " << LEDfreq
+					 << "  Using approximate rate: " << pureLEDcount/duration << endl;
+				LEDperiod = duration/pureLEDcount;
+			}
+			else {
+				LEDperiod = 9999;
+				badLEDFreq = true;
+			}
+		}
+		if (LEDperiod > 9 || LEDperiod < 5 || badLEDFreq) {
+			ErrorCount[25]++;
+			Error[25] = true;
+		}
+		pureLEDcount = 0;
+	};
 
 	// ====================== Second loop over entries =========================
 	double STime = 0;
 	double STimePrev = 0;
 	int SIndex = 0;
 	int SIndexPrev = 0;
-	int EventNumPrev_good = 0;
-	int EventNum = 0;
 	double SBCTime = 0;
-	double SBCTimePrev = 0;
 	double TSdifference = 0; // a running total of the time difference between the scaler and SBC timestamps
-	prev.Clear();
-	pureLEDcount = 0;
+	VetoRing<2> history;
 
-	for (int i = 0; i < vEntries; i++)
+	// Returns false if a warm start doesn't hold for this entry.
+	auto check = [&](MJVetoEvent &veto, int i, int isGood) -> bool
 	{
-		EventNum = i;
-
-		// this time we don't skip anything until all errors are checked.
-		// we also skip setting QDC thresholds b/c we don't need multiplicity in loop 2.
-		v->GetEntry(i);
-		MJVetoEvent veto;
-    	veto.WriteEvent(i,vRun,vEvent,vBits,run,true);	// true: force-write event with errors.
+		const VetoSnapshot &prev = history.Back();
 
     	// find event time
 		if (!veto.GetBadScaler())
@@ -271,6 +335,7 @@ void vetoCheck(int run, bool draw)
 			xTime = veto.GetTimeSBC() - SBCOffset;
 		else
 		{
+			if (warm) return false;	// interpolating needs the rest of the first loop
 			xTime = InterpTime(i,EntryTime,EntryNum,BadScalers);
 		 	Error[28] = true;
  			ErrorCount[28]++;
@@ -283,13 +348,9 @@ void vetoCheck(int run, bool draw)
 			ErrorCount[j]++;
 			Error[j]=true;
 		}
-		Error[18] = (bool)((STime > 0 && SBCTime > 0 && SBCOffset != 0 && !veto.GetError(1) && i > firstGoodEntry) && fabs((STime - STimePrev) - (SBCTime - SBCTimePrev)) > 2);
-		Error[19] = (bool)(veto.GetSEC() == 0 && i != 0 && i > firstGoodEntry);
-		Error[20] = (bool)(abs(veto.GetSEC() - prev.GetSEC()) > EventNum-EventNumPrev_good && i > firstGoodEntry && veto.GetSEC()!=0);
-		Error[21] = (bool)(veto.GetQEC() == 0 && i != 0 && i > firstGoodEntry && !veto.GetError(1));
-		Error[22] = (bool)(abs(veto.GetQEC() - prev.GetQEC()) > EventNum-EventNumPrev_good && i > firstGoodEntry && veto.GetQEC() != 0);
-		Error[23] = (bool)(veto.GetQEC2() == 0 && i != 0 && i > firstGoodEntry && !veto.GetError(1));
-		Error[24] = (bool)(abs(veto.GetQEC2() - prev.GetQEC2()) > EventNum-EventNumPrev_good && i > firstGoodEntry && veto.GetQEC2() != 0);
+		// 18-24 (desync, event count resets and jumps) come from the counter check
+		unsigned counterErrors = counters.Flags(i);
+		for (int j = 18; j <= 24; j++) Error[j] = (counterErrors >> (j-18)) & 1;
 
 		// Print errors to screen
 		bool PrintError = false;
@@ -334,14 +395,12 @@ void vetoCheck(int run, bool draw)
 					 << "  Scaler Time " << STime
 					 << "  SBC Time " << SBCTime << "\n";
 				TSdifference = STime - SBCTime;
-				ErrorCount[18]++;
 			}
 			if (Error[19]) {
 				cout << "Error[19] Scaler Event Count Reset. "
 					 << "  Scaler Index " << veto.GetScalerIndex()
 					 << "  SEC " << veto.GetSEC()
 					 << "  Previous SEC " << prev.GetSEC() << "\n";
-				ErrorCount[19]++;
 			}
 			if (Error[20]) {
 				cout << "Error[20] Scaler Event Count Jump."
@@ -349,14 +408,12 @@ void vetoCheck(int run, bool draw)
 					 << "  Scaler Index " << veto.GetScalerIndex()
 					 << "  SEC " << veto.GetSEC()
 					 << "  Previous SEC " << prev.GetSEC() << "\n";
-				ErrorCount[20]++;
 			}
 			if (Error[21]) {
 				cout << "Error[21] QDC1 Event Count Reset."
 					 << "  Scaler Index " << veto.GetScalerIndex()
 					 << "  QEC1 " << veto.GetQEC()
 					 << "  Previous QEC1 " << prev.GetQEC() << "\n";
-				ErrorCount[21]++;
 			}
 			if(Error[22]) {
 				cout << "Error[22] QDC 1 Event Count Jump."
@@ -364,14 +421,12 @@ void vetoCheck(int run, bool draw)
 					 << "  QDC 1 Index " << veto.GetQDC1Index()
 					 << "  QEC 1 " << veto.GetQEC()
 					 << "  Previous QEC 1 " << prev.GetQEC() << "\n";
-				ErrorCount[22]++;
 			}
 			if (Error[23]) {
 				cout << "Error[23] QDC2 Event Count Reset."
 					 << "  Scaler Index " << veto.GetScalerIndex()
 					 << "  QEC2 " << veto.GetQEC2()
 					 << "  Previous QEC2 " << prev.GetQEC2() << "\n";
-				ErrorCount[23]++;
 			}
 			if(Error[24]) {
 				cout << "Error[24] QDC 2 Event Count Jump."
@@ -379,33 +434,76 @@ void vetoCheck(int run, bool draw)
 					 << "  QDC 2 Index " << veto.GetQDC2Index()
 					 << "  QEC 2 " << veto.GetQEC2()
 					 << "  Previous QEC 2 " << prev.GetQEC2() << "\n";
-				ErrorCount[24]++;
 			}
 			cout << endl;
 		}
 
 		TSdifference = STime - SBCTime;
 		STimePrev = STime;
-		SBCTimePrev = SBCTime;
 		SIndexPrev = SIndex;
 		STime = 0;
 		SBCTime = 0;
 		SIndex = 0;
-		prev = veto;
-		last = prev;
-		EventNumPrev_good = EventNum; //save last good event number to search for unexpected SEC/QEC changes
-		EventNum = 0;
+		history.Push(veto,isGood,i);
+		last = history.Back();
 
 		// Reset error bools each entry
 		for (int j=0; j<nErrs; j++) Error[j]=false;
 
 		// Skip bad entries before filling QDC.
-		if (PrintError) {
+		if (PrintError) return true;
+		for (int j = 0; j < 32; j++) qdc[j] = veto.GetQDC(j);
+		runQDC.Push(qdc);
+		return true;
+	};
+
+	if (!warm)
+	{
+		finishMeasure();
+		counters.CheckErrors(0,vEntries,firstGoodEntry,SBCOffset,run > 8557);
+		for (int i = 0; i < vEntries; i++)
+		{
+			// this time we don't skip anything until all errors are checked.
+			// we also skip setting QDC thresholds b/c we don't need multiplicity in loop 2.
+			v->GetEntry(i);
 			veto.Clear();
-			continue;
+	    	int isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);	// true: force-write event with errors.
+			check(veto,i,isGood);
 		}
-		for (int j = 0; j < 32; j++) hRunQDC[j]->Fill(veto.GetQDC(j));
 	}
+	else
+	{
+		// both loops in one pass
+		bool held = true;
+		int firstBefore = firstGoodEntry;
+		for (int i = 0; i < vEntries && held; i++)
+		{
+			v->GetEntry(i);
+			veto.Clear();
+			veto.SetSWThresh(swThresh);
+	    	int isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);
+			if (i >= measured) {
+				measure(veto,i,isGood);
+				held = (foundFirst && firstGoodEntry == firstBefore);
+			}
+			if (held) {
+				counters.CheckErrors(i,i+1,firstGoodEntry,SBCOffset,run > 8557);
+				held = check(veto,i,isGood);
+			}
+		}
+		if (!held) {
+			cout << "Run " << run << " needs the whole first loop.  Checking it again.\n";
+			delete LEDDeltaT;
+			for (int i = 0; i < 32; i++) delete hRunQDC[i];
+			delete ds;
+			state->Clear();
+			return vetoCheck(run,draw,state,built);
+		}
+		finishMeasure();
+	}
+	for (int j = 18; j <= 24; j++) ErrorCount[j] += counters.Count(1u << (j-18));
+	runQDC.Flush();
+	for (int j = 0; j < 32; j++) runQDC[j].CopyTo(hRunQDC[j]);
 
 	// Find QDC threshold and make sure we have counts above pedestal.
 	// If -d option is used, print a graph.
@@ -494,35 +592,24 @@ void vetoCheck(int run, bool draw)
 
 		cout << "================= End veto error report. =================\n";
 	}
+
+	// the next run starts from this one
+	if (state != NULL) state->Set(run,(long)start,0,badLEDFreq ? 0 : LEDperiod,LEDrms,SBCOffset);
+
+	// clean up (matters when following many runs)
+	for (int i = 0; i < 32; i++) delete hRunQDC[i];
+	delete can;
+	delete ds;
+	return SeriousErrorCount;
 }
 
 // ================================================================================
 // ================================================================================
 
-// Check the 18 built-in error types in a MJVetoEvent object
-bool CheckForBadErrors(MJVetoEvent veto, int entry, int isGood, bool verbose)
+VetoErrorPolicy& GetErrorPolicy()
 {
-	bool badError = false;
-	if (isGood != 1)
-	{
-		int error[18] = {0};
-		veto.UnpackErrorCode(isGood,error);
-
-		for (int q=0; q<18; q++)
-			if (q != 4 && q != 7  && q != 10 && q != 11 && q != 12 && error[q] == 1)
-				badError=true;
-
-		if (badError) {
-			if (verbose == true) {
-				cout << "Skipped Entry: " << entry << endl;
-				veto.Print();
-				cout << endl;
-			}
-			return badError;
-		}
-	}
-	else return badError;	// no bad errors found
-	return false;
+	static VetoErrorPolicy policy;
+	return policy;
 }
 
 // Place threshold 35 qdc above pedestal location.
@@ -0,0 +1,205 @@
+// CounterCheck: the event counter checks, done on a whole run at once.
+//
+// vetoCheck (errors 18-24) and vetoPerformance (SEC/QEC resets and changes)
+// compare each entry's event counters and timestamps with an earlier entry's.
+// They used to do it entry by entry inside their second loops.  Here the
+// counters are kept in contiguous arrays as the first loop reads them, and the
+// checks are adjacent differences over the arrays, in branch-free loops the
+// compiler can vectorize.  Each entry gets a bitmask of the checks it failed,
+// and the run gets a count of each.
+//
+//   CounterCheck counters;
+//   counters.Reserve(vEntries);
+//   for (...) counters.Push(veto,keep);	// 1st loop, every entry
+//   counters.CheckErrors(0,vEntries,firstGoodEntry,SBCOffset,run > 8557);
+//   for (...) if (counters.Flags(i) & CounterCheck::kSECJump) ...	// 2nd loop
+//   int jumps = counters.Count(CounterCheck::kSECJump);
+//
+// Check a range at a time (e.g. one entry, when the loops run as one pass),
+// in order; the counts add up over the ranges.  Counters are kept as 32 bits,
+// like VetoSnapshot's, and differences are taken modulo 2^32, so a counter
+// rolling over from 0xffffffff to 0 is a reset but not a jump.
+//
+// vetoPerformance compares an entry with the last one it kept (not one with a
+// fatal error), which isn't always the one before it.  Push() copies that
+// entry's counters next to each entry's own, so CheckChanges is an
+// element-by-element comparison of contiguous arrays too.
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef COUNTERCHECK_HH
+#define COUNTERCHECK_HH
+
+#include <vector>
+#include <cmath>
+#include <stdint.h>
+#include "MJVetoEvent.hh"
+
+class CounterCheck
+{
+	public:
+
+	// Bit k is vetoCheck error 18+k.
+	enum {
+		kDesync = 1,		// scaler and SBC times moved apart by > 2 s
+		kSECReset = 2,		// scaler event count went to 0
+		kSECJump = 4,		// scaler event count changed by more than 1
+		kQEC1Reset = 8,		// QDC1 event count went to 0
+		kQEC1Jump = 16,
+		kQEC2Reset = 32,	// QDC2 event count went to 0
+		kQEC2Jump = 64,
+		kBits = 7
+	};
+
+	CounterCheck() { Clear(); }
+
+	void Clear()
+	{
+		fSEC.clear();
+		fQEC.clear();
+		fQEC2.clear();
+		fSECKept.clear();
+		fQECKept.clear();
+		fQEC2Kept.clear();
+		fTimeSec.clear();
+		fTimeSBC.clear();
+		fBadScaler.clear();
+		fMissing.clear();
+		fFlags.clear();
+		fLastSEC = fLastQEC = fLastQEC2 = 0;
+		for (int b = 0; b < kBits; b++) fCount[b] = 0;
+	}
+
+	void Reserve(long n)
+	{
+		fSEC.reserve(n);
+		fQEC.reserve(n);
+		fQEC2.reserve(n);
+		fSECKept.reserve(n);
+		fQECKept.reserve(n);
+		fQEC2Kept.reserve(n);
+		fTimeSec.reserve(n);
+		fTimeSBC.reserve(n);
+		fBadScaler.reserve(n);
+		fMissing.reserve(n);
+		fFlags.reserve(n);
+	}
+
+	// The next entry.  keep: it counts as the previous entry for the ones
+	// after it in CheckChanges (vetoPerformance skips fatal errors).
+	void Push(const MJVetoEvent &v, bool keep)
+	{
+		uint32_t sec = (uint32_t)v.GetSEC(), qec = (uint32_t)v.GetQEC(), qec2 = (uint32_t)v.GetQEC2();
+		fSEC.push_back(sec);
+		fQEC.push_back(qec);
+		fQEC2.push_back(qec2);
+		fSECKept.push_back(fLastSEC);
+		fQECKept.push_back(fLastQEC);
+		fQEC2Kept.push_back(fLastQEC2);
+		fTimeSec.push_back(v.GetTimeSec());
+		fTimeSBC.push_back(v.GetTimeSBC());
+		fBadScaler.push_back(v.GetBadScaler() ? 1 : 0);
+		fMissing.push_back(v.GetError(1) ? 1 : 0);
+		fFlags.push_back(0);
+		if (keep) {
+			fLastSEC = sec;
+			fLastQEC = qec;
+			fLastQEC2 = qec2;
+		}
+	}
+
+	long Size() const { return (long)fFlags.size(); }
+	unsigned Flags(long i) const { return fFlags[i]; }
+
+	// Entries flagged with bit, over the ranges checked so far
+	int Count(unsigned bit) const
+	{
+		for (int b = 0; b < kBits; b++) if (bit == (1u << b)) return fCount[b];
+		return 0;
+	}
+
+	// vetoCheck's errors 18-24, for entries from..to-1.  Each entry is compared
+	// with the one before it.  Only entries after the first good one are
+	// checked.  Resets and the desync don't count on entries with a missing
+	// packet (error 1), except the scaler reset.  useSBC: the SBC time is usable
+	// (run > 8557).
+	void CheckErrors(long from, long to, long firstGood, double SBCOffset, bool useSBC)
+	{
+		long lo = (from > firstGood + 1) ? from : firstGood + 1;
+		const uint32_t *sec = fSEC.data(), *qec = fQEC.data(), *qec2 = fQEC2.data();
+		const double *ts = fTimeSec.data(), *tb = fTimeSBC.data();
+		const uint8_t *bad = fBadScaler.data(), *missing = fMissing.data();
+		uint32_t *flags = fFlags.data();
+		const int sbc = (useSBC && SBCOffset != 0), canSBC = useSBC;
+		for (long i = lo; i < to; i++)
+		{
+			// the times the scan loops use: 0 if the scaler is bad or the SBC time isn't usable
+			// (multiplied by 0 or 1 rather than selected, so there's no branch)
+			int good = !bad[i], goodPrev = !bad[i-1];
+			double st = good * ts[i];
+			double stPrev = goodPrev * ts[i-1];
+			double bt = (good & canSBC & (tb[i] < 2000000000)) * (tb[i] - SBCOffset);
+			double btPrev = (goodPrev & canSBC & (tb[i-1] < 2000000000)) * (tb[i-1] - SBCOffset);
+			int ok = !missing[i];
+			uint32_t f = 0;
+			f |= ((st > 0) & (bt > 0) & sbc & ok & (fabs((st - stPrev) - (bt - btPrev)) > 2)) ? kDesync : 0;
+			f |= (sec[i] == 0) ? kSECReset : 0;
+			f |= ((sec[i] != 0) & Jump(sec[i],sec[i-1])) ? kSECJump : 0;
+			f |= ((qec[i] == 0) & ok) ? kQEC1Reset : 0;
+			f |= ((qec[i] != 0) & Jump(qec[i],qec[i-1])) ? kQEC1Jump : 0;
+			f |= ((qec2[i] == 0) & ok) ? kQEC2Reset : 0;
+			f |= ((qec2[i] != 0) & Jump(qec2[i],qec2[i-1])) ? kQEC2Jump : 0;
+			flags[i] = f;
+		}
+		AddCounts(lo,to);
+	}
+
+	// vetoPerformance's resets and changes, for entries from..to-1.  Each entry
+	// is compared with the last kept entry before it (zeros if there's none).
+	// Resets count anywhere but entry 0, changes only after the first good entry.
+	void CheckChanges(long from, long to, long firstGood)
+	{
+		const uint32_t *sec = fSEC.data(), *qec = fQEC.data(), *qec2 = fQEC2.data();
+		const uint32_t *secKept = fSECKept.data(), *qecKept = fQECKept.data(), *qec2Kept = fQEC2Kept.data();
+		uint32_t *flags = fFlags.data();
+		for (long i = from; i < to; i++)
+		{
+			int later = (i != 0), afterFirst = (i > firstGood);
+			uint32_t f = 0;
+			f |= ((sec[i] == 0) & later) ? kSECReset : 0;
+			f |= ((qec[i] == 0) & later) ? kQEC1Reset : 0;
+			f |= ((qec2[i] == 0) & later) ? kQEC2Reset : 0;
+			f |= (Jump(sec[i],secKept[i]) & afterFirst) ? kSECJump : 0;
+			f |= (Jump(qec[i],qecKept[i]) & afterFirst) ? kQEC1Jump : 0;
+			f |= (Jump(qec2[i],qec2Kept[i]) & afterFirst) ? kQEC2Jump : 0;
+			flags[i] = f;
+		}
+		AddCounts(from,to);
+	}
+
+	private:
+
+	// Did a counter move by more than 1 either way?  Modulo 2^32: the
+	// difference is 0xffffffff, 0 or 1 when it didn't.
+	static int Jump(uint32_t x, uint32_t prev) { return (uint32_t)(x - prev + 1) > 2; }
+
+	void AddCounts(long from, long to)
+	{
+		const uint32_t *flags = fFlags.data();
+		for (int b = 0; b < kBits; b++) {
+			int n = 0;
+			for (long i = from; i < to; i++) n += (flags[i] >> b) & 1;
+			fCount[b] += n;
+		}
+	}
+
+	std::vector<uint32_t> fSEC, fQEC, fQEC2;
+	std::vector<uint32_t> fSECKept, fQECKept, fQEC2Kept;	// the last kept entry's before each (0: none)
+	std::vector<double> fTimeSec, fTimeSBC;
+	std::vector<uint8_t> fBadScaler, fMissing;	// error 1: missing packet
+	std::vector<uint32_t> fFlags;
+	uint32_t fLastSEC, fLastQEC, fLastQEC2;
+	int fCount[kBits];
+};
+
+#endif
@@ -1,15 +1,13 @@
 #include "vetoScan.hh"
+#include "code/RunSet.hh"
 
 // adapted from Rene Brun's copytree.C
 void GrabVetoTree(string file) 
 {
-	int run = 0;
-
-	ifstream InputList;
-  	InputList.open(file.c_str());
-	while(!InputList.eof())
+	RunSet runs;
+	if (!runs.Load(file)) return;
+	for (int run : runs)
 	{
-		InputList >> run;
 	
 		char File[200];
 		sprintf(File,"/global/project/projectdirs/majorana/data/mjd/surfprot/data/built/P3END/OR_run%u.root",run); 
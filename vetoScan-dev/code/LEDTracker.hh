@@ -0,0 +1,156 @@
+// LEDTracker: follows the veto LED pulser through a run, like a phase-locked loop.
+//
+// muFinder used to need a whole pass over a run to measure the LED period
+// (the max bin of the LEDDeltaT histogram) before it could tag any LEDs.
+// The tracker gets the period from the first few high-multiplicity entries
+// instead, then follows it:
+//
+//   acquiring:  lockCount intervals in a row within `window` of their median
+//               -> locked, period = their mean.
+//   locked:     each high-multiplicity entry is matched to the nearest
+//               predicted pulse (n periods after the last LED).  Within
+//               `window` of it, it's an LED: the period is nudged by a
+//               fraction of the error, and the phase is reset on it.
+//               Otherwise it's something else (a muon) and is ignored.
+//               With no LED for lostPeriods periods, the lock is lost and
+//               it starts acquiring again.
+//
+//   seeded:     Seed(period) starts it locked on a known period (the last
+//               run's, code/RunState.hh), so there's nothing to acquire.  The
+//               first high-multiplicity entry sets the phase.
+//
+//   LEDTracker tracker;
+//   for (...) if (multip >= 20) tracker.Add(timeSec);
+//   if (tracker.Locked()) period = tracker.GetPeriod();
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef LEDTRACKER_HH
+#define LEDTRACKER_HH
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+class LEDTracker
+{
+	public:
+
+	LEDTracker(double window = 0.1, double maxPeriod = 9, int lockCount = 8, double gain = 0.1, int lostPeriods = 20)
+		: fWindow(window), fMaxPeriod(maxPeriod), fLockCount(lockCount), fGain(gain), fLostPeriods(lostPeriods)
+	{
+		Clear();
+	}
+
+	void Clear()
+	{
+		fTimes.clear();
+		fLocked = false;
+		fPhased = false;
+		fPeriod = 0;
+		fLast = 0;
+		fLEDs = 0;
+		fMissed = 0;
+		fLost = 0;
+		fSum2 = 0;
+		fNRes = 0;
+	}
+
+	// Start locked on this period, with the phase set by the next Add.
+	void Seed(double period)
+	{
+		Clear();
+		fPeriod = period;
+		fLocked = true;
+	}
+
+	// The time (sec) of a high-multiplicity entry.  Returns true if it was taken as an LED.
+	bool Add(double t)
+	{
+		if (!fLocked) return Acquire(t);
+		if (!fPhased) {
+			fLast = t;
+			fPhased = true;
+			fLEDs++;
+			return true;
+		}
+
+		double dt = t - fLast;
+		long n = lround(dt / fPeriod);
+		if (n < 1) return false;	// between pulses
+		double e = dt - n * fPeriod;
+		if (fabs(e) >= fWindow) {
+			if (dt > fLostPeriods * fPeriod) {
+				fLost++;
+				fLocked = false;
+				fTimes.clear();
+				Acquire(t);
+			}
+			return false;
+		}
+		fPeriod += fGain * e / n;
+		fSum2 += (e/n)*(e/n);
+		fNRes++;
+		fMissed += n - 1;
+		fLEDs++;
+		fLast = t;
+		return true;
+	}
+
+	bool Locked() const { return fLocked; }
+	double GetPeriod() const { return fPeriod; }
+	double GetNext() const { return fLast + fPeriod; }	// predicted time of the next LED
+	double GetLast() const { return fLast; }
+	double GetRMS() const { return fNRes > 0 ? sqrt(fSum2/fNRes) : 0; }	// of the period, pulse to pulse
+	long GetLEDs() const { return fLEDs; }
+	long GetMissed() const { return fMissed; }	// predicted pulses with no LED
+	int GetLost() const { return fLost; }		// times the lock was lost
+
+	private:
+
+	bool Acquire(double t)
+	{
+		fTimes.push_back(t);
+		if (fTimes.size() > 64) fTimes.erase(fTimes.begin());
+		if ((int)fTimes.size() < fLockCount + 1) return false;
+
+		// the last lockCount intervals
+		std::vector<double> dt;
+		for (size_t k = fTimes.size() - fLockCount; k < fTimes.size(); k++) dt.push_back(fTimes[k] - fTimes[k-1]);
+		std::vector<double> sorted = dt;
+		std::sort(sorted.begin(),sorted.end());
+		double median = sorted[sorted.size()/2];
+		if (median <= fWindow || median > fMaxPeriod) return false;
+		double sum = 0;
+		for (size_t k = 0; k < dt.size(); k++) {
+			if (fabs(dt[k] - median) >= fWindow) return false;
+			sum += dt[k];
+		}
+		fPeriod = sum / dt.size();
+		for (size_t k = 0; k < dt.size(); k++) {
+			fSum2 += (dt[k] - fPeriod)*(dt[k] - fPeriod);
+			fNRes++;
+		}
+		fLast = t;
+		fLEDs += fLockCount + 1;
+		fLocked = true;
+		fPhased = true;
+		fTimes.clear();
+		return true;
+	}
+
+	double fWindow, fMaxPeriod;
+	int fLockCount;
+	double fGain;
+	int fLostPeriods;
+	std::vector<double> fTimes;	// while acquiring
+	bool fLocked;
+	bool fPhased;	// fLast is an LED (not yet, after a Seed)
+	double fPeriod, fLast;
+	long fLEDs, fMissed;
+	int fLost;
+	double fSum2;
+	long fNRes;
+};
+
+#endif
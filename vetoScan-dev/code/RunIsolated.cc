@@ -0,0 +1,211 @@
+// Fault-isolated scans.
+// Clint Wiseman, USC/Majorana
+//
+// Each run is processed in its own child process, so a blinded, truncated
+// or corrupt file can only take down its own worker.  Up to GetNumThreads()
+// workers run at once.  A worker that crashes, exits with an error, or runs
+// longer than the timeout is killed and its run is quarantined.
+//
+// The child's output only counts once it has written a ".done" marker,
+// exited cleanly, and (if the caller names one) left its output file.
+// Quarantined runs go in ./output/<Name>_quarantine.txt and are skipped by
+// later scans with the same name until they're removed from it.
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <map>
+#include <set>
+#include "TSystem.h"
+#include "vetoScan.hh"
+#include "code/RunSet.hh"
+#include "code/vetoErrorPolicy.hh"
+
+using namespace std;
+
+struct IsoWorker {
+	int run;
+	pid_t pid;
+	time_t start;
+};
+
+vector<int> RunIsolated(string Input, function<void(string)> job, int timeout, function<string(int)> output)
+{
+	vector<int> good;
+	RunSet runSet;
+	if (!runSet.Load(Input)) return good;
+	string Name = Input;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
+
+	// runs that failed before are skipped
+	string quarName = "./output/"+Name+"_quarantine.txt";
+	set<int> quarantined;
+	ifstream QuarIn(quarName.c_str());
+	string line;
+	while (getline(QuarIn,line)) {
+		if (line.empty() || line[0] == '#') continue;
+		quarantined.insert(atoi(line.c_str()));
+	}
+	QuarIn.close();
+
+	vector<int> runs;
+	for (int run : runSet) {
+		if (quarantined.count(run)) printf("Run %i is quarantined, skipping it.\n",run);
+		else runs.push_back(run);
+	}
+
+	string workDir = "./output/"+Name+"_isolated";
+	gSystem->mkdir(workDir.c_str(),kTRUE);
+	char buf[300];
+
+	// status of each run: 0 = waiting, 1 = good, -1 = failed
+	map<int,int> status;
+	map<int,string> reason;
+	map<int,double> runTime;
+	vector<IsoWorker> workers;
+	int nWorkers = GetNumThreads();
+	size_t next = 0;
+	printf("Running %i runs in isolated workers (%i at a time, timeout %i sec).\n",(int)runs.size(),nWorkers,timeout);
+	cout.flush();
+	fflush(stdout);
+
+	while (next < runs.size() || workers.size() > 0)
+	{
+		// start workers
+		while (next < runs.size() && (int)workers.size() < nWorkers)
+		{
+			int r = runs[next++];
+			sprintf(buf,"%s/%s_run%i",workDir.c_str(),Name.c_str(),r);
+			string stem = buf;
+			ofstream RunList((stem+".txt").c_str());
+			RunList << r;
+			RunList.close();
+			remove((stem+".done").c_str());
+
+			pid_t pid = fork();
+			if (pid == 0) {
+				// child: log to a file, do the job, then leave the marker
+				freopen((stem+".log").c_str(),"w",stdout);
+				dup2(fileno(stdout),fileno(stderr));
+				printf("Run %i, error policy: %s\n",r,GetErrorPolicy().GetName().c_str());	// the parent's, not one for this list
+				job(stem+".txt");
+				cout.flush();
+				fflush(stdout);
+				ofstream Done((stem+".done").c_str());
+				Done << r << endl;
+				Done.close();
+				_exit(0);
+			}
+			else if (pid < 0) {
+				status[r] = -1;
+				reason[r] = "fork failed";
+				continue;
+			}
+			IsoWorker w = {r, pid, time(0)};
+			workers.push_back(w);
+		}
+
+		// check on workers
+		sleep(1);
+		for (size_t i = 0; i < workers.size(); )
+		{
+			IsoWorker &w = workers[i];
+			int wstat = 0;
+			pid_t res = waitpid(w.pid,&wstat,WNOHANG);
+			if (res == 0 && time(0) - w.start > timeout) {
+				kill(w.pid,SIGKILL);
+				waitpid(w.pid,&wstat,0);
+				status[w.run] = -1;
+				sprintf(buf,"timeout after %i sec",timeout);
+				reason[w.run] = buf;
+			}
+			else if (res == 0) { i++; continue; }
+			else {
+				sprintf(buf,"%s/%s_run%i.done",workDir.c_str(),Name.c_str(),w.run);
+				bool done = !gSystem->AccessPathName(buf);
+				if (WIFSIGNALED(wstat)) {
+					sprintf(buf,"crashed (signal %i)",WTERMSIG(wstat));
+					reason[w.run] = buf;
+				}
+				else if (WIFEXITED(wstat) && WEXITSTATUS(wstat) != 0) {
+					sprintf(buf,"exit code %i",WEXITSTATUS(wstat));
+					reason[w.run] = buf;
+				}
+				else if (!done) reason[w.run] = "no output marker";
+				else if (output && gSystem->AccessPathName(output(w.run).c_str()))
+					reason[w.run] = "no output file "+output(w.run);
+				status[w.run] = (reason.count(w.run) ? -1 : 1);
+			}
+			runTime[w.run] = difftime(time(0),w.start);
+			printf("Run %i: %s (%.0f sec)\n",w.run,status[w.run]==1 ? "done" : reason[w.run].c_str(),runTime[w.run]);
+			fflush(stdout);
+			workers.erase(workers.begin()+i);
+		}
+	}
+
+	// report, and quarantine the failures
+	ofstream Quar(quarName.c_str(),ios::app);
+	string repName = "./output/"+Name+"_isolated_report.txt";
+	ofstream Report(repName.c_str());
+	Report << "# run status seconds reason\n";
+	int nBad = 0;
+	for (auto r : runs)
+	{
+		if (status[r] == 1) {
+			good.push_back(r);
+			sprintf(buf,"%-8i OK   %6.0f",r,runTime[r]);
+		}
+		else {
+			nBad++;
+			Quar << r << " " << reason[r] << endl;
+			sprintf(buf,"%-8i FAIL %6.0f  %s  (log: %s/%s_run%i.log)",r,runTime[r],reason[r].c_str(),workDir.c_str(),Name.c_str(),r);
+		}
+		Report << buf << endl;
+	}
+	Quar.close();
+	Report.close();
+	printf("\nIsolated scan: %i of %i runs OK, %i quarantined.  Report: %s\n",(int)good.size(),(int)runs.size(),nBad,repName.c_str());
+	if (nBad > 0) printf("Quarantined runs are listed in %s\n",quarName.c_str());
+	return good;
+}
+
+// muFinder with one worker per run.
+// Each worker writes its own ROOT file, which is moved into ./output/<Name>_shards/
+// once the worker finishes cleanly.  The good runs are then listed in a shard
+// manifest, so muMerge and muListGen work on the result as usual.
+void muFinderIsolated(string Input, int *thresh, bool list, int timeout)
+{
+	string Name = Input;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
+
+	// The ROOT output is always written, since the muon list is built from it.
+	vector<int> good = RunIsolated(Input, [thresh](string runList) {
+		muFinder(runList,thresh,true,false);
+	}, timeout, [Name](int r) {
+		return "./output/"+Name+"_run"+to_string(r)+".root";
+	});
+
+	string shardDir = "./output/"+Name+"_shards";
+	gSystem->mkdir(shardDir.c_str(),kTRUE);
+	string manifestName = "./output/"+Name+"_manifest.txt";
+	ofstream Manifest(manifestName.c_str());
+	Manifest << "# shardFile listFile firstRun lastRun nRuns entries\n";
+	char src[300], dst[300];
+	for (auto r : good)
+	{
+		sprintf(src,"./output/%s_run%i.root",Name.c_str(),r);
+		sprintf(dst,"%s/%s_run%i.root",shardDir.c_str(),Name.c_str(),r);
+		if (rename(src,dst) != 0) {
+			printf("Couldn't move %s to %s\n",src,dst);
+			continue;
+		}
+		Manifest << dst << " - " << r << " " << r << " 1 -1\n";	// entries aren't counted here
+	}
+	Manifest.close();
+	printf("Wrote manifest %s\n",manifestName.c_str());
+
+	if (list) muListGen(manifestName);
+}
@@ -0,0 +1,96 @@
+// RunSeries: one run's per-entry diagnostics for vetoPerformance's
+// run breakdowns (-p runs), kept by column in narrow types.
+//
+// An entry takes 26 bytes here (times as float, counters as uint32,
+// multiplicity as uint8), instead of 16 bytes in each of six TGraphs.  The
+// graphs are only made when the run is written, and then downsampled: the
+// entries are split into nBuckets groups, and each group's lowest and highest
+// point is kept, so jumps and spikes still show up in a few thousand points.
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef RUNSERIES_HH
+#define RUNSERIES_HH
+
+#include <vector>
+#include <stdint.h>
+#include "TGraph.h"
+
+class RunSeries
+{
+	public:
+
+	std::vector<float> time;		// event time (s), best method
+	std::vector<uint8_t> multip;
+	std::vector<uint8_t> badScaler;
+	std::vector<float> sTime;		// scaler time (s)
+	std::vector<uint32_t> sIndex;	// scaler index
+	std::vector<uint32_t> SEC, QEC, QEC2;
+	std::vector<float> ledTime;		// scaler time of each LED (good scalers only)
+
+	void Reserve(long n)
+	{
+		time.reserve(n); multip.reserve(n); badScaler.reserve(n); sTime.reserve(n);
+		sIndex.reserve(n); SEC.reserve(n); QEC.reserve(n); QEC2.reserve(n);
+	}
+
+	void Add(double t, int m, bool bad, double st, long si, long sec, long qec, long qec2)
+	{
+		time.push_back((float)t);
+		multip.push_back((uint8_t)(m < 0 ? 0 : (m > 255 ? 255 : m)));
+		badScaler.push_back(bad);
+		sTime.push_back((float)st);
+		sIndex.push_back((uint32_t)si);
+		SEC.push_back((uint32_t)sec);
+		QEC.push_back((uint32_t)qec);
+		QEC2.push_back((uint32_t)qec2);
+	}
+
+	void AddLED(double st) { ledTime.push_back((float)st); }
+
+	long GetN() const { return (long)time.size(); }
+
+	// y vs. x, leaving out entries with skip[i] set (skip can be NULL).
+	// nBuckets = 0 keeps every point.
+	template<class X, class Y>
+	static TGraph* MakeGraph(const std::vector<X> &x, const std::vector<Y> &y, const std::vector<uint8_t> *skip = NULL, int nBuckets = 0)
+	{
+		std::vector<long> use;
+		use.reserve(x.size());
+		for (long i = 0; i < (long)x.size(); i++) if (skip == NULL || !(*skip)[i]) use.push_back(i);
+		long n = (long)use.size();
+
+		std::vector<double> gx, gy;
+		if (nBuckets <= 0 || n <= 2*(long)nBuckets) {
+			gx.reserve(n); gy.reserve(n);
+			for (long k = 0; k < n; k++) { gx.push_back(x[use[k]]); gy.push_back(y[use[k]]); }
+		}
+		else {
+			gx.reserve(2*nBuckets); gy.reserve(2*nBuckets);
+			for (int b = 0; b < nBuckets; b++)
+			{
+				long k0 = n * b / nBuckets, k1 = n * (b+1) / nBuckets;
+				long lo = k0, hi = k0;
+				for (long k = k0; k < k1; k++) {
+					if (y[use[k]] < y[use[lo]]) lo = k;
+					if (y[use[k]] > y[use[hi]]) hi = k;
+				}
+				long first = lo < hi ? lo : hi, second = lo < hi ? hi : lo;
+				gx.push_back(x[use[first]]); gy.push_back(y[use[first]]);
+				if (second != first) { gx.push_back(x[use[second]]); gy.push_back(y[use[second]]); }
+			}
+		}
+		if (gx.size() == 0) return new TGraph();
+		return new TGraph((int)gx.size(),&gx[0],&gy[0]);
+	}
+
+	// the LED graph: scaler time vs. LED count
+	TGraph* MakeLEDGraph(int nBuckets = 0) const
+	{
+		std::vector<float> count(ledTime.size());
+		for (size_t i = 0; i < count.size(); i++) count[i] = (float)(i+1);
+		return MakeGraph(count,ledTime,NULL,nBuckets);
+	}
+};
+
+#endif
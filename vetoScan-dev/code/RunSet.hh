@@ -0,0 +1,249 @@
+// RunSet: a run list, kept as sorted ranges of runs.
+// Every vetoScan routine reads its -F list through this.
+//
+// A run list file has one entry per line:
+//   2688            a run
+//   2688-2790       a range (inclusive)
+//   # or !          comment (also after an entry)
+//   @P3JDY          start a section: following runs are tagged with it (as in old/runHealth.C)
+//   include f.txt   add the runs in another list
+//   exclude f.txt   take them out           (e.g. END_Full minus NoLEDRuns:
+//   intersect f.txt keep only the common      "include END_Full.txt" then "exclude NoLEDRuns.txt")
+// The lines are applied in order.  File names are relative to the list's directory.
+//
+// Runs come out in increasing order, each once.  A run listed twice keeps the
+// section it was first listed under.  Union, intersection and difference (|, &, -)
+// keep the left side's sections.  Iterating is two ints, no allocation:
+//   RunSet rs;
+//   if (!rs.Load(Input)) return;
+//   for (int run : rs) { ... }
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef RUNSET_HH
+#define RUNSET_HH
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstdlib>
+#include <cerrno>
+
+class RunSet
+{
+	public:
+
+	struct Range { int lo, hi, section; };	// section: index into the section names (0: none)
+
+	RunSet() : fSections(1,"") {}
+
+	// Returns false if the file (or one it includes) can't be opened.
+	bool Load(std::string file) { return Load(file,0); }
+
+	// Add runs lo..hi, except those already in the set.
+	void Add(int lo, int hi, std::string section = "")
+	{
+		if (hi < lo) return;
+		RunSet piece;
+		piece.fRanges.push_back(Range{lo,hi,0});
+		piece = piece - *this;
+		int s = SectionId(section);
+		for (auto &r : piece.fRanges) fRanges.push_back(Range{r.lo,r.hi,s});
+		Normalize();
+	}
+	void Add(int run, std::string section = "") { Add(run,run,section); }
+
+	bool Contains(int run) const { return Find(run) != NULL; }
+
+	// The section a run was listed under ("" if none or not in the set)
+	std::string GetSection(int run) const
+	{
+		const Range *r = Find(run);
+		return r == NULL ? "" : fSections[r->section];
+	}
+
+	long Size() const
+	{
+		long n = 0;
+		for (auto &r : fRanges) n += (long)r.hi - r.lo + 1;
+		return n;
+	}
+	bool Empty() const { return fRanges.empty(); }
+	int First() const { return fRanges.empty() ? 0 : fRanges.front().lo; }
+	int Last() const { return fRanges.empty() ? 0 : fRanges.back().hi; }
+	const std::vector<Range>& GetRanges() const { return fRanges; }
+
+	RunSet operator|(const RunSet &o) const
+	{
+		RunSet u = *this;
+		RunSet extra = o - *this;
+		for (auto &r : extra.fRanges) u.fRanges.push_back(Range{r.lo,r.hi,u.SectionId(extra.fSections[r.section])});
+		u.Normalize();
+		return u;
+	}
+
+	RunSet operator&(const RunSet &o) const
+	{
+		RunSet x;
+		x.fSections = fSections;
+		size_t j = 0;
+		for (auto &r : fRanges) {
+			while (j < o.fRanges.size() && o.fRanges[j].hi < r.lo) j++;
+			for (size_t k = j; k < o.fRanges.size() && o.fRanges[k].lo <= r.hi; k++)
+				x.fRanges.push_back(Range{std::max(r.lo,o.fRanges[k].lo),std::min(r.hi,o.fRanges[k].hi),r.section});
+		}
+		return x;
+	}
+
+	RunSet operator-(const RunSet &o) const
+	{
+		RunSet d;
+		d.fSections = fSections;
+		size_t j = 0;
+		for (auto &r : fRanges) {
+			while (j < o.fRanges.size() && o.fRanges[j].hi < r.lo) j++;
+			long lo = r.lo;
+			for (size_t k = j; k < o.fRanges.size() && o.fRanges[k].lo <= r.hi; k++) {
+				if (o.fRanges[k].lo > lo) d.fRanges.push_back(Range{(int)lo,o.fRanges[k].lo-1,r.section});
+				lo = std::max(lo,(long)o.fRanges[k].hi + 1);
+			}
+			if (lo <= r.hi) d.fRanges.push_back(Range{(int)lo,r.hi,r.section});
+		}
+		return d;
+	}
+
+	class iterator
+	{
+		public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef int value_type;
+		typedef long difference_type;
+		typedef const int* pointer;
+		typedef int reference;
+
+		iterator(const RunSet *s, size_t r) : fSet(s), fRange(r), fRun(r < s->fRanges.size() ? s->fRanges[r].lo : 0) {}
+		int operator*() const { return fRun; }
+		iterator& operator++()
+		{
+			if (fRun < fSet->fRanges[fRange].hi) fRun++;
+			else if (++fRange < fSet->fRanges.size()) fRun = fSet->fRanges[fRange].lo;
+			else fRun = 0;
+			return *this;
+		}
+		bool operator==(const iterator &o) const { return fRange == o.fRange && fRun == o.fRun; }
+		bool operator!=(const iterator &o) const { return !(*this == o); }
+		private:
+		const RunSet *fSet;
+		size_t fRange;
+		int fRun;
+	};
+	iterator begin() const { return iterator(this,0); }
+	iterator end() const { return iterator(this,fRanges.size()); }
+
+	private:
+
+	bool Load(std::string file, int depth)
+	{
+		std::ifstream InputList(file.c_str());
+		if (!InputList.good()) {
+			std::cout << "Couldn't open " << file << std::endl;
+			return false;
+		}
+		std::string dir = "";
+		if (file.find_last_of("\\/") != std::string::npos) dir = file.substr(0,file.find_last_of("\\/")+1);
+		std::string line, section = "";
+		int lineNum = 0;
+		while (getline(InputList,line))
+		{
+			lineNum++;
+			size_t c = line.find_first_of("#!");
+			if (c != std::string::npos) line.erase(c);
+			std::stringstream ss(line);
+			std::string tok;
+			if (!(ss >> tok)) continue;
+
+			if (tok[0] == '@') {
+				section = tok.substr(1);
+				continue;
+			}
+			if (tok == "include" || tok == "exclude" || tok == "intersect") {
+				std::string other;
+				if (!(ss >> other) || depth > 8) {
+					std::cout << "RunSet: bad " << tok << " at " << file << ":" << lineNum << std::endl;
+					continue;
+				}
+				if (other[0] != '/') other = dir + other;
+				RunSet o;
+				if (!o.Load(other,depth+1)) return false;
+				if (tok == "include") *this = *this | o;
+				else if (tok == "exclude") *this = *this - o;
+				else *this = *this & o;
+				continue;
+			}
+			do {
+				int lo, hi;
+				if (!ParseRange(tok,lo,hi)) {
+					std::cout << "RunSet: can't read \"" << tok << "\" at " << file << ":" << lineNum << std::endl;
+					break;
+				}
+				Add(lo,hi,section);
+			} while (ss >> tok);
+		}
+		return true;
+	}
+
+	static bool ParseRange(const std::string &tok, int &lo, int &hi)
+	{
+		const char *s = tok.c_str();
+		char *end;
+		errno = 0;
+		long a = strtol(s,&end,10), b = a;
+		if (end == s || a < 0) return false;
+		if (*end == '-') {
+			const char *s2 = end + 1;
+			b = strtol(s2,&end,10);
+			if (end == s2 || b < a) return false;
+		}
+		if (*end != '\0' || errno != 0) return false;
+		lo = (int)a;
+		hi = (int)b;
+		return true;
+	}
+
+	int SectionId(const std::string &name)
+	{
+		for (size_t i = 0; i < fSections.size(); i++) if (fSections[i] == name) return (int)i;
+		fSections.push_back(name);
+		return (int)fSections.size() - 1;
+	}
+
+	const Range* Find(int run) const
+	{
+		auto it = std::upper_bound(fRanges.begin(),fRanges.end(),run,[](int x, const Range &r) { return x < r.lo; });
+		if (it == fRanges.begin()) return NULL;
+		--it;
+		return run <= it->hi ? &(*it) : NULL;
+	}
+
+	// sort, and join touching ranges from the same section (ranges never overlap)
+	void Normalize()
+	{
+		std::sort(fRanges.begin(),fRanges.end(),[](const Range &a, const Range &b) { return a.lo < b.lo; });
+		size_t n = 0;
+		for (size_t i = 0; i < fRanges.size(); i++) {
+			if (n > 0 && fRanges[n-1].section == fRanges[i].section && (long)fRanges[n-1].hi + 1 == fRanges[i].lo)
+				fRanges[n-1].hi = fRanges[i].hi;
+			else fRanges[n++] = fRanges[i];
+		}
+		fRanges.resize(n);
+	}
+
+	std::vector<Range> fRanges;
+	std::vector<std::string> fSections;
+};
+
+#endif
@@ -0,0 +1,78 @@
+// RunState: what a run's scan measured, kept to start the next run with.
+//
+// Each scan opens a run with a pass to measure the number of panels (the
+// highest multiplicity), the LED period and the SBC offset, before it can cut
+// anything.  Consecutive runs nearly always have the same panels and LED
+// pulser, and the SBC clock keeps its offset from the run start time.  So a
+// run can start "warm" from the run before it: the measuring pass only goes as
+// far as the first good entry (for the exact SBC offset), and the rest of the
+// run is measured and cut in one pass with the last run's values.  What it
+// measures is checked against what it cut with at the end of the run, and if
+// that doesn't hold, the run is scanned again the old way.
+//
+//   RunState last;
+//   for (...each run...) {
+//   	bool warm = last.WarmFor(run,start);
+//   	...first good entry found:  if (warm && !last.SBCHolds(SBCOffset,start)) warm = false;
+//   	...one pass, cutting with last.highestMultip and last.LEDperiod...
+//   	...if the measured values would have cut differently, scan again cold...
+//   	last.Set(run,start,highestMultip,LEDperiod,LEDrms,SBCOffset);
+//   }
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef RUNSTATE_HH
+#define RUNSTATE_HH
+
+#include <cmath>
+
+struct RunState
+{
+	int run;			// 0: nothing to start from
+	long start;			// run start (unix time)
+	int highestMultip;
+	double LEDperiod;	// 0: no usable LED period
+	double LEDrms;
+	double SBCOffset;
+
+	RunState() { Clear(); }
+
+	void Clear()
+	{
+		run = 0;
+		start = 0;
+		highestMultip = 0;
+		LEDperiod = 0;
+		LEDrms = 0;
+		SBCOffset = 0;
+	}
+
+	void Set(int r, long st, int hm, double period, double rms, double offset)
+	{
+		run = r;
+		start = st;
+		highestMultip = hm;
+		LEDperiod = period;
+		LEDrms = rms;
+		SBCOffset = offset;
+	}
+
+	// Can a run starting at st start from this one?  Not from a later run,
+	// and not across a long break (hardware is more likely to have changed).
+	bool WarmFor(int r, long st, long maxGap = 86400) const
+	{
+		return run > 0 && r > run && st >= start && st - start <= maxGap;
+	}
+
+	// The SBC offset expected for a run starting at st
+	double PredictSBCOffset(long st) const { return SBCOffset + (double)(st - start); }
+
+	// Does a run's measured SBC offset agree with the prediction?  If not,
+	// the SBC clock was reset or the DAQ restarted, and nothing is carried over.
+	bool SBCHolds(double offset, long st, double tol = 2) const
+	{
+		return fabs(offset - PredictSBCOffset(st)) < tol;
+	}
+};
+
+#endif
@@ -0,0 +1,206 @@
+// RunWatcher: follow a data directory and hand out runs as they finish.
+// Used by the live-follow modes of vetoScan and vetoCheck.
+//
+// Looks for built (OR_run*.root) and gatified (mjd_run*.root) files in
+// the directory and up to two levels of subdirectories, so it can watch
+// either a part directory or the top of the data tree.  A run is complete
+// once its files exist and their sizes haven't changed for "settle" seconds.
+// Runs are handed out in order: a run that's ready waits for every lower run
+// that's still being written, unless that run's files haven't changed for
+// "timeout" seconds (e.g. it never got gatified), in which case it's skipped.
+// So is a run that only shows up after a higher one has been handed out.
+// On Linux, inotify wakes us up when a file is closed or moved in; otherwise
+// (or if inotify fails) the directory is just polled.
+//
+// Next() also hands out the paths of the run's files, so the run is read from
+// this directory (code/VetoSource.hh) rather than wherever GATDataSet looks.
+//
+// Touching a file called "STOP" in the directory ends the follow loop.
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef RUNWATCHER_HH
+#define RUNWATCHER_HH
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cstdio>
+#include <ctime>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+class RunWatcher
+{
+	public:
+
+	struct RunFiles {
+		std::string built, gat;	// paths, "" if not found
+		long size;			// combined size at the last change
+		time_t lastChange;
+		RunFiles() : size(-1), lastChange(0) {}
+	};
+
+	// dir: data directory.  firstRun: ignore runs below this.
+	// needGat: also wait for the gatified file.  poll/settle/timeout: seconds.
+	RunWatcher(std::string dir, int firstRun = 0, bool needGat = true, int poll = 10, int settle = 30, int timeout = 3600)
+	: fDir(dir), fFirstRun(firstRun), fNeedGat(needGat), fPoll(poll), fSettle(settle), fTimeout(timeout), fFd(-1), fLast(0)
+	{
+		#ifdef __linux__
+		fFd = inotify_init1(IN_NONBLOCK);
+		if (fFd < 0) printf("RunWatcher: inotify unavailable, polling %s every %i sec.\n",fDir.c_str(),fPoll);
+		#endif
+		Scan();
+		printf("RunWatcher: following %s (runs >= %i)\n",fDir.c_str(),fFirstRun);
+	}
+
+	~RunWatcher() {
+		#ifdef __linux__
+		if (fFd >= 0) close(fFd);
+		#endif
+	}
+
+	// Block until the next complete run shows up.  Returns false when told to stop.
+	// Runs are handed out in increasing order.  A ready run is held back while
+	// a lower run is still incomplete and hasn't timed out.
+	// files: if given, gets the run's file paths.
+	bool Next(int &run, RunFiles *files = NULL)
+	{
+		while (true)
+		{
+			if (Stopped()) {
+				printf("RunWatcher: found %s/STOP, done following.\n",fDir.c_str());
+				return false;
+			}
+			Scan();
+			time_t now = time(0);
+			for (std::map<int,RunFiles>::iterator it = fRuns.begin(); it != fRuns.end(); it++)
+			{
+				RunFiles &f = it->second;
+				if (fDone.count(it->first)) continue;
+				if (it->first < fLast) {
+					printf("RunWatcher: run %i showed up after run %i, skipping it.\n",it->first,fLast);
+					fDone.insert(it->first);
+					continue;
+				}
+				bool ready = (f.built != "" && (!fNeedGat || f.gat != "") && now - f.lastChange >= fSettle);
+				if (!ready) {
+					if (now - f.lastChange < fTimeout) break;	// hold the later runs
+					printf("RunWatcher: run %i is incomplete after %i sec, skipping it.\n",it->first,fTimeout);
+					fDone.insert(it->first);
+					continue;
+				}
+				run = it->first;
+				if (files != NULL) *files = f;
+				fDone.insert(run);
+				fLast = run;
+				printf("RunWatcher: run %i is complete.\n",run);
+				return true;
+			}
+			Wait();
+		}
+	}
+
+	int GetNumDone() { return (int)fDone.size(); }
+
+	private:
+
+	std::string fDir;
+	int fFirstRun;
+	bool fNeedGat;
+	int fPoll;
+	int fSettle;
+	int fTimeout;
+	int fFd;
+	int fLast;	// the last run handed out
+	std::map<int,RunFiles> fRuns;
+	std::set<int> fDone;
+	std::set<std::string> fWatched;
+
+	bool Stopped() {
+		struct stat st;
+		return stat((fDir+"/STOP").c_str(),&st) == 0;
+	}
+
+	// Walk the directory, note new files, and track their sizes.
+	void Scan()
+	{
+		std::map<int,long> sizes;
+		ScanDir(fDir,0,sizes);
+		time_t now = time(0);
+		for (std::map<int,long>::iterator it = sizes.begin(); it != sizes.end(); it++)
+		{
+			RunFiles &f = fRuns[it->first];
+			if (it->second != f.size) {
+				f.size = it->second;
+				f.lastChange = now;
+			}
+		}
+	}
+
+	void ScanDir(std::string path, int depth, std::map<int,long> &sizes)
+	{
+		DIR *d = opendir(path.c_str());
+		if (d == NULL) return;
+		Watch(path);
+		struct dirent *ent;
+		while ((ent = readdir(d)) != NULL)
+		{
+			std::string name = ent->d_name;
+			if (name == "." || name == "..") continue;
+			std::string full = path + "/" + name;
+			struct stat st;
+			if (stat(full.c_str(),&st) != 0) continue;
+			if (S_ISDIR(st.st_mode)) {
+				if (depth < 2) ScanDir(full,depth+1,sizes);
+				continue;
+			}
+			int run = 0;
+			bool isBuilt = (sscanf(name.c_str(),"OR_run%d.root",&run) == 1);
+			bool isGat = !isBuilt && (sscanf(name.c_str(),"mjd_run%d.root",&run) == 1);
+			if ((!isBuilt && !isGat) || run < fFirstRun || fDone.count(run)) continue;
+			if (name.find(".root") != name.size()-5) continue;	// skip temp files (OR_run1234.root.tmp)
+			RunFiles &f = fRuns[run];
+			if (isBuilt) f.built = full;
+			if (isGat) f.gat = full;
+			sizes[run] += (long)st.st_size;
+		}
+		closedir(d);
+	}
+
+	void Watch(std::string path)
+	{
+		#ifdef __linux__
+		if (fFd < 0 || fWatched.count(path)) return;
+		if (inotify_add_watch(fFd,path.c_str(),IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) >= 0)
+			fWatched.insert(path);
+		#endif
+	}
+
+	// Sleep until a file event comes in or the poll interval runs out.
+	void Wait()
+	{
+		#ifdef __linux__
+		if (fFd >= 0) {
+			struct pollfd pfd;
+			pfd.fd = fFd;
+			pfd.events = POLLIN;
+			if (poll(&pfd,1,fPoll*1000) > 0) {
+				char buf[4096];
+				while (read(fFd,buf,sizeof(buf)) > 0) {}
+			}
+			return;
+		}
+		#endif
+		sleep(fPoll);
+	}
+};
+
+#endif
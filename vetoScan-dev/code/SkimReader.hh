@@ -0,0 +1,143 @@
+// SkimReader: read a few columns of a skimTree, fast.
+// Used by scripts/ds0_muGeSkim.cc and ds1_muGeSkim.cc.
+//
+// Only the branches asked for are switched on, so an entry read only
+// unpacks those.  Every column is bound once to storage the reader owns:
+// vector branches are read back into the same vector each entry, so after
+// the first few entries there's no allocation.  SkimParallel runs one job per
+// file on a few threads; give each job its own histograms (VetoHist) and Add
+// them up afterwards in file order.
+//
+//   SkimReader r(tree);
+//   const int &mL = r.Scalar<int>("mL");
+//   const vector<double> &dtmu = r.Vector<double>("dtmu_s");
+//   while (r.Next()) { ... }
+//
+// The scripts need to be compiled (ACLiC) to use the threads:
+//   root[0] .X ds0_muGeSkim.cc+
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef SKIMREADER_HH
+#define SKIMREADER_HH
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include "TROOT.h"
+#include "TTree.h"
+#include "TChain.h"
+#include "TFile.h"
+#include "TObjArray.h"
+
+class SkimReader
+{
+	public:
+
+	SkimReader(TTree *t) : fTree(t), fEntry(-1), fEntries(t->GetEntries()), fOK(true)
+	{
+		fTree->SetBranchStatus("*",0);
+	}
+
+	~SkimReader()
+	{
+		for (size_t i = 0; i < fCols.size(); i++) delete fCols[i];
+	}
+
+	// Bind a scalar branch.  The reference stays valid, and holds the current entry's value.
+	template<class T> const T& Scalar(std::string name)
+	{
+		SkimColumn<T> *c = new SkimColumn<T>();
+		fCols.push_back(c);
+		if (Activate(name)) fTree->SetBranchAddress(name.c_str(),&c->val);
+		return c->val;
+	}
+
+	// Bind a vector<T> branch.  Same vector every entry.
+	template<class T> const std::vector<T>& Vector(std::string name)
+	{
+		SkimColumn< std::vector<T> > *c = new SkimColumn< std::vector<T> >();
+		c->val.reserve(64);
+		c->ptr = &c->val;
+		fCols.push_back(c);
+		if (Activate(name)) fTree->SetBranchAddress(name.c_str(),&c->ptr);
+		return c->val;
+	}
+
+	// false if any of the branches asked for isn't in the tree
+	bool IsOK() const { return fOK; }
+	long GetEntries() const { return fEntries; }
+	long GetEntry() const { return fEntry; }
+
+	bool Next()
+	{
+		if (++fEntry >= fEntries) return false;
+		fTree->GetEntry(fEntry);
+		return true;
+	}
+
+	private:
+
+	struct SkimColumnBase { virtual ~SkimColumnBase() {} };
+	template<class T> struct SkimColumn : public SkimColumnBase {
+		T val;
+		T *ptr;
+		SkimColumn() : val(), ptr(NULL) {}
+	};
+
+	bool Activate(std::string name)
+	{
+		if (fTree->GetBranch(name.c_str()) == NULL) {
+			std::cout << "SkimReader: no branch " << name << " in " << fTree->GetName() << std::endl;
+			fOK = false;
+			return false;
+		}
+		fTree->SetBranchStatus(name.c_str(),1);
+		return true;
+	}
+
+	TTree *fTree;
+	long fEntry, fEntries;
+	bool fOK;
+	std::vector<SkimColumnBase*> fCols;
+
+	SkimReader(const SkimReader&);
+	SkimReader& operator=(const SkimReader&);
+};
+
+// The files matching a TChain pattern, e.g. "~/dev/datasets/ds0/*.root".
+inline std::vector<std::string> SkimFiles(std::string pattern, std::string tree = "skimTree")
+{
+	std::vector<std::string> files;
+	TChain ch(tree.c_str());
+	ch.Add(pattern.c_str());
+	TObjArray *list = ch.GetListOfFiles();
+	for (int i = 0; i < list->GetEntries(); i++) files.push_back(list->At(i)->GetTitle());
+	return files;
+}
+
+// Run job(0) ... job(nJobs-1) on up to nThreads threads (0: one per core).
+inline void SkimParallel(int nJobs, int nThreads, std::function<void(int)> job)
+{
+	if (nThreads <= 0) nThreads = (int)std::thread::hardware_concurrency();
+	if (nThreads > nJobs) nThreads = nJobs;
+	if (nThreads <= 1) {
+		for (int i = 0; i < nJobs; i++) job(i);
+		return;
+	}
+	ROOT::EnableThreadSafety();
+	std::atomic<int> next(0);
+	std::vector<std::thread> pool;
+	for (int t = 0; t < nThreads; t++) {
+		pool.push_back(std::thread([&]() {
+			int i;
+			while ((i = next++) < nJobs) job(i);
+		}));
+	}
+	for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+}
+
+#endif
@@ -0,0 +1,219 @@
+// VetoPipeline: decode one run's veto entries on several threads, and hand
+// them to a sequential stage in entry order.
+//
+// Decoding an entry (GetEntry + WriteEvent) doesn't depend on any other entry,
+// but muFinder's LED and time cuts do: each entry's cut needs the last LED,
+// the last scaler jump, etc.  So a run goes through three stages, joined by a
+// ring of slots:
+//
+//   decode (N threads)  ->  cut (the calling thread)  ->  write (1 thread, optional)
+//
+// Each decoder has its own copy of the run's veto chain (from GATDataSet, or
+// from the built file given, see code/VetoSource.hh) (a TChain, and the
+// objects it reads into, can only be used by one thread at a time), and takes
+// blocks of entries in order, so the baskets are read and unzipped in parallel
+// too.  Entry i goes in slot i % nSlots.  A slot's sequence number says which
+// stage it's waiting for, so each hand-off is one atomic store and one atomic
+// load, and no locks are taken.  A stage that gets ahead of the one before it
+// yields until its next slot is ready.  The cut stage sees the entries in
+// order, and the write stage sees them in order after the cut.
+//
+// With one thread (-j 1) the stages just run one after another.
+//
+// The cut stage can call Stop() to end the run early, after the entry it's
+// cutting (e.g. once it has seen enough of the run).  That entry still goes
+// through the write stage.
+//
+//   VetoPipeline<MuRow> pipe(run,swThresh,GetNumThreads(),files.built);
+//   pipe.Run([&](VetoSlot<MuRow> &s) { ...cuts on s.veto, results in s.row... },
+//            [&](VetoSlot<MuRow> &s) { ...write s.row... });
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef VETOPIPELINE_HH
+#define VETOPIPELINE_HH
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+#include "TROOT.h"
+#include "TChain.h"
+#include "MJVetoEvent.hh"
+#include "VetoSource.hh"
+
+// An entry on its way through the pipeline.  Row is what the cut stage
+// passes on to the write stage.
+template<class Row>
+struct VetoSlot
+{
+	MJVetoEvent veto;
+	int isGood;			// WriteEvent's return value
+	long entry;
+	Row row;
+	std::atomic<long> seq;	// 4*entry + stage: 0 free, 1 decoded, 2 cut
+};
+
+struct VetoNoRow {};
+
+template<class Row = VetoNoRow>
+class VetoPipeline
+{
+	public:
+
+	typedef VetoSlot<Row> Slot;
+
+	// nThreads counts every stage, so it shouldn't include the threads given to
+	// ROOT's implicit MT (see OutputThreads, code/VetoWriter.hh).
+	// built: the run's built file ("": GATDataSet finds it).
+	// blockSize: entries a decoder takes at once.
+	VetoPipeline(int run, int *swThresh, int nThreads, std::string built = "", long blockSize = 256)
+		: fRun(run), fThresh(swThresh), fBlock(blockSize), fEntries(0), fEnd(0), fCut(0)
+	{
+		int nDecoders = (nThreads > 2) ? nThreads - 2 : 1;
+		if (nThreads > 1) ROOT::EnableThreadSafety();	// before any chain is opened
+		for (int d = 0; d < nDecoders; d++)
+		{
+			Decoder *dec = new Decoder(run,built);
+			if (dec->v == NULL) { delete dec; break; }
+			if (d == 0) fEntries = (long)dec->v->GetEntries();
+			fDecoders.push_back(dec);
+		}
+		fSerial = (nThreads <= 1 || fDecoders.size() == 0);
+		std::vector<Slot> slots(fSerial ? 1 : 2*fDecoders.size()*fBlock);
+		fSlots.swap(slots);
+	}
+
+	~VetoPipeline()
+	{
+		for (size_t d = 0; d < fDecoders.size(); d++) delete fDecoders[d];
+	}
+
+	long GetEntries() const { return fEntries; }
+
+	// From the cut stage: no entries after this one.
+	void Stop() { fEnd.store(fCut + 1); }
+
+	// Every entry goes through cut, then write (if given), in entry order.
+	// Returns the number of entries that went through (less than GetEntries() after a Stop).
+	long Run(std::function<void(Slot&)> cut, std::function<void(Slot&)> write = nullptr)
+	{
+		if (fDecoders.size() == 0) return 0;
+		fEnd.store(fEntries);
+		if (fSerial) {
+			Slot &s = fSlots[0];
+			for (long i = 0; i < fEnd.load(); i++) {
+				fCut = i;
+				Decode(*fDecoders[0],i,s);
+				cut(s);
+				if (write) write(s);
+			}
+			return fEnd.load();
+		}
+
+		const long nSlots = (long)fSlots.size();
+		for (long k = 0; k < nSlots; k++) fSlots[k].seq.store(4*k);
+
+		// decode
+		std::atomic<long> nextBlock(0);
+		std::vector<std::thread> pool;
+		for (size_t d = 0; d < fDecoders.size(); d++) {
+			Decoder *dec = fDecoders[d];
+			pool.push_back(std::thread([this,dec,nSlots,&nextBlock]() {
+				long b;
+				while ((b = nextBlock++) * fBlock < fEnd.load()) {
+					long end = (b+1)*fBlock < fEntries ? (b+1)*fBlock : fEntries;
+					for (long i = b*fBlock; i < end; i++) {
+						Slot &s = fSlots[i % nSlots];
+						if (!Wait(s,4*i,i)) break;
+						Decode(*dec,i,s);
+						s.seq.store(4*i+1,std::memory_order_release);
+					}
+				}
+			}));
+		}
+
+		// write
+		std::thread writer;
+		if (write) writer = std::thread([this,nSlots,&write]() {
+			for (long i = 0; i < fEnd.load(); i++) {
+				Slot &s = fSlots[i % nSlots];
+				if (!Wait(s,4*i+2,i)) break;
+				write(s);
+				s.seq.store(4*(i+nSlots),std::memory_order_release);
+			}
+		});
+
+		// cut
+		for (long i = 0; i < fEnd.load(); i++) {
+			fCut = i;
+			Slot &s = fSlots[i % nSlots];
+			Wait(s,4*i+1,i);
+			cut(s);
+			s.seq.store(write ? 4*i+2 : 4*(i+nSlots),std::memory_order_release);
+		}
+
+		for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+		if (writer.joinable()) writer.join();
+		return fEnd.load();
+	}
+
+	private:
+
+	// A decoder's own view of the run
+	struct Decoder
+	{
+		VetoSource *ds;
+		TChain *v;
+		MJTRun *vRun;
+		MGTBasicEvent *vEvent;
+		unsigned int mVeto;
+		uint32_t vBits;
+		Decoder(int run, std::string built) : vRun(new MJTRun()), vEvent(new MGTBasicEvent()), mVeto(0), vBits(0)
+		{
+			ds = new VetoSource(run,built);
+			v = ds->GetVetoChain();
+			if (v == NULL) return;
+			v->SetBranchAddress("run",&vRun);
+			v->SetBranchAddress("mVeto",&mVeto);
+			v->SetBranchAddress("vetoEvent",&vEvent);
+			v->SetBranchAddress("vetoBits",&vBits);
+		}
+		~Decoder() { delete ds; delete vRun; delete vEvent; }
+	};
+
+	void Decode(Decoder &d, long i, Slot &s)
+	{
+		d.v->GetEntry(i);
+		s.veto.Clear();
+		s.veto.SetSWThresh(fThresh);
+		s.isGood = s.veto.WriteEvent(i,d.vRun,d.vEvent,d.vBits,fRun,true);
+		s.entry = i;
+	}
+
+	// false if entry i is past a Stop
+	bool Wait(Slot &s, long seq, long i)
+	{
+		while (s.seq.load(std::memory_order_acquire) != seq) {
+			if (i >= fEnd.load()) return false;
+			std::this_thread::yield();
+		}
+		return i < fEnd.load();
+	}
+
+	int fRun;
+	int *fThresh;
+	long fBlock;
+	long fEntries;
+	std::atomic<long> fEnd;	// entries to go through (fEntries, unless stopped)
+	long fCut;				// the entry being cut
+	bool fSerial;
+	std::vector<Decoder*> fDecoders;
+	std::vector<Slot> fSlots;
+
+	VetoPipeline(const VetoPipeline&);
+	VetoPipeline& operator=(const VetoPipeline&);
+};
+
+#endif
@@ -0,0 +1,165 @@
+// VetoSnapshot: the parts of an MJVetoEvent the scan loops look back at,
+// in a 128-byte plain struct.  VetoRing keeps the last K of them.
+//
+// The loops used to keep "previous", "first", "last" and "previous LED" events
+// as full MJVetoEvent copies (prev = veto) on every entry.  A snapshot copy is
+// a memcpy, and the ring is a fixed array, so looking back costs no allocation:
+//
+//   VetoRing<4> history;
+//   for (...) {
+//     const VetoSnapshot &prev = history.Back();	// before this entry's Push
+//     ...
+//     history.Push(veto,isGood,i);
+//   }
+//
+// Counters and indexes are kept as 32 bits, like the hardware's.  QDC values
+// are clamped to 0-65535.  Entries that were never pushed read as zeros, like
+// a cleared MJVetoEvent.
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef VETOSNAPSHOT_HH
+#define VETOSNAPSHOT_HH
+
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+#include "MJVetoEvent.hh"
+
+struct VetoSnapshot
+{
+	uint16_t qdc[32];
+	double timeSec;			// scaler time
+	double timeSBC;
+	uint32_t sec, qec, qec2;
+	uint32_t scalerIndex, qdc1Index, qdc2Index;
+	int32_t entry;
+	uint32_t errors;		// WriteEvent's packed error code (1: no errors)
+	int32_t totE;
+	int16_t multip;
+	uint16_t flags;			// kSnapBadScaler
+	uint32_t hitMask;		// bit k: panel k over its software threshold
+
+	enum { kSnapBadScaler = 1 };
+
+	void Clear() { memset(this,0,sizeof(VetoSnapshot)); }
+
+	void Set(const MJVetoEvent &v, int isGood, long i)
+	{
+		hitMask = 0;
+		for (int k = 0; k < 32; k++) {
+			int q = v.GetQDC(k);
+			qdc[k] = (uint16_t)(q < 0 ? 0 : (q > 65535 ? 65535 : q));
+			if (q > v.GetSWThresh(k)) hitMask |= (1u << k);
+		}
+		timeSec = v.GetTimeSec();
+		timeSBC = v.GetTimeSBC();
+		sec = (uint32_t)v.GetSEC();
+		qec = (uint32_t)v.GetQEC();
+		qec2 = (uint32_t)v.GetQEC2();
+		scalerIndex = (uint32_t)v.GetScalerIndex();
+		qdc1Index = (uint32_t)v.GetQDC1Index();
+		qdc2Index = (uint32_t)v.GetQDC2Index();
+		entry = (int32_t)i;
+		errors = (uint32_t)isGood;
+		totE = v.GetTotE();
+		multip = (int16_t)v.GetMultip();
+		flags = v.GetBadScaler() ? kSnapBadScaler : 0;
+	}
+
+	// same names as MJVetoEvent's, so the loops read the same
+	double GetTimeSec() const { return timeSec; }
+	double GetTimeSBC() const { return timeSBC; }
+	long GetSEC() const { return sec; }
+	long GetQEC() const { return qec; }
+	long GetQEC2() const { return qec2; }
+	long GetScalerIndex() const { return scalerIndex; }
+	long GetQDC1Index() const { return qdc1Index; }
+	long GetQDC2Index() const { return qdc2Index; }
+	int GetQDC(int k) const { return qdc[k]; }
+	int GetTotE() const { return totE; }
+	int GetMultip() const { return multip; }
+	bool GetBadScaler() const { return flags & kSnapBadScaler; }
+	bool GetHit(int k) const { return (hitMask >> k) & 1; }
+	int GetEntry() const { return entry; }
+	int GetErrorCode() const { return (int)errors; }
+
+	// as doubles, for a checkpoint (vector<double> needs no dictionary)
+	std::vector<double> Pack() const
+	{
+		std::vector<double> p(qdc,qdc+32);
+		double f[] = {timeSec, timeSBC, (double)sec, (double)qec, (double)qec2, (double)scalerIndex,
+			(double)qdc1Index, (double)qdc2Index, (double)entry, (double)errors, (double)totE,
+			(double)multip, (double)flags, (double)hitMask};
+		p.insert(p.end(),f,f+14);
+		return p;
+	}
+
+	bool Unpack(const std::vector<double> &p)
+	{
+		if (p.size() != 46) return false;
+		for (int k = 0; k < 32; k++) qdc[k] = (uint16_t)p[k];
+		int j = 32;
+		timeSec = p[j++]; timeSBC = p[j++];
+		sec = (uint32_t)p[j++]; qec = (uint32_t)p[j++]; qec2 = (uint32_t)p[j++];
+		scalerIndex = (uint32_t)p[j++]; qdc1Index = (uint32_t)p[j++]; qdc2Index = (uint32_t)p[j++];
+		entry = (int32_t)p[j++]; errors = (uint32_t)p[j++]; totE = (int32_t)p[j++];
+		multip = (int16_t)p[j++]; flags = (uint16_t)p[j++]; hitMask = (uint32_t)p[j++];
+		return true;
+	}
+};
+
+static_assert(sizeof(VetoSnapshot) == 128, "VetoSnapshot should be 128 bytes");
+static_assert(std::is_trivially_copyable<VetoSnapshot>::value, "VetoSnapshot should be a plain struct");
+
+// The last K snapshots pushed.  Back(0) is the latest, Back(1) the one before.
+template<int K>
+class VetoRing
+{
+	static_assert(K >= 2, "a reference from Back() has to outlive the next Push");
+
+	public:
+
+	VetoRing() { Clear(); }
+
+	void Clear()
+	{
+		fHead = K-1;
+		fSize = 0;
+		fNone.Clear();
+	}
+
+	// Overwrites the oldest slot in place; returns it.
+	VetoSnapshot& Push(const MJVetoEvent &v, int isGood, long i)
+	{
+		fHead = (fHead + 1) % K;
+		if (fSize < K) fSize++;
+		fBuf[fHead].Set(v,isGood,i);
+		return fBuf[fHead];
+	}
+
+	void Push(const VetoSnapshot &s)
+	{
+		fHead = (fHead + 1) % K;
+		if (fSize < K) fSize++;
+		fBuf[fHead] = s;
+	}
+
+	const VetoSnapshot& Back(int n = 0) const
+	{
+		if (n < 0 || n >= fSize) return fNone;
+		return fBuf[(fHead - n + K) % K];
+	}
+
+	int Size() const { return fSize; }
+	bool Empty() const { return fSize == 0; }
+
+	private:
+
+	VetoSnapshot fBuf[K];
+	VetoSnapshot fNone;		// all zeros
+	int fHead, fSize;
+};
+
+#endif
@@ -0,0 +1,63 @@
+// VetoSource: where a run's veto chain comes from.
+//
+// Normally that's GATDataSet, which finds the run's files itself.  When a
+// RunWatcher is following a directory, the run's files are the ones it found
+// there (a test stand, or a copy of the data tree), so the veto chain is read
+// straight from the built file instead.  Either way, callers use it like the
+// GATDataSet it replaces:
+//
+//   VetoSource *ds = new VetoSource(run,files.built);	// "": use GATDataSet
+//   TChain *v = ds->GetVetoChain();
+//   ...
+//   delete ds;
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef VETOSOURCE_HH
+#define VETOSOURCE_HH
+
+#include <string>
+#include <cstdio>
+#include "TChain.h"
+#include "GATDataSet.hh"
+
+class VetoSource
+{
+	public:
+
+	VetoSource(int run, std::string built = "") : fDataSet(NULL), fChain(NULL), fOwnChain(NULL)
+	{
+		if (built == "") {
+			fDataSet = new GATDataSet(run);
+			fChain = fDataSet->GetVetoChain();
+			return;
+		}
+		fOwnChain = new TChain("VetoTree");
+		if (fOwnChain->Add(built.c_str()) > 0) fChain = fOwnChain;
+		else printf("VetoSource: no VetoTree in %s\n",built.c_str());
+	}
+
+	~VetoSource()
+	{
+		delete fDataSet;
+		delete fOwnChain;
+	}
+
+	// NULL if the run has no veto data
+	TChain *GetVetoChain() { return fChain; }
+
+	// Run time from the gatified data (ns), or 0 when reading the built file
+	// directly (use the run's start and stop times instead).
+	double GetRunTime() { return (fDataSet != NULL) ? fDataSet->GetRunTime() : 0; }
+
+	private:
+
+	GATDataSet *fDataSet;
+	TChain *fChain;
+	TChain *fOwnChain;	// when reading the built file
+
+	VetoSource(const VetoSource&);
+	VetoSource& operator=(const VetoSource&);
+};
+
+#endif
@@ -0,0 +1,160 @@
+// VetoWriter: the event loops hand their output to a writer thread.
+//
+// Filling a TTree means compressing its baskets, and every muon list line
+// is a write to disk.  Done in the event loop, both hold up the analysis.
+// Here the loop fills rows in a batch (Next() gives the next one, to be
+// filled in place), and when the batch is full it trades it for the one
+// the writer thread has finished with.  The two batches only take a lock
+// when they're traded, so the loop waits only if the writer is a whole
+// batch behind.  The write function is called once per row, in order, on
+// the writer thread.
+//
+//   VetoWriter<MyRow> writer([&](MyRow &r) { ...fill the tree from r... });
+//   for (...) { MyRow &r = writer.Next(); ...fill r... }
+//   writer.Flush();	// everything handed over is written when this returns
+//
+// Rows are reused: Next() gives back a row that was written a batch ago, so
+// fill all of it.  For a few big rows (one per run, say), call Send() after
+// filling one, so it goes out as soon as the writer is free.
+//
+// Also here:
+//   BufferedOfstream: an ofstream with a 1 MB buffer, so text goes out in large writes.
+//   EnableOutputMT: turn on ROOT's implicit multithreading, so a tree's
+//     baskets are compressed in parallel when it flushes them.
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef VETOWRITER_HH
+#define VETOWRITER_HH
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <fstream>
+#include "TROOT.h"
+
+template<class Row>
+class VetoWriter
+{
+	public:
+
+	VetoWriter(std::function<void(Row&)> write, size_t batchSize = 4096)
+		: fWrite(write), fFill(batchSize), fOut(batchSize), fFillN(0), fOutN(0), fStop(false)
+	{
+		fThread = std::thread([this]() { Loop(); });
+	}
+
+	~VetoWriter() { Close(); }
+
+	// The next row to fill.  It's written once the batch is handed over.
+	Row& Next()
+	{
+		if (fFillN == fFill.size()) Swap();
+		return fFill[fFillN++];
+	}
+
+	// Hand over what's been filled if the writer is free.  If it's busy,
+	// the rows go out with the next batch.
+	void Send()
+	{
+		std::unique_lock<std::mutex> lock(fLock);
+		if (fFillN == 0 || fOutN != 0) return;
+		fFill.swap(fOut);
+		fOutN = fFillN;
+		fFillN = 0;
+		lock.unlock();
+		fReady.notify_one();
+	}
+
+	// Hand over what's been filled, and wait until it's all written.
+	void Flush()
+	{
+		if (fFillN > 0) Swap();
+		std::unique_lock<std::mutex> lock(fLock);
+		fDone.wait(lock,[this]() { return fOutN == 0; });
+	}
+
+	void Close()
+	{
+		if (!fThread.joinable()) return;
+		Flush();
+		{
+			std::lock_guard<std::mutex> lock(fLock);
+			fStop = true;
+		}
+		fReady.notify_one();
+		fThread.join();
+	}
+
+	private:
+
+	// wait for the writer to finish the last batch, then trade
+	void Swap()
+	{
+		std::unique_lock<std::mutex> lock(fLock);
+		fDone.wait(lock,[this]() { return fOutN == 0; });
+		fFill.swap(fOut);
+		fOutN = fFillN;
+		fFillN = 0;
+		lock.unlock();
+		fReady.notify_one();
+	}
+
+	void Loop()
+	{
+		std::unique_lock<std::mutex> lock(fLock);
+		while (true)
+		{
+			fReady.wait(lock,[this]() { return fOutN > 0 || fStop; });
+			if (fOutN == 0 && fStop) return;
+			size_t n = fOutN;
+			lock.unlock();
+			for (size_t k = 0; k < n; k++) fWrite(fOut[k]);
+			lock.lock();
+			fOutN = 0;
+			fDone.notify_all();
+		}
+	}
+
+	std::function<void(Row&)> fWrite;
+	std::vector<Row> fFill, fOut;	// the loop's batch, and the writer's
+	size_t fFillN, fOutN;			// rows in each (fOutN = 0: the writer is free)
+	bool fStop;
+	std::mutex fLock;
+	std::condition_variable fReady, fDone;
+	std::thread fThread;
+
+	VetoWriter(const VetoWriter&);
+	VetoWriter& operator=(const VetoWriter&);
+};
+
+// An ofstream with a big buffer.  The buffer is kept across close/open.
+class BufferedOfstream : public std::ofstream
+{
+	public:
+	BufferedOfstream(size_t bufSize = 1<<20) : fBuf(bufSize) { rdbuf()->pubsetbuf(&fBuf[0],fBuf.size()); }
+	BufferedOfstream(const char *name, std::ios_base::openmode mode = std::ios_base::out, size_t bufSize = 1<<20) : fBuf(bufSize)
+	{
+		rdbuf()->pubsetbuf(&fBuf[0],fBuf.size());
+		open(name,mode);
+	}
+	private:
+	std::vector<char> fBuf;
+};
+
+// Compress tree baskets on nThreads threads (nothing if nThreads <= 1).
+inline void EnableOutputMT(int nThreads)
+{
+	if (nThreads > 1 && !ROOT::IsImplicitMTEnabled()) ROOT::EnableImplicitMT(nThreads);
+}
+
+// How many of a -j budget to give basket compression when the rest are busy
+// decoding and cutting: a quarter, or none if that's less than 2.
+inline int OutputThreads(int nThreads)
+{
+	return (nThreads/4 > 1) ? nThreads/4 : 0;
+}
+
+#endif
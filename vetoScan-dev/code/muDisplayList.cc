@@ -1,68 +1,109 @@
+// Veto hit list for the event display (scripts/vetoDisplay32.C).
+//
+// Takes a muFinder ROOT file or shard manifest.  The files are read in
+// parallel, with only the columns the list needs, and each one's lines are
+// built in memory and written in order.  An entry is listed if any of the
+// CoinType bits in coinMask is set (default 1: CoinType[0]).
+// The format (text or binary) is described in code/vetoHitList.hh.
+
+#include <algorithm>
 #include "vetoScan.hh"
+#include "code/vetoHitList.hh"
 
-void muDisplayList(string file)
+void muDisplayList(string file, bool binary, unsigned int coinMask)
 {
-	// Can handle more than one input file
-	TChain *v = new TChain("vetoEvent");
-	v->AddFile(file.c_str());
+	vector<string> files = GetShardFiles(file);
+	int nFiles = (int)files.size();
+	if (nFiles == 0) {
+		cout << "No input files found in " << file << endl;
+		return;
+	}
 
 	// Set up output files
 	string Name = file;
 	Name.erase(Name.find_last_of("."),string::npos);
 	Name.erase(0,Name.find_last_of("\\/")+1);
-	string outFile = "./output/vList_"+Name+".txt";
+	if (Name.find("_manifest") != string::npos) Name.erase(Name.find("_manifest"),string::npos);
+	string outFile = "./output/vList_"+Name+(binary ? ".bin" : ".txt");
 	cout << "Writing veto hit list: " << outFile << endl;
+	FILE *hitList = fopen(outFile.c_str(),"wb");
+	if (hitList == NULL) {
+		cout << "Couldn't open " << outFile << endl;
+		return;
+	}
+	if (binary) WriteHitListHeader(hitList);
 
-	// Output a veto hit list
-	ofstream hitList(outFile.c_str());
-
-	// Initialize output from muFinder
-	MJVetoEvent *event = NULL;
-	int CoinType[32] = {0};
-	int CutType[32] = {0};
-	double LEDfreq = 0;
-	double LEDrms = 0;
-	int highestMultip = 0;
-	Long64_t start = 0;
-	Long64_t stop = 0;
-	double xTime = 0;
-	double x_deltaT = 0;
-	v->SetBranchAddress("events",&event);
-	v->SetBranchAddress("CoinType[32]",CoinType);
-	v->SetBranchAddress("CutType[32]",CutType);
-	v->SetBranchAddress("LEDfreq",&LEDfreq);
-	v->SetBranchAddress("LEDrms",&LEDrms);
-	v->SetBranchAddress("highestMultip",&highestMultip);
-	v->SetBranchAddress("start",&start);
-	v->SetBranchAddress("stop",&stop);
-	v->SetBranchAddress("xTime",&xTime);
-	v->SetBranchAddress("x_deltaT",&x_deltaT);
-	int vEntries = v->GetEntries();
-	cout << "Found " << vEntries << " entries.\n";
-	// v->GetEntry(0);
-	// this needs to be 24 or 32, highestMultip can be wrong
-	
-	int numPanels = 32;
-
-	for (int i = 0; i < vEntries; i++)
+	vector<string> text(nFiles);
+	vector< vector<VetoHitRecord> > recs(nFiles);
+	vector<long> entries(nFiles,0);
+	RunParallel(nFiles, [&](int s)
 	{
-		v->GetEntry(i);
+		TFile *f = TFile::Open(files[s].c_str());
+		if (f == NULL || f->IsZombie()) {
+			printf("Couldn't open %s\n",files[s].c_str());
+			return;
+		}
+		TTree *v = (TTree*)f->Get("vetoEvent");
+		if (v == NULL) {
+			printf("No vetoEvent tree in %s\n",files[s].c_str());
+			f->Close();
+			return;
+		}
 
-		// hit list format:
-		// run entry QEC time qdc1 ... qdc32
+		// Initialize output from muFinder
+		MJVetoEvent *event = NULL;
+		int CoinType[32] = {0};
+		double xTime = 0;
+		SetActiveBranches(v, {"run","SEC","QDC[32]","SWThresh[32]","xTime","CoinType[32]"});
+		v->SetBranchAddress("events",&event);
+		v->SetBranchAddress("CoinType[32]",CoinType);
+		v->SetBranchAddress("xTime",&xTime);
+		long vEntries = v->GetEntries();
+		entries[s] = vEntries;
 
-		if (CoinType[0]==1) 
+		char line[500];
+		for (long i = 0; i < vEntries; i++)
 		{
-			hitList << event->GetRun() << " " << i << " " << event->GetSEC() << " " << xTime << " ";
-			for (int j=0;j<numPanels;j++)  
-			{
-				if (event->GetQDC(j) >= event->GetSWThresh(j))
-					hitList << event->GetQDC(j) << " ";
-				else 
-					hitList << 0 << " ";
+			v->GetEntry(i);
+			unsigned int coin = 0;
+			for (int j = 0; j < 32; j++) if (CoinType[j]) coin |= (1u << j);
+			if ((coin & coinMask) == 0) continue;
+
+			// hit list format:
+			// run entry SEC time qdc1 ... qdc32
+			VetoHitRecord h;
+			h.run = event->GetRun();
+			h.entry = (int32_t)i;
+			h.SEC = event->GetSEC();
+			h.xTime = xTime;
+			for (int j = 0; j < 32; j++)
+				h.qdc[j] = (event->GetQDC(j) >= event->GetSWThresh(j)) ? (uint16_t)event->GetQDC(j) : 0;
+			if (binary) {
+				recs[s].push_back(h);
+				continue;
 			}
-			hitList << endl;
+			int pos = sprintf(line,"%i %li %lli %g",h.run,i,(long long)h.SEC,h.xTime);
+			for (int j = 0; j < 32; j++) pos += sprintf(line+pos," %i",h.qdc[j]);
+			line[pos++] = '\n';
+			text[s].append(line,pos);
 		}
-	}
+		f->Close();
+		delete f;
+	});
 
-}
\ No newline at end of file
+	long totEntries = 0, nHits = 0;
+	for (int s = 0; s < nFiles; s++)
+	{
+		totEntries += entries[s];
+		if (binary && recs[s].size() > 0) {
+			fwrite(&recs[s][0],sizeof(VetoHitRecord),recs[s].size(),hitList);
+			nHits += recs[s].size();
+		}
+		else if (!binary) {
+			fwrite(text[s].data(),1,text[s].size(),hitList);
+			nHits += count(text[s].begin(),text[s].end(),'\n');
+		}
+	}
+	fclose(hitList);
+	cout << "Found " << totEntries << " entries, " << nHits << " candidates.\n";
+}
@@ -2,11 +2,40 @@
 // Clint Wiseman, USC/Majorana
 // 3/9/2016
 
+#include "TSystem.h"
 #include "vetoScan.hh"
+#include "code/RunWatcher.hh"
+#include "code/VetoSource.hh"
+#include "code/RunSet.hh"
+#include "code/vetoErrorPolicy.hh"
+#include "code/VetoSnapshot.hh"
+#include "code/VetoPipeline.hh"
+#include "code/VetoWriter.hh"
+#include "code/LEDTracker.hh"
+#include "code/RunState.hh"
 
 using namespace std;
 
-void muFinder(string Input, int *thresh, bool root, bool list)
+// One entry's output, made by the cut stage and written by the write stage
+// (see code/VetoPipeline.hh).  The per-entry branches of the output tree read from here.
+struct MuRow
+{
+	long rEntry;
+	double timeSBC;
+	double xTime;
+	double x_deltaT;
+	double x_LEDDeltaT;
+	int CoinType[32];
+	int CutType[32];
+	int PlaneHits[12];
+	int PlaneTrue[12];
+	int PlaneHitCount;
+	bool skipped;		// fatal errors: not written
+	int listType;		// muon list: 1 (2+ panels), 2 (vertical), 0 (none)
+	bool listGap;		// muon list: type 3 line for a gap since the last run
+};
+
+void muFinder(string Input, int *thresh, bool root, bool list, int runsPerShard, RunWatcher *follow, bool resume, bool twoPass)
 {
 	// LED Cut Parameters (C-f "Display Cut Parameters" below.)
 	double LEDWindow = 0.1;
@@ -26,22 +55,48 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 		for (int j=0;j<32;j++) swThresh[j] = 500;
 	}
 
-	// Input a list of run numbers
-	ifstream InputList(Input.c_str());
-	if(!InputList.good()) {
-		cout << "Couldn't open " << Input << endl;
-		return;
+	// Input a list of run numbers, or follow a data directory
+	RunSet runSet;
+	if (follow == NULL) {
+		if (!runSet.Load(Input)) return;
 	}
+	else if (runsPerShard <= 0) runsPerShard = 1;
+	RunSet::iterator runIt = runSet.begin();
 
 	// Set up output files
 	string Name = Input;
 	Name.erase(Name.find_last_of("."),string::npos);
 	Name.erase(0,Name.find_last_of("\\/")+1);
 
+	// Checkpoint, written after every run (or every shard) and removed when the scan finishes.
+	// Holds: runsDone prevStopTime JumpCount treeEntries listBytes shardNum manifestBytes
+	string ckptName = "./output/"+Name+"_ckpt.txt";
+	vector<double> ckpt;
+	if (resume && follow == NULL) {
+		ckpt = ReadCheckpoint(ckptName);
+		if (ckpt.size() != 7) {
+			cout << "No usable checkpoint " << ckptName << ", starting from the beginning.\n";
+			ckpt.clear();
+		}
+		else printf("Resuming from %s: %i runs already done.\n",ckptName.c_str(),(int)ckpt[0]);
+	}
+	bool resuming = (ckpt.size() > 0);
+
 	// Output 1: Text file muon list (used in skim files)
+	// With runsPerShard > 0, the output is split into shards of that many runs,
+	// and a manifest is written that muMerge and muListGen can read.
+	// When following, the ROOT output is sharded and the muon list is a single
+	// rolling file that gets appended to after every run.
+	bool sharded = (runsPerShard > 0);
+	bool shardLists = (sharded && follow == NULL);
 	string outName = "./output/MuonList_"+Name+".txt";
-	ofstream MuonList(outName.c_str());
-	if (!list) MuonList.close();
+	BufferedOfstream MuonList;	// written by the pipeline's write stage
+	if (list && follow != NULL) MuonList.open(outName.c_str(),ios::app);
+	else if (list && !sharded && resuming) {
+		truncate(outName.c_str(),(off_t)ckpt[4]);	// drop anything written after the checkpoint
+		MuonList.open(outName.c_str(),ios::app);
+	}
+	else if (list && !sharded) MuonList.open(outName.c_str());
 
 	// Output 2: ROOT output
 	int isGood;
@@ -49,7 +104,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 	long rEntry;
 	long start;
 	long stop;
-	long prevStopTime = 0;
+	long prevStopTime = resuming ? (long)ckpt[1] : 0;
 	double duration;
 	int CoinType[32];
 	int CutType[32];
@@ -65,15 +120,52 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 	double x_LEDDeltaT = 0;
 	double timeSBC = 0;
 	Char_t OutputFile[200];
-	sprintf(OutputFile,"./output/%s.root",Name.c_str());
-	TFile *RootFile = new TFile(OutputFile, "RECREATE");
-  	TH1::AddDirectory(kFALSE); // Global flag: "When a (root) file is closed, all histograms in memory associated with this file are automatically deleted."
-	TTree *vetoEvent = new TTree("vetoEvent","MJD Veto Events");
+	TFile *RootFile = NULL;
+	TTree *vetoEvent = NULL;
 	MJVetoEvent out;
-	if (root) {
-		vetoEvent->Branch("events","MJVetoEvent",&out,32000,1);
-		vetoEvent->Branch("rEntry",&rEntry,"rEntry/L");
-		vetoEvent->Branch("timeSBC",&timeSBC);
+	MJVetoEvent *outPtr = &out;	// the events branch reads the event this points to
+	MuRow outRow;
+	// The -j threads are split between compressing baskets and the pipeline below.
+	int outThreads = root ? OutputThreads(GetNumThreads()) : 0;
+	EnableOutputMT(outThreads);
+	auto bookTree = [&](bool attach)
+	{
+		// pick up the checkpointed tree and keep filling it
+		if (attach) {
+			vetoEvent = (TTree*)RootFile->Get("vetoEvent");
+			if (vetoEvent != NULL) {
+				if ((long)vetoEvent->GetEntries() != (long)ckpt[3])
+					printf("Warning: checkpointed tree has %lli entries, expected %li\n",vetoEvent->GetEntries(),(long)ckpt[3]);
+				vetoEvent->SetBranchAddress("events",&outPtr);
+				vetoEvent->SetBranchAddress("rEntry",&outRow.rEntry);
+				vetoEvent->SetBranchAddress("timeSBC",&outRow.timeSBC);
+				vetoEvent->SetBranchAddress("LEDfreq",&LEDfreq);
+				vetoEvent->SetBranchAddress("LEDrms",&LEDrms);
+				vetoEvent->SetBranchAddress("multipThreshold",&multipThreshold);
+				vetoEvent->SetBranchAddress("highestMultip",&highestMultip);
+				vetoEvent->SetBranchAddress("LEDWindow",&LEDWindow);
+				vetoEvent->SetBranchAddress("LEDMultipThreshold",&LEDMultipThreshold);
+				vetoEvent->SetBranchAddress("LEDSimpleThreshold",&LEDSimpleThreshold);
+				vetoEvent->SetBranchAddress("start",&start);
+				vetoEvent->SetBranchAddress("stop",&stop);
+				vetoEvent->SetBranchAddress("duration",&duration);
+				vetoEvent->SetBranchAddress("xTime",&outRow.xTime);
+				vetoEvent->SetBranchAddress("x_deltaT",&outRow.x_deltaT);
+				vetoEvent->SetBranchAddress("x_LEDDeltaT",&outRow.x_LEDDeltaT);
+				vetoEvent->SetBranchAddress("CoinType[32]",outRow.CoinType);
+				vetoEvent->SetBranchAddress("CutType[32]",outRow.CutType);
+				vetoEvent->SetBranchAddress("PlaneHits[12]",outRow.PlaneHits);
+				vetoEvent->SetBranchAddress("PlaneTrue[12]",outRow.PlaneTrue);
+				vetoEvent->SetBranchAddress("PlaneHitCount",&outRow.PlaneHitCount);
+				return;
+			}
+			cout << "Warning: couldn't find the checkpointed tree.  Starting a new one.\n";
+		}
+		vetoEvent = new TTree("vetoEvent","MJD Veto Events");
+		if (!root) return;
+		vetoEvent->Branch("events","MJVetoEvent",&outPtr,32000,1);
+		vetoEvent->Branch("rEntry",&outRow.rEntry,"rEntry/L");
+		vetoEvent->Branch("timeSBC",&outRow.timeSBC);
 		vetoEvent->Branch("LEDfreq",&LEDfreq);
 		vetoEvent->Branch("LEDrms",&LEDrms);
 		vetoEvent->Branch("multipThreshold",&multipThreshold);
@@ -84,23 +176,114 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 		vetoEvent->Branch("start",&start,"start/L");
 		vetoEvent->Branch("stop",&stop,"stop/L");
 		vetoEvent->Branch("duration",&duration);
-		vetoEvent->Branch("xTime",&xTime);
-		vetoEvent->Branch("x_deltaT",&x_deltaT);
-		vetoEvent->Branch("x_LEDDeltaT",&x_LEDDeltaT);
-		vetoEvent->Branch("CoinType[32]",CoinType,"CoinType[32]/I");
-		vetoEvent->Branch("CutType[32]",CutType,"CutType[32]/I");
-		vetoEvent->Branch("PlaneHits[12]",PlaneHits,"PlaneHits[12]/I");
-		vetoEvent->Branch("PlaneTrue[12]",PlaneTrue,"PlaneTrue[12]/I");
-		vetoEvent->Branch("PlaneHitCount",&PlaneHitCount);
+		vetoEvent->Branch("xTime",&outRow.xTime);
+		vetoEvent->Branch("x_deltaT",&outRow.x_deltaT);
+		vetoEvent->Branch("x_LEDDeltaT",&outRow.x_LEDDeltaT);
+		vetoEvent->Branch("CoinType[32]",outRow.CoinType,"CoinType[32]/I");
+		vetoEvent->Branch("CutType[32]",outRow.CutType,"CutType[32]/I");
+		vetoEvent->Branch("PlaneHits[12]",outRow.PlaneHits,"PlaneHits[12]/I");
+		vetoEvent->Branch("PlaneTrue[12]",outRow.PlaneTrue,"PlaneTrue[12]/I");
+		vetoEvent->Branch("PlaneHitCount",&outRow.PlaneHitCount);
+	};
+
+	// Shard bookkeeping.  Shards are named by their first run and go in ./output/<Name>_shards/
+	string shardDir = "./output/"+Name+"_shards";
+	string manifestName = "./output/"+Name+"_manifest.txt";
+	ofstream Manifest;
+	int shardNum = resuming ? (int)ckpt[5] : 0;
+	int shardRuns = 0;
+	int shardFirstRun = 0;
+	int shardLastRun = 0;
+	string shardList = "";
+	if (sharded) {
+		gSystem->mkdir(shardDir.c_str(),kTRUE);
+		if (resuming) truncate(manifestName.c_str(),(off_t)ckpt[6]);
+		if ((follow != NULL || resuming) && !gSystem->AccessPathName(manifestName.c_str()))
+			Manifest.open(manifestName.c_str(),ios::app);
+		else {
+			Manifest.open(manifestName.c_str());
+			Manifest << "# shardFile listFile firstRun lastRun nRuns entries\n";
+		}
+		printf("Writing shards of %i runs to %s\n",runsPerShard,shardDir.c_str());
 	}
+	auto openOutput = [&]()
+	{
+		if (sharded) {
+			sprintf(OutputFile,"%s/%s_run%i.root",shardDir.c_str(),Name.c_str(),shardFirstRun);
+			char listName[300];
+			sprintf(listName,"%s/MuonList_%s_run%i.txt",shardDir.c_str(),Name.c_str(),shardFirstRun);
+			shardList = (list && shardLists) ? listName : "-";
+			if (list && shardLists) MuonList.open(listName);
+		}
+		else sprintf(OutputFile,"./output/%s.root",Name.c_str());
+		bool attach = (resuming && !sharded && root);
+		RootFile = new TFile(OutputFile, attach ? "UPDATE" : "RECREATE");
+	  	TH1::AddDirectory(kFALSE); // Global flag: "When a (root) file is closed, all histograms in memory associated with this file are automatically deleted."
+		bookTree(attach);
+	};
+	auto closeOutput = [&]()
+	{
+		if (root) vetoEvent->Write("",TObject::kOverwrite);	// replaces the checkpoint copy
+		long entries = (long)vetoEvent->GetEntries();
+		RootFile->Close();
+		delete RootFile;
+		RootFile = NULL;
+		if (list && !sharded) MuonList.close();
+		if (shardLists && list) MuonList.close();
+		if (sharded) {
+			Manifest << OutputFile << " " << shardList << " " << shardFirstRun << " "
+			         << shardLastRun << " " << shardRuns << " " << entries << "\n";
+			Manifest.flush();
+			shardNum++;
+			shardRuns = 0;
+		}
+	};
+	if (!sharded) openOutput();
 
 	// Loop over files.
-	int JumpCount = 0;	// scaler jump counter
-	while(!InputList.eof()){
+	int JumpCount = resuming ? (int)ckpt[2] : 0;	// scaler jump counter
+	RunWatcher::RunFiles files;	// when following, the run is read from the watched directory
+	auto nextRun = [&](int &r) -> bool
+	{
+		if (follow != NULL) return follow->Next(r,&files);
+		if (runIt == runSet.end()) return false;
+		r = *runIt;
+		++runIt;
+		return true;
+	};
+	int runsDone = 0;
+	RunState last;	// the last run's LED period, panels and SBC offset (code/RunState.hh)
+	auto checkpoint = [&]()
+	{
+		if (follow != NULL) return;
+		long listBytes = 0, manifestBytes = 0;
+		if (!sharded) {
+			if (root) vetoEvent->AutoSave("SaveSelf");
+			if (list) {
+				MuonList.flush();
+				listBytes = GetFileSize(outName);
+			}
+		}
+		else {
+			Manifest.flush();
+			manifestBytes = GetFileSize(manifestName);
+		}
+		long entries = (vetoEvent != NULL) ? (long)vetoEvent->GetEntries() : 0;
+		WriteCheckpoint(ckptName, {(double)runsDone, (double)prevStopTime, (double)JumpCount,
+			(double)entries, (double)listBytes, (double)shardNum, (double)manifestBytes});
+	};
+	if (resuming) {
+		while (runsDone < (int)ckpt[0] && nextRun(run)) runsDone++;
+		printf("Skipped %i runs, continuing after run %i.\n",runsDone,run);
+	}
+	while(nextRun(run)){
 
 		// initialize
-		InputList >> run;
-		GATDataSet *ds = new GATDataSet(run);
+		if (sharded && RootFile == NULL) {
+			shardFirstRun = run;
+			openOutput();
+		}
+		VetoSource *ds = new VetoSource(run,files.built);
 		TChain *v = ds->GetVetoChain();
 		long vEntries = v->GetEntries();
 		MJTRun *vRun = new MJTRun();
@@ -115,6 +298,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 		start = (long)vRun->GetStartTime();
 		stop = (long)vRun->GetStopTime();
 		duration = ds->GetRunTime()/CLHEP::second;
+		if (duration <= 0) duration = (double)(stop - start);
 
 		printf("\n======= Scanning run %i, %li entries, %.0f sec. =======\n",run,vEntries,duration);
 		cout << "start: " << start << "  stop: " << stop << endl;
@@ -127,39 +311,51 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 		// doesn't need to be exact, and should also work for runs where there were
 		// only 24 panels installed.
 		//
+		// Unless twoPass is set, the LED tracker (code/LEDTracker.hh) follows the
+		// same entries, and this loop stops as soon as it has locked on and the
+		// first good entry is found.  The 2nd loop then cuts with the tracker's
+		// period, and does this loop's measurements for the rest of the run.
+		// They're checked against the tracker at the end ("Check the LED lock").
+		//
+		// A run that follows one with a good LED period starts warm: the tracker
+		// is seeded with that period, so this loop only has to find the first
+		// good entry, and the panel count is the last run's.  If the SBC offset
+		// isn't the one the last run predicts, it measures the whole run instead.
+		//
 		bool badLEDFreq = false;
-		MJVetoEvent prev;
+		VetoRing<2> measureHistory;	// previous good entries (code/VetoSnapshot.hh)
 		char hname[200];
 		sprintf(hname,"LEDDeltaT_run%i",run);
 		TH1F *LEDDeltaT = new TH1F(hname,hname,100000,0,100); // 0.001 sec/bin
-		highestMultip = 0;	// try to predict how many panels there are for this run.
+		int measuredMultip = 0;	// try to predict how many panels there are for this run.
 		long skippedEvents = 0;
+		VetoErrorCounts runErrors;	// added to the policy's counts once the run is done
 		long corruptScaler = 0;
 		bool foundFirst = false;
 		int firstGoodEntry = 0;
-		MJVetoEvent first;
-		highestMultip=0;
-		for (long i = 0; i < vEntries; i++)
+		VetoSnapshot first;
+		first.Clear();
+		LEDTracker tracker(LEDWindow);
+		bool tracking = (!twoPass && vEntries >= 100);
+		bool warm = (tracking && last.LEDperiod > 0 && last.WarmFor(run,start));
+		if (warm) tracker.Seed(last.LEDperiod);
+		auto measure = [&](MJVetoEvent &veto, long i, int isGood)
 		{
-			v->GetEntry(i);
-			MJVetoEvent veto;
-			veto.SetSWThresh(swThresh);
-	    	isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);
-    		if (CheckForBadErrors(veto,i,isGood,false)) {
+    		if (GetErrorPolicy().Check(veto,i,isGood,runErrors)) {
     			skippedEvents++;
-    			continue;
+    			return;
     		}
 
 	    	if (veto.GetBadScaler()) corruptScaler++;
 
-	    	if (veto.GetMultip() > highestMultip && veto.GetMultip() < 33) {
-	    		highestMultip = veto.GetMultip();
-	    		cout << "Finding highest multiplicity: " << highestMultip << "  entry: " << i << endl;
+	    	if (veto.GetMultip() > measuredMultip && veto.GetMultip() < 33) {
+	    		measuredMultip = veto.GetMultip();
+	    		cout << "Finding highest multiplicity: " << measuredMultip << "  entry: " << i << endl;
 	    	}
 
 	    	// Save the first good entry number for the SBC offset time
 			if (isGood && !foundFirst && veto.GetTimeSBC()>0.01 && veto.GetTimeSec()>0.01 && !veto.GetBadScaler()) {
-				first = veto;
+				first.Set(veto,isGood,i);
 				foundFirst = true;
 				firstGoodEntry = i;
 			}
@@ -170,57 +366,104 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 
 	    	// Very simple LED tag.
 			if (veto.GetMultip() >= 20) {
-				LEDDeltaT->Fill(veto.GetTimeSec()-prev.GetTimeSec());
+				LEDDeltaT->Fill(veto.GetTimeSec()-measureHistory.Back().GetTimeSec());
+				if (tracking && !veto.GetBadScaler()) tracker.Add(veto.GetTimeSec());
 			}
-			prev = veto;
-		}
+			measureHistory.Push(veto,isGood,i);
+		};
+
+		// The entries are decoded on the other threads, and come back here in order.
+		VetoPipeline<MuRow> pipe(run,swThresh,GetNumThreads()-outThreads,files.built);
+		long measured = pipe.Run([&](VetoSlot<MuRow> &s)
+		{
+			measure(s.veto,s.entry,s.isGood);
+			if (warm && foundFirst && !last.SBCHolds(first.GetTimeSBC()-first.GetTimeSec(),start)) {
+				printf("SBC offset isn't the one run %i predicts.  Not starting from it.\n",last.run);
+				warm = false;
+				tracking = false;
+			}
+			if (tracking && tracker.Locked() && foundFirst) pipe.Stop();
+		});
+		bool locked = (tracking && tracker.Locked() && measured < vEntries);
+
 		// Find the SBC offset
 		double SBCOffset = first.GetTimeSBC() - first.GetTimeSec();
 		printf("First good entry: %i  Scaler %.2f  SBC %.2f  SBCOffset %.2f\n"
 			,firstGoodEntry,first.GetTimeSec(),first.GetTimeSBC(),SBCOffset);
 
-		// Find the LED frequency
-		if (skippedEvents > 0) printf("Skipped %li of %li entries.\n",skippedEvents,vEntries);
-		// if (corruptScaler > 0) printf("Corrupt scaler: %li of %li entries (%.2f%%) .\n"
-			// ,corruptScaler,vEntries,100*(double)corruptScaler/vEntries);
+		// LED frequency from the histogram.  False if it's empty.
+		auto histLED = [&](double &freq, double &rms) -> bool
+		{
+			if (LEDDeltaT->GetEntries() <= 0) return false;
+			int maxbin = LEDDeltaT->GetMaximumBin();
+			LEDDeltaT->GetXaxis()->SetRange(maxbin-100,maxbin+100); // looks at +/- 0.1 seconds of max bin.
+			rms = LEDDeltaT->GetRMS();
+			if (rms==0) rms = 0.1;
+			freq = 1/LEDDeltaT->GetMean();
+			return true;
+		};
 
+		// Set the LED cut parameters from LEDfreq and the highest multiplicity
 		bool LEDTurnedOff = false;
-		if (highestMultip < 20) {
-			printf("Warning!  LED's may be off!\n");
-			LEDTurnedOff = true;
+		double LEDperiod = 0;
+		auto setLEDCut = [&](bool haveFreq, int hm)
+		{
+			highestMultip = hm;
+			LEDTurnedOff = false;
+			if (highestMultip < 20) {
+				printf("Warning!  LED's may be off!\n");
+				LEDTurnedOff = true;
+			}
+			if (!haveFreq) {
+				printf("Warning! No multiplicity > 20 events!!\n");
+				LEDrms = 9999;
+				LEDfreq = 9999;
+				LEDTurnedOff = true;
+			}
+			LEDperiod = 1/LEDfreq;
+
+			// Display LED Cut parameters
+			multipThreshold = highestMultip - LEDMultipThreshold;
+			printf("HM: %i LED_f: %.8f LED_t: %.8f RMS: %8f\n",highestMultip,LEDfreq,1/LEDfreq,LEDrms);
+			printf("LED window: %.2f  Multip Threshold: %i\n",LEDWindow,multipThreshold);
+			badLEDFreq = false;
+			if (LEDperiod > 9 || vEntries < 100) {
+				badLEDFreq = true;
+				printf("Warning: LED period is %.2f, total entries: %li.  Can't use it in the time cut!\n",LEDperiod,vEntries);
+			}
+		};
+
+		// Find the LED frequency
+		if (locked && warm) {
+			printf("Starting from run %i's LED period after %li of %li entries.\n",last.run,measured,vEntries);
+			LEDfreq = 1/tracker.GetPeriod();
+			LEDrms = last.LEDrms;
+			setLEDCut(true,last.highestMultip);
 		}
-		LEDrms = 0;
-		LEDfreq = 0;
-		int dtEntries = LEDDeltaT->GetEntries();
-		if (dtEntries > 0) {
-			int maxbin = LEDDeltaT->GetMaximumBin();
-			LEDDeltaT->GetXaxis()->SetRange(maxbin-100,maxbin+100); // looks at +/- 0.1 seconds of max bin.
-			LEDrms = LEDDeltaT->GetRMS();
-			if (LEDrms==0) LEDrms = 0.1;
-			LEDfreq = 1/LEDDeltaT->GetMean();
+		else if (locked) {
+			printf("LED tracker locked after %li of %li entries.\n",measured,vEntries);
+			LEDfreq = 1/tracker.GetPeriod();
+			LEDrms = tracker.GetRMS();
+			setLEDCut(true,measuredMultip);
 		}
 		else {
-			printf("Warning! No multiplicity > 20 events!!\n");
-			LEDrms = 9999;
-			LEDfreq = 9999;
-			LEDTurnedOff = true;
+			if (tracking) printf("LED tracker didn't lock.  Measuring over the whole run.\n");
+			if (skippedEvents > 0) printf("Skipped %li of %li entries.\n",skippedEvents,vEntries);
+			// if (corruptScaler > 0) printf("Corrupt scaler: %li of %li entries (%.2f%%) .\n"
+				// ,corruptScaler,vEntries,100*(double)corruptScaler/vEntries);
+			LEDrms = 0;
+			LEDfreq = 0;
+			setLEDCut(histLED(LEDfreq,LEDrms),measuredMultip);
 		}
-		double LEDperiod = 1/LEDfreq;
-
-		// Display LED Cut parameters
-		multipThreshold = highestMultip - LEDMultipThreshold;
-		printf("HM: %i LED_f: %.8f LED_t: %.8f RMS: %8f\n",highestMultip,LEDfreq,1/LEDfreq,LEDrms);
-		printf("LED window: %.2f  Multip Threshold: %i\n",LEDWindow,multipThreshold);
-		if (LEDperiod > 9 || vEntries < 100) {
-			badLEDFreq = true;
-			printf("Warning: LED period is %.2f, total entries: %li.  Can't use it in the time cut!\n",LEDperiod,vEntries);
-		}
-		delete LEDDeltaT;
 
 		// ========= 2nd loop over veto entries - Find muons! =========
 		//
-		prev.Clear();
-		MJVetoEvent prevLED;
+		// With the tracker locked (speculative), each entry is cut with the period
+		// the tracker predicts from the LEDs before it, and the calls made on
+		// high-multiplicity entries are kept, to be checked at the end of the run.
+		//
+		VetoRing<2> history;
+		VetoRing<2> prevLEDs;
 		double xTimePrev = 0;
 		double x_deltaTPrev = 0;
 		double xTimePrevLED = 0;
@@ -229,15 +472,25 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 		// bool IsLEDPrev = false;
 		int almostMissedLED = 0;
 		double TSdifference = 0;
-		for (long i = 0; i < vEntries; i++)
-		// for (long i = 250; i < 300; i++)
+		bool speculative = false;
+		struct LEDCall { double x_deltaT; int call; };	// call: 1 in the LED window, 2 almost missed, 0 neither
+		vector<LEDCall> ledCalls;
+		string runLines;	// this run's muon list lines, written once the run is done
+		struct HeldRow { MuRow row; MJVetoEvent veto; };
+		vector<HeldRow> heldRows;	// a speculative run's tree entries, filled once the LED lock holds
+		auto cutEntry = [&](VetoSlot<MuRow> &s)
 		{
-			v->GetEntry(i);
+			long i = s.entry;
 			rEntry = i;	// save ROOT entry in output
-			MJVetoEvent veto;
-			veto.SetSWThresh(swThresh);
-    	isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);
+			MJVetoEvent &veto = s.veto;	// written straight from the slot
+			isGood = s.isGood;
+			MuRow &row = s.row;
+			row.skipped = true;
 			timeSBC = veto.GetTimeSBC()-SBCOffset;
+			if (speculative) {
+				if (tracker.Locked()) LEDperiod = tracker.GetPeriod();	// predicted from the LEDs before this entry
+				if (i >= measured) measure(veto,i,isGood);	// the 1st loop's job, for the entries it didn't get to
+			}
 
     	//----------------------------------------------------------
 			// 0: Time of event and skipping if necessary.
@@ -285,7 +538,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 	    	}
 
 	    	// Skip events after the event time is calculated.
-	    	if (CheckForBadErrors(veto,i,isGood,false))
+	    	if (GetErrorPolicy().IsFatal(isGood))
 	    	{
 	    		printf("Skipping Entry %li.  Errors: ",i);
 
@@ -305,7 +558,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 				// prev = veto;
 				xTimePrev = xTime;
 				x_deltaTPrev = x_deltaT;
-	    		continue;
+	    		return;
 	    	}
 
 			//----------------------------------------------------------
@@ -318,6 +571,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 			//
 			bool TimeCut = true;
 			bool IsLED = false;
+			int call = 0;
 
 			// Set Cut
 			x_deltaT = xTime - xTimePrevLED;
@@ -325,6 +579,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 			{
 				TimeCut = false;
 				IsLED = true;
+				call = 1;
 			}
 
 			// almost missed a high-multiplicity event somehow ...
@@ -333,6 +588,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 			{
 				TimeCut = false;
 				IsLED = true;
+				call = 2;
 				almostMissedLED++;
 				cout << "Almost missed LED:\n";
 
@@ -348,6 +604,7 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 					,IsLED,TimeCut,LEDTurnedOff,badLEDFreq);
 			}
 			else TimeCut = true;
+			if (speculative && !LEDTurnedOff && veto.GetMultip() > multipThreshold) ledCalls.push_back(LEDCall{x_deltaT,call});
 
 			// Grab first LED
 			if (!LEDTurnedOff && !firstLED && veto.GetMultip() > multipThreshold) {
@@ -477,26 +734,15 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 
 			//----------------------------------------------------------
 			// 5: Output
-			// The skim file used to take a text file of muon candidate events.
-			// Additionally, write the ROOT file containing all the real data.
+			// Passed to the write stage in the slot's row.
 			//
 
-			// Write a text file
-			if (list) {
-				char buffer[200];
-				if (CoinType[1] || CoinType[0]) {
-					int type;
-					if (CoinType[0]) type = 1;
-					if (CoinType[1]) type = 2;
-					sprintf(buffer,"%i %li %.8f %i %i\n",run,start,xTime,type,veto.GetBadScaler());
-					MuonList << buffer;
-				}
-				// This is Jason's TYPE 3: flag runs with gaps since the last stop time.
-				if ((start - prevStopTime) > 10 && i == 0) {
-					sprintf(buffer,"%i %li 0.0 3 0\n",run,start);
-					MuonList << buffer;
-				}
-			}
+			// muon list line type
+			row.listType = 0;
+			if (CoinType[0]) row.listType = 1;
+			if (CoinType[1]) row.listType = 2;
+			// This is Jason's TYPE 3: flag runs with gaps since the last stop time.
+			row.listGap = ((start - prevStopTime) > 10 && i == 0);
 
 			// Assign all bools calculated to the int array CutType[32];
 			CutType[0] = LEDTurnedOff;
@@ -507,26 +753,122 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 			CutType[5] = firstLED;
 			CutType[6] = badLEDFreq;
 
-			// Write ROOT output
-			if (root) {
-				out = veto;
-				vetoEvent->Fill();
-			}
+			// ROOT output
+			row.skipped = false;
+			row.rEntry = rEntry;
+			row.timeSBC = timeSBC;
+			row.xTime = xTime;
+			row.x_deltaT = x_deltaT;
+			row.x_LEDDeltaT = x_LEDDeltaT;
+			memcpy(row.CoinType,CoinType,sizeof(CoinType));
+			memcpy(row.CutType,CutType,sizeof(CutType));
+			memcpy(row.PlaneHits,PlaneHits,sizeof(PlaneHits));
+			memcpy(row.PlaneTrue,PlaneTrue,sizeof(PlaneTrue));
+			row.PlaneHitCount = PlaneHitCount;
 
 			// Reset for next entry
 			//----------------------------------------------------------
 			if (IsLED) {
-				prevLED = veto;
+				prevLEDs.Push(veto,isGood,i);
 				xTimePrevLED = xTime;
 			}
 			if (veto.GetMultip() > multipThreshold) {
 				xTimePrevLEDSimple = xTime;
 			}
 			// IsLEDPrev = IsLED;
-			prev = veto;
+			history.Push(veto,isGood,i);
 			xTimePrev = xTime;
 			x_deltaTPrev = x_deltaT;
-	    }
+		};
+		auto writeEntry = [&](VetoSlot<MuRow> &s)
+		{
+			// ========= Write: the muon list and the ROOT tree, in entry order =========
+			//
+			// The skim file used to take a text file of muon candidate events.
+			// Additionally, write the ROOT file containing all the real data.
+			//
+			if (s.row.skipped) return;
+			if (list) {
+				char buffer[200];
+				if (s.row.listType > 0) {
+					sprintf(buffer,"%i %li %.8f %i %i\n",run,start,s.row.xTime,s.row.listType,s.veto.GetBadScaler());
+					runLines += buffer;
+				}
+				if (s.row.listGap) {
+					sprintf(buffer,"%i %li 0.0 3 0\n",run,start);
+					runLines += buffer;
+				}
+			}
+			if (root && speculative) heldRows.push_back(HeldRow{s.row,s.veto});
+			else if (root) {
+				outRow = s.row;
+				outPtr = &s.veto;
+				vetoEvent->Fill();
+			}
+		};
+		auto findMuons = [&](bool spec)
+		{
+			speculative = spec;
+			history.Clear();
+			prevLEDs.Clear();
+			xTimePrev = x_deltaTPrev = xTimePrevLED = xTimePrevLEDSimple = 0;
+			firstLED = false;
+			almostMissedLED = 0;
+			TSdifference = 0;
+			ledCalls.clear();
+			runLines.clear();
+			heldRows.clear();
+			pipe.Run(cutEntry,writeEntry);
+			outPtr = &out;
+		};
+		int jumpsBefore = JumpCount;
+		findMuons(locked);
+
+		// ========= Check the LED lock =========
+		// The 1st loop's measurements are complete now.  If they'd have given a
+		// different panel count, a bad LED frequency, or a different call on any
+		// high-multiplicity entry, the run is done again the old way.  Until then
+		// its tree entries are held back, so there's nothing to take out of the tree.
+		//
+		if (locked)
+		{
+			if (skippedEvents > 0) printf("Skipped %li of %li entries.\n",skippedEvents,vEntries);
+			double histFreq = 0, histRMS = 0;
+			bool haveFreq = histLED(histFreq,histRMS);
+			double histPeriod = haveFreq ? 1/histFreq : 0;
+			int changed = 0;
+			for (auto &c : ledCalls) {
+				int call = 0;
+				if (fabs(histPeriod - c.x_deltaT) < LEDWindow) call = 1;
+				else if (fabs(histPeriod - c.x_deltaT) >= (histPeriod - LEDWindow)) call = 2;
+				if (call != c.call) changed++;
+			}
+			printf("LED tracker: %li LEDs, %li missed, %i lost.  Period %.6f, measured %.6f.  %i of %i calls changed.\n",
+				tracker.GetLEDs(),tracker.GetMissed(),tracker.GetLost(),tracker.GetPeriod(),histPeriod,changed,(int)ledCalls.size());
+			if (!haveFreq || histPeriod > 9 || measuredMultip != highestMultip || changed > 0)
+			{
+				printf("The LED lock didn't hold.  Scanning run %i again with the measured LED period.\n",run);
+				JumpCount = jumpsBefore;
+				LEDfreq = histFreq;
+				LEDrms = histRMS;
+				setLEDCut(haveFreq,measuredMultip);
+				findMuons(false);
+			}
+			else for (auto &h : heldRows) {
+				outRow = h.row;
+				outPtr = &h.veto;
+				vetoEvent->Fill();
+			}
+			heldRows.clear();
+			outPtr = &out;
+		}
+		GetErrorPolicy().Add(runErrors);
+		if (list) MuonList << runLines;
+		delete LEDDeltaT;
+
+		// the next run starts from this one if the LED cut was good
+		if (!LEDTurnedOff && !badLEDFreq) last.Set(run,start,highestMultip,LEDperiod,LEDrms,SBCOffset);
+		else last.Clear();
 
 	    // End of run summaries.
 		if (almostMissedLED > 0) cout << "\nWarning, almost missed " << almostMissedLED << " LED events.\n";
@@ -534,13 +876,30 @@ void muFinder(string Input, int *thresh, bool root, bool list)
 	    // done with this run.
 		delete ds;
 		prevStopTime = stop;
+
+		// close the shard once it has enough runs
+		runsDone++;
+		if (sharded) {
+			shardRuns++;
+			shardLastRun = run;
+			if (shardRuns == runsPerShard) {
+				closeOutput();
+				checkpoint();
+			}
+		}
+		else checkpoint();
+		if (follow != NULL && list) MuonList.flush();
 	}
 
 	printf("\n===================== End of Scan. =====================\n");
 
 	if (JumpCount > 0) cout << "\nWarning, found " << JumpCount << " scaler jumps.\n";
 
-	if (list) MuonList.close();
-	if (root) vetoEvent->Write();
-	RootFile->Close();
+	if (RootFile != NULL) closeOutput();
+	if (list && follow != NULL) MuonList.close();
+	if (sharded) {
+		Manifest.close();
+		printf("Wrote %i shards.  Manifest: %s\n",shardNum,manifestName.c_str());
+	}
+	if (follow == NULL) remove(ckptName.c_str());
 }
@@ -1,81 +1,128 @@
 // Generate a list of muon-induced events from muFinder ROOT output.
 // Used in the DEMONSTRATOR Veto Cut.
 //
+// Takes a shard manifest written by muFinder (or a single muFinder ROOT file)
+// and reads the shards in parallel.  The list comes out in manifest order.
+//
 // Clint Wiseman, USC/Majorana
 // 4/22/16
 
 #include "vetoScan.hh"
 using namespace std;
+
+// muon list lines for one run in a shard
+struct MuListRun {
+	int run;
+	long start;
+	long stop;
+	string lines;
+	size_t firstLen;	// length of the line from the run's first entry (if any)
+};
+
 void muListGen(string arg) 
 {
-	TChain *v = new TChain("vetoEvent");
-	
-	// Input chain: can handle more than one file.
-	// v->AddFile(arg.c_str());
-	v->AddFile("./output/DS1_01.root");
-	v->AddFile("./output/DS1_02.root");
-	v->AddFile("./output/DS1_03.root");
-	v->AddFile("./output/DS1_04.root");
-	v->AddFile("./output/DS1_05.root");
-	v->AddFile("./output/DS1_06.root");
+	vector<string> files = GetShardFiles(arg);
+	int nFiles = (int)files.size();
+	if (nFiles == 0) {
+		cout << "No input files found in " << arg << endl;
+		return;
+	}
 
 	// Output: Text file muon list (used in skim files)
-	string Name = "DS1";
+	string Name = arg;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
+	if (Name.find("_manifest") != string::npos) Name.erase(Name.find("_manifest"),string::npos);
 	string outName = "./output/MuonList_"+Name+".txt";
-	ofstream MuonList(outName.c_str());
+	printf("Building %s from %i files with %i threads.\n",outName.c_str(),nFiles,min(nFiles,GetNumThreads()));
 
-	// initialize muFinder ROOT output
-	MJVetoEvent *event = NULL;
-	double LEDfreq=0,LEDrms=0,LEDWindow=0,xTime=0,x_deltaT=0,x_LEDDeltaT=0;
-	int multipThreshold=0,highestMultip=0,LEDMultipThreshold=0,LEDSimpleThreshold=0,PlaneHitCount=0;
-	Long64_t start=0,stop=0;
-	int CoinType[32] = {0};
-	int CutType[32] = {0};
-	int PlaneHits[12] = {0};
-	int PlaneTrue[12] = {0};
-	v->SetBranchAddress("events",&event);
-	// v->SetBranchAddress("rEntry",&rEntry);	// not implemented for DS1 yet.
-	v->SetBranchAddress("LEDfreq",&LEDfreq);
-	v->SetBranchAddress("LEDrms",&LEDrms);
-	v->SetBranchAddress("multipThreshold",&multipThreshold);
-	v->SetBranchAddress("highestMultip",&highestMultip);
-	v->SetBranchAddress("LEDWindow",&LEDWindow);
-	v->SetBranchAddress("LEDMultipThreshold",&LEDMultipThreshold);
-	v->SetBranchAddress("LEDSimpleThreshold",&LEDSimpleThreshold);
-	v->SetBranchAddress("start",&start);
-	v->SetBranchAddress("stop",&stop);
-	v->SetBranchAddress("xTime",&xTime);
-	v->SetBranchAddress("x_deltaT",&x_deltaT);
-	v->SetBranchAddress("x_LEDDeltaT",&x_LEDDeltaT);
-	v->SetBranchAddress("CoinType[32]",CoinType);
-	v->SetBranchAddress("CutType[32]",CutType);
-	v->SetBranchAddress("PlaneHits[12]",PlaneHits);
-	v->SetBranchAddress("PlaneTrue[12]",PlaneTrue);
-	v->SetBranchAddress("PlaneHitCount",&PlaneHitCount);
-	int vEntries = v->GetEntries();
-	cout << "Found " << vEntries << " entries.\n";
-	
-	// loop over entries
-	int counter = 0;
-	for (long i = 0; i < vEntries; i++) 
+	vector< vector<MuListRun> > shardRuns(nFiles);
+	vector<long> shardEntries(nFiles,0);
+	vector<int> shardCounts(nFiles,0);
+
+	RunParallel(nFiles, [&](int s)
 	{
-		v->GetEntry(i);
+		TFile *f = TFile::Open(files[s].c_str());
+		if (f == NULL || f->IsZombie()) {
+			printf("Couldn't open shard %s\n",files[s].c_str());
+			return;
+		}
+		TTree *v = (TTree*)f->Get("vetoEvent");
+		if (v == NULL) {
+			printf("No vetoEvent tree in %s\n",files[s].c_str());
+			f->Close();
+			return;
+		}
+
+		// initialize muFinder ROOT output.  Only the columns the list needs are read.
+		MJVetoEvent *event = NULL;
+		double xTime = 0;
+		Long64_t start = 0, stop = 0;
+		int CoinType[32] = {0};
+		SetActiveBranches(v, {"run","badScaler","start","stop","xTime","CoinType[32]"});
+		v->SetBranchAddress("events",&event);
+		v->SetBranchAddress("start",&start);
+		v->SetBranchAddress("stop",&stop);
+		v->SetBranchAddress("xTime",&xTime);
+		v->SetBranchAddress("CoinType[32]",CoinType);
+		long vEntries = v->GetEntries();
+		shardEntries[s] = vEntries;
 
-		// Write a text file
+		vector<MuListRun> &runs = shardRuns[s];
 		char buffer[200];
-		if (CoinType[1] || CoinType[0]) 
+		for (long i = 0; i < vEntries; i++)
+		{
+			v->GetEntry(i);
+			bool first = (runs.size() == 0 || runs.back().run != event->GetRun());
+			if (first) {
+				MuListRun r;
+				r.run = event->GetRun();
+				r.start = (long)start;
+				r.stop = (long)stop;
+				r.firstLen = 0;
+				runs.push_back(r);
+			}
+			if (CoinType[1] || CoinType[0])
+			{
+				shardCounts[s]++;
+				int type = 0;
+				if (CoinType[0]) type = 1;
+				if (CoinType[1]) type = 2;
+				sprintf(buffer,"%i %lli %.8f %i %i\n",event->GetRun(),start,xTime,type,event->GetBadScaler());
+				runs.back().lines += buffer;
+			}
+			if (first) runs.back().firstLen = runs.back().lines.size();
+		}
+		f->Close();
+		delete f;
+	});
+
+	// Stitch the shards together in order.
+	// Jason's TYPE 3 (run gaps) needs the previous run, so it is done here,
+	// after the line from the run's first entry, as muFinder writes it.
+	ofstream MuonList(outName.c_str());
+	long prevStopTime = 0;
+	long totEntries = 0;
+	int counter = 0;
+	char buffer[200];
+	for (int s = 0; s < nFiles; s++)
+	{
+		totEntries += shardEntries[s];
+		counter += shardCounts[s];
+		for (auto &r : shardRuns[s])
 		{
-			counter++;
-			int type;
-			if (CoinType[0]) type = 1;
-			if (CoinType[1]) type = 2;
-			sprintf(buffer,"%i %lli %.8f %i %i\n",event->GetRun(),start,xTime,type,event->GetBadScaler());
-			MuonList << buffer;
-			// cout << buffer;
+			MuonList << r.lines.substr(0,r.firstLen);
+			if ((r.start - prevStopTime) > 10) {
+				sprintf(buffer,"%i %li 0.0 3 0\n",r.run,r.start);
+				MuonList << buffer;
+			}
+			MuonList << r.lines.substr(r.firstLen);
+			prevStopTime = r.stop;
 		}
 	}
+	cout << "Found " << totEntries << " entries.\n";
 	cout << "Found " << counter << " candidates\n";
 
 	// end of routine.
 	MuonList.close();
-}
\ No newline at end of file
+}
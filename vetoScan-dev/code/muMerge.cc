@@ -0,0 +1,39 @@
+// Merge muFinder shards into one data-set-level file.
+// Clint Wiseman, USC/Majorana
+//
+// The shards are listed in the manifest written by muFinder --split.
+// TFileMerger's fast method copies the compressed baskets directly,
+// so the events are never decoded.  The muon list is then built
+// from the shards in parallel by muListGen.
+
+#include "TFileMerger.h"
+#include "vetoScan.hh"
+
+using namespace std;
+
+void muMerge(string manifest)
+{
+	vector<string> files = GetShardFiles(manifest);
+	if (files.size() == 0) {
+		cout << "No shards found in " << manifest << endl;
+		return;
+	}
+
+	string Name = manifest;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
+	if (Name.find("_manifest") != string::npos) Name.erase(Name.find("_manifest"),string::npos);
+	string outFile = "./output/"+Name+".root";
+
+	printf("Merging %i shards into %s\n",(int)files.size(),outFile.c_str());
+	TFileMerger merger(kFALSE);
+	merger.SetFastMethod(kTRUE);
+	merger.OutputFile(outFile.c_str(),"RECREATE");
+	for (auto &f : files) merger.AddFile(f.c_str(),kFALSE);
+	if (!merger.Merge()) {
+		cout << "Merge failed!\n";
+		return;
+	}
+
+	muListGen(manifest);
+}
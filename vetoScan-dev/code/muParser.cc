@@ -1,140 +1,266 @@
+// Muon rate and live time for a whole data set.
+// Clint Wiseman, USC/Majorana
+//
+// Input is either muFinder ROOT output (a file or a shard manifest), or a
+// muon list from muListGen (./output/MuonList_*.txt).  Everything is done in
+// one pass: muons and live time are added into time bins (hour, day, week,
+// or a number of seconds) kept in a map, so a multi-year data set doesn't
+// need a histogram range up front.  Only the run, time, start/stop, bad scaler
+// and CoinType columns are read from the ROOT files.
+//
+// A muon is an entry that goes into the veto cut (CoinType[0], list types 1
+// and 2) with a good scaler.  Vertical muons (CoinType[1], list type 2) are
+// counted separately.  The veto is assumed live for the whole run.  A muon list
+// has no stop times, so there a run is live until the next run starts, or if a
+// gap line (type 3) follows, until its last listed event.
+//
+// Output: ./output/MuRate_<Name>.txt (one line per bin) and ./output/muRate_<Name>.pdf/.C
+
+#include <map>
+#include <set>
+#include <ctime>
+#include <cmath>
 #include "vetoScan.hh"
 using namespace std;
-void muParser(string arg) 
+
+struct RateBin {
+	long muons;
+	long vertical;
+	double live;	// seconds
+	RateBin() : muons(0), vertical(0), live(0) {}
+};
+
+struct RateRun {
+	long start;
+	double stop;
+};
+
+// Time bins.  Weeks start on Monday (the epoch was a Thursday).
+struct RateBinning {
+	long width;
+	long offset;
+	long Bin(double t) const { return (long)floor((t - offset) / width); }
+	long BinStart(long b) const { return b * width + offset; }
+};
+
+// Spread the live time from t0 to t1 over the bins it covers.
+static void AddLive(map<long,RateBin> &bins, const RateBinning &tb, double t0, double t1)
 {
-	/*
-	TChain *v = new TChain("vetoEvent");
-	
-	// Can handle more than one input file
-	// v->AddFile(arg.c_str());
-	v->AddFile("./output/KJR_Total.root");
-	// v->AddFile("./output/P3KJR_R01.root");
-	// v->AddFile("./output/P3KJR_R02.root");
-
-	MJVetoEvent *event = NULL;
-	int CoinType[32] = {0};
-	int CutType[32] = {0};
-	double LEDfreq = 0;
-	double LEDrms = 0;
-	int highestMultip = 0;
-	Long64_t start = 0;
-	Long64_t stop = 0;
-	v->SetBranchAddress("events",&event);
-	v->SetBranchAddress("CoinType[32]",CoinType);
-	v->SetBranchAddress("CutType[32]",CutType);
-	v->SetBranchAddress("LEDfreq",&LEDfreq);
-	v->SetBranchAddress("LEDrms",&LEDrms);
-	v->SetBranchAddress("highestMultip",&highestMultip);
-	v->SetBranchAddress("start",&start);
-	v->SetBranchAddress("stop",&stop);
-	int vEntries = v->GetEntries();
-	cout << "Found " << vEntries << " entries.\n";
-
-	v->GetEntry(0);
-	long firstStart = start;
-	v->GetEntry(vEntries-1);
-	long lastStop = stop;
-	double days = (double)(lastStop - firstStart)/(86400);
-	double binsPerDay = 1;  //1,0.5,0.2
-	int bins = (int)(binsPerDay*days);
-	TH1D *muRate = new TH1D("muRate","",bins,firstStart,lastStop);
-	TH1D *muRate_w = new TH1D("muRate_w","",bins,firstStart,lastStop);
-
-	double muonTime = 0;
-	int muonCount = 0;
-	long liveTime = 0;
-	int prevRun = 0;
-	struct tm * ptm;
-	
-	// this should be tied to binsPerDay?
-	int day = 0;
-	int prevDay = 0;
-	int muonsThisDay = 0;
-	double liveTimeDay = 0;
-	double liveFracDay = 0;
-
-	for (long i = 0; i < vEntries; i++) 
-	{
-		v->GetEntry(i);
+	while (t0 < t1) {
+		long b = tb.Bin(t0);
+		double end = min(t1,(double)tb.BinStart(b+1));
+		bins[b].live += end - t0;
+		t0 = end;
+	}
+}
 
-		// should not need a multiplicity cut ...
-		// P3JDY really drove the number down too.
-		if ((CoinType[1]||CoinType[2]) && event->GetMultip() < 24 && !event->GetBadScaler()) 
-		{
-			muonCount++;
-			muonTime = start + event->GetTimeSec();
-			muRate->Fill(muonTime);			
+void muParser(string arg, string binning)
+{
+	RateBinning tb;
+	tb.offset = 0;
+	if (binning == "hour") tb.width = 3600;
+	else if (binning == "day") tb.width = 86400;
+	else if (binning == "week") { tb.width = 7*86400; tb.offset = 4*86400; }
+	else tb.width = atol(binning.c_str());
+	if (tb.width <= 0) {
+		cout << "Unknown bin width " << binning << ".  Use hour, day, week, or a number of seconds.\n";
+		return;
+	}
 
-			// find the day
-			time_t muonStamp = (time_t)muonTime;
-			ptm = gmtime ( &muonStamp );
-			day = ptm->tm_mday;
+	string Name = arg;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
+	if (Name.find("_manifest") != string::npos) Name.erase(Name.find("_manifest"),string::npos);
+	bool fromList = (Name.find("MuonList_") == 0);
 
+	map<long,RateBin> bins;
+	map<int,RateRun> runs;
+	long nEntries = 0;
 
-			if (day!=prevDay)
-			{
-				// if (event->run != prevRun) ;;;;
-				
-				liveFracDay = liveTimeDay/86400;
-				muRate_w->Fill(muonsThisDay,liveFracDay);
-				
-				muonsThisDay = 0;
-				liveFracDay = 0;
+	if (fromList)
+	{
+		ifstream MuonList(arg.c_str());
+		if (!MuonList.good()) {
+			cout << "Couldn't open " << arg << endl;
+			return;
+		}
+		// list lines: run start xTime type badScaler
+		int run = 0, type = 0, badScaler = 0;
+		long start = 0;
+		double xTime = 0;
+		vector<int> order;
+		set<int> gapBefore;
+		string line;
+		while (getline(MuonList,line))
+		{
+			if (sscanf(line.c_str(),"%i %li %lf %i %i",&run,&start,&xTime,&type,&badScaler) != 5) continue;
+			nEntries++;
+			if (runs.count(run) == 0) {
+				RateRun r = {start, (double)start};
+				runs[run] = r;
+				order.push_back(run);
 			}
-			else {
-				muonsThisDay++;
+			if (type == 3) {
+				gapBefore.insert(run);
+				continue;
 			}
-
-			prevDay = day;
+			runs[run].stop = max(runs[run].stop,start + xTime);
+			if (badScaler) continue;
+			RateBin &b = bins[tb.Bin(start + xTime)];
+			b.muons++;
+			if (type == 2) b.vertical++;
 		}
+		// a run was live until the next one started, unless there was a gap
+		for (size_t i = 0; i+1 < order.size(); i++)
+			if (gapBefore.count(order[i+1]) == 0)
+				runs[order[i]].stop = max(runs[order[i]].stop,(double)runs[order[i+1]].start);
+	}
+	else
+	{
+		vector<string> files = GetShardFiles(arg);
+		int nFiles = (int)files.size();
+		if (nFiles == 0) {
+			cout << "No input files found in " << arg << endl;
+			return;
+		}
+		printf("Reading %i files with %i threads.\n",nFiles,min(nFiles,GetNumThreads()));
 
-		// live time
-		// still assuming the veto was completely live during the run
-		if (event->GetRun() != prevRun) liveTime += stop-start;
-
-		prevRun = event->GetRun();
+		vector< map<long,RateBin> > shardBins(nFiles);
+		vector< map<int,RateRun> > shardRuns(nFiles);
+		vector<long> shardEntries(nFiles,0);
+		RunParallel(nFiles, [&](int s)
+		{
+			TFile *f = TFile::Open(files[s].c_str());
+			if (f == NULL || f->IsZombie()) {
+				printf("Couldn't open %s\n",files[s].c_str());
+				return;
+			}
+			TTree *v = (TTree*)f->Get("vetoEvent");
+			if (v == NULL) {
+				printf("No vetoEvent tree in %s\n",files[s].c_str());
+				f->Close();
+				return;
+			}
+			MJVetoEvent *event = NULL;
+			double xTime = 0;
+			Long64_t start = 0, stop = 0;
+			int CoinType[32] = {0};
+			SetActiveBranches(v, {"run","badScaler","start","stop","xTime","CoinType[32]"});
+			v->SetBranchAddress("events",&event);
+			v->SetBranchAddress("start",&start);
+			v->SetBranchAddress("stop",&stop);
+			v->SetBranchAddress("xTime",&xTime);
+			v->SetBranchAddress("CoinType[32]",CoinType);
+			long vEntries = v->GetEntries();
+			shardEntries[s] = vEntries;
+			int prevRun = -1;
+			for (long i = 0; i < vEntries; i++)
+			{
+				v->GetEntry(i);
+				if (event->GetRun() != prevRun) {
+					RateRun r = {(long)start, (double)stop};
+					shardRuns[s][event->GetRun()] = r;
+					prevRun = event->GetRun();
+				}
+				if (!CoinType[0] || event->GetBadScaler()) continue;
+				RateBin &b = shardBins[s][tb.Bin(start + xTime)];
+				b.muons++;
+				if (CoinType[1]) b.vertical++;
+			}
+			f->Close();
+			delete f;
+		});
+		for (int s = 0; s < nFiles; s++)
+		{
+			nEntries += shardEntries[s];
+			for (auto &b : shardBins[s]) {
+				bins[b.first].muons += b.second.muons;
+				bins[b.first].vertical += b.second.vertical;
+			}
+			runs.insert(shardRuns[s].begin(),shardRuns[s].end());
+		}
 	}
 
-	// don't forget to fill the last day of muonsThisDay.
+	// live time, once per run
+	double liveTime = 0;
+	for (auto &r : runs) {
+		AddLive(bins,tb,(double)r.second.start,r.second.stop);
+		liveTime += r.second.stop - r.second.start;
+	}
+	if (bins.size() == 0) {
+		cout << "No runs found in " << arg << endl;
+		return;
+	}
 
+	// rate table
+	long firstBin = bins.begin()->first;
+	long lastBin = bins.rbegin()->first;
+	long muonCount = 0;
+	string tableName = "./output/MuRate_"+Name+".txt";
+	ofstream Table(tableName.c_str());
+	Table << "# binStart(unix) date(GMT) muons vertical live(s) rate(/day) error(/day)\n";
+	char line[300], date[50];
+	for (auto &b : bins)
+	{
+		RateBin &r = b.second;
+		muonCount += r.muons;
+		time_t t = (time_t)tb.BinStart(b.first);
+		struct tm ptm;
+		gmtime_r(&t,&ptm);
+		strftime(date,sizeof(date),"%Y-%m-%d_%H:%M",&ptm);
+		double rate = r.live > 0 ? 86400. * r.muons / r.live : 0;
+		double err = r.live > 0 ? 86400. * sqrt((double)r.muons) / r.live : 0;
+		sprintf(line,"%li %s %li %li %.0f %.3f %.3f",(long)t,date,r.muons,r.vertical,r.live,rate,err);
+		Table << line << endl;
+	}
+	Table.close();
 
-	// output and plotting
-	//
+	long firstStart = tb.BinStart(firstBin);
+	long lastStop = tb.BinStart(lastBin+1);
+	double days = (double)(lastStop - firstStart)/86400;
+	double liveDays = liveTime/86400;
 	MJDB::MJSlowControlsDoc doc;
-	cout << doc.GetGMTString(firstStart) << "  " << doc.GetGMTString(lastStop) << endl;
 	string startDate = doc.GetGMTString(firstStart);
 	string stopDate = doc.GetGMTString(lastStop);
-	double liveDays = (double)liveTime/86400;
-
 	cout << "\nDates covered: " << startDate << " to " << stopDate << " (GMT)" << endl;
 	printf("Total days : %.2f,  Total Live Time : %.2f.  Live-time fraction : %.2f%%.\n",
 		days,liveDays,100*(liveDays/days));
-	printf("Muon rate : Of %i entries, found %i muons in %.2f live days .....\n\t%.2f muons/day , %.2f muons/4hrs\n\n"
-		,vEntries,muonCount,liveDays,muonCount/liveDays,muonCount/(liveDays*6));
+	printf("Muon rate : Of %li entries in %i runs, found %li muons in %.2f live days .....\n\t%.2f muons/day , %.2f muons/4hrs\n",
+		nEntries,(int)runs.size(),muonCount,liveDays,muonCount/liveDays,muonCount/(liveDays*6));
+	printf("Rate table: %s\n\n",tableName.c_str());
+
+	// plot: muons per day in each bin, live-time corrected
+	int nBins = (int)(lastBin - firstBin + 1);
+	TH1D *muRate = new TH1D("muRate","",nBins,(double)firstStart,(double)lastStop);
+	for (auto &b : bins) {
+		if (b.second.live <= 0) continue;
+		int bin = (int)(b.first - firstBin) + 1;
+		muRate->SetBinContent(bin,86400. * b.second.muons / b.second.live);
+		muRate->SetBinError(bin,86400. * sqrt((double)b.second.muons) / b.second.live);
+	}
 
 	TCanvas *c = new TCanvas("c","Bob Ross's Canvas",800,600);
 	muRate->GetXaxis()->SetTimeOffset(0,"gmt");
 	muRate->GetXaxis()->SetTimeFormat("%m/%d/%y");
-  	muRate->GetXaxis()->SetTimeDisplay(1);
-  	muRate->GetXaxis()->SetNdivisions(-506);	//-503
-  	muRate->GetXaxis()->SetLabelOffset(0.02);
-  	muRate->GetXaxis()->SetTitleOffset(1.5);
-
-  	char xTitle[200];
-  	sprintf(xTitle,"[%.2f days / bin]",1/binsPerDay);
-  	muRate->GetXaxis()->SetTitle(xTitle);
-
-  	char yTitle[200];
-  	sprintf(yTitle,"Muons / %.1f days",1/binsPerDay);
-  	muRate->GetYaxis()->SetTitle(yTitle);
-
-  	char Title[200];
-  	sprintf(Title,"Muons since %s (%.1f days)",doc.GetGMTString(firstStart).c_str(),days);
-  	muRate->SetTitle(Title);
-  	muRate->SetStats(0);
-	muRate->Draw();
-	
-	c->Print("./output/muRate.pdf");
-	c->Print("./output/muRate.C");
-	*/	
-}
\ No newline at end of file
+	muRate->GetXaxis()->SetTimeDisplay(1);
+	muRate->GetXaxis()->SetNdivisions(-506);
+	muRate->GetXaxis()->SetLabelOffset(0.02);
+	muRate->GetXaxis()->SetTitleOffset(1.5);
+
+	char xTitle[200];
+	sprintf(xTitle,"[%.3g days / bin]",tb.width/86400.);
+	muRate->GetXaxis()->SetTitle(xTitle);
+	muRate->GetYaxis()->SetTitle("Muons / live day");
+
+	char Title[200];
+	sprintf(Title,"Muons since %s (%.1f days)",startDate.c_str(),days);
+	muRate->SetTitle(Title);
+	muRate->SetStats(0);
+	muRate->Draw("E");
+
+	string plotName = "./output/muRate_"+Name;
+	c->Print((plotName+".pdf").c_str());
+	c->Print((plotName+".C").c_str());
+	delete c;
+	delete muRate;
+}
@@ -1,44 +1,253 @@
+// Quick plots from muFinder output.
+// Clint Wiseman, USC/Majorana
+//
+// Several plots are filled in one pass over the files.  Only the columns the
+// plots use are read (split MJVetoEvent members like "multip" and "totE", or
+// muFinder's own branches like "xTime"), so the full event is never built.
+// Cuts on CoinType/CutType are turned into bitmasks once, and the histograms
+// are filled in batches.
+//
+// Plot specs come from a text file (-P), one plot per line:
+//   name  x[:y]  nx xlo xhi  [ny ylo yhi]  [cut]
+// where the cut is terms like CoinType[1] or !CutType[3] joined by &&, e.g.
+//   hqm  totE:multip  100 0 55000  32 0 32  CoinType[1]
+// Without a spec file, that plot (QDC total vs. multiplicity of vertical muons) is made.
+//
+// -F takes a muFinder ROOT file or shard manifest.
+// Output: ./output/plotter.pdf (one page per plot) and ./output/plotter.root
+
+#include <stdint.h>
+#include "TLeaf.h"
+#include "TH2D.h"
 #include "vetoScan.hh"
 using namespace std;
 
-void muPlotter(string arg)
+struct MuPlotSpec {
+	string name, xVar, yVar, cut;
+	int nx, ny;
+	double xlo, xhi, ylo, yhi;
+	uint32_t coinReq, coinVeto, cutReq, cutVeto;	// compiled cut
+	TH1 *h;
+	int ix, iy;			// column index of x and y
+	vector<double> xBuf, yBuf;
+	MuPlotSpec() : nx(0), ny(0), xlo(0), xhi(0), ylo(0), yhi(0), coinReq(0), coinVeto(0), cutReq(0), cutVeto(0), h(NULL), ix(-1), iy(-1) {}
+};
+
+// "CoinType[1]&&!CutType[3]" -> bitmasks.  Returns false if it can't be parsed.
+static bool CompileCut(MuPlotSpec &p)
+{
+	string c = p.cut;
+	size_t pos = 0;
+	while (pos < c.size())
+	{
+		size_t end = c.find("&&",pos);
+		if (end == string::npos) end = c.size();
+		string term = c.substr(pos,end-pos);
+		pos = end + 2;
+		bool neg = (term.size() > 0 && term[0] == '!');
+		if (neg) term.erase(0,1);
+		int bit = -1;
+		uint32_t *req = NULL, *veto = NULL;
+		if (sscanf(term.c_str(),"CoinType[%d]",&bit) == 1) { req = &p.coinReq; veto = &p.coinVeto; }
+		else if (sscanf(term.c_str(),"CutType[%d]",&bit) == 1) { req = &p.cutReq; veto = &p.cutVeto; }
+		if (req == NULL || bit < 0 || bit > 31) {
+			cout << "Can't use cut term \"" << term << "\" in plot " << p.name << endl;
+			return false;
+		}
+		if (neg) *veto |= (1u << bit);
+		else *req |= (1u << bit);
+	}
+	return true;
+}
+
+static vector<MuPlotSpec> ReadPlotSpecs(string specFile)
+{
+	vector<MuPlotSpec> specs;
+	if (specFile == "") {
+		MuPlotSpec p;
+		p.name = "hqm"; p.xVar = "totE"; p.yVar = "multip"; p.cut = "CoinType[1]";
+		p.nx = 100; p.xlo = 0; p.xhi = 55000;
+		p.ny = 32; p.ylo = 0; p.yhi = 32;
+		if (CompileCut(p)) specs.push_back(p);
+		return specs;
+	}
+	ifstream SpecList(specFile.c_str());
+	if (!SpecList.good()) {
+		cout << "Couldn't open " << specFile << endl;
+		return specs;
+	}
+	string line;
+	while (getline(SpecList,line))
+	{
+		if (line.empty() || line[0] == '#') continue;
+		stringstream ss(line);
+		vector<string> tok;
+		string t;
+		while (ss >> t) tok.push_back(t);
+		if (tok.size() < 5) {
+			cout << "Bad plot spec: " << line << endl;
+			continue;
+		}
+		MuPlotSpec p;
+		p.name = tok[0];
+		p.xVar = tok[1];
+		if (p.xVar.find(':') != string::npos) {
+			p.yVar = p.xVar.substr(p.xVar.find(':')+1);
+			p.xVar = p.xVar.substr(0,p.xVar.find(':'));
+		}
+		size_t nNum = (p.yVar == "") ? 3 : 6;
+		if (tok.size() < 2+nNum) {
+			cout << "Bad plot spec: " << line << endl;
+			continue;
+		}
+		p.nx = atoi(tok[2].c_str()); p.xlo = atof(tok[3].c_str()); p.xhi = atof(tok[4].c_str());
+		if (p.yVar != "") {
+			p.ny = atoi(tok[5].c_str()); p.ylo = atof(tok[6].c_str()); p.yhi = atof(tok[7].c_str());
+		}
+		if (tok.size() > 2+nNum) p.cut = tok[2+nNum];
+		if (CompileCut(p)) specs.push_back(p);
+	}
+	return specs;
+}
+
+void muPlotter(string arg, string specFile)
 {
-	//This can also handle more than 1 run
-	// TChain *t = new TChain("vetoEvent");
-	// t->AddFile(arg.c_str());
+	vector<MuPlotSpec> specs = ReadPlotSpecs(specFile);
+	if (specs.size() == 0) {
+		cout << "No plots to make.\n";
+		return;
+	}
+	vector<string> files = GetShardFiles(arg);
+	if (files.size() == 0) {
+		cout << "No input files found in " << arg << endl;
+		return;
+	}
 
-	TFile *f = new TFile(arg.c_str());
-	TTree *t = (TTree*)f->Get("vetoEvent");
-	
-	// need to get the start/stop times for a big histo
+	// book the plots, and list the columns they need
+	vector<string> vars;
+	auto column = [&](string v) {
+		for (size_t i = 0; i < vars.size(); i++) if (vars[i] == v) return (int)i;
+		vars.push_back(v);
+		return (int)vars.size()-1;
+	};
+	bool needCoin = false, needCut = false;
+	for (auto &p : specs)
+	{
+		string title = p.name + ": " + (p.yVar != "" ? p.yVar + " vs. " : "") + p.xVar + (p.cut != "" ? " {"+p.cut+"}" : "");
+		if (p.yVar == "") p.h = new TH1D(p.name.c_str(),title.c_str(),p.nx,p.xlo,p.xhi);
+		else p.h = new TH2D(p.name.c_str(),title.c_str(),p.nx,p.xlo,p.xhi,p.ny,p.ylo,p.yhi);
+		p.h->SetDirectory(0);
+		p.ix = column(p.xVar);
+		if (p.yVar != "") p.iy = column(p.yVar);
+		if (p.coinReq || p.coinVeto) needCoin = true;
+		if (p.cutReq || p.cutVeto) needCut = true;
+	}
 
-	// TH1D *hqt = new TH1D("hqt","QDCTotal",100,0,55000);
-	// TH1D *hqt2 = new TH1D("hqt2","QDCTotal+cut",100,0,55000);
-	TH2D *hqm = new TH2D("hqm","qdctotal vs multip.",100,0,55000,32,0,32);
+	const int batch = 4096;
+	long totEntries = 0;
+	for (auto &file : files)
+	{
+		TFile *f = TFile::Open(file.c_str());
+		if (f == NULL || f->IsZombie()) {
+			printf("Couldn't open %s\n",file.c_str());
+			continue;
+		}
+		TTree *t = (TTree*)f->Get("vetoEvent");
+		if (t == NULL) {
+			printf("No vetoEvent tree in %s\n",file.c_str());
+			f->Close();
+			continue;
+		}
 
-	char cut1[500];
-	sprintf(cut1,"CoinType[1]==1");
-	TCut tcut1 = cut1;
+		// find the branch for each column: a muFinder branch, or a split event member
+		vector<string> active = vars;
+		if (needCoin) active.push_back("CoinType[32]");
+		if (needCut) active.push_back("CutType[32]");
+		SetActiveBranches(t,active);
+		vector<TBranch*> branches;
+		vector<TLeaf*> leaves;
+		bool ok = true;
+		for (auto &v : vars) {
+			TBranch *b = t->GetBranch(v.c_str());
+			if (b == NULL) b = t->GetBranch(("events."+v).c_str());
+			if (b == NULL || b->GetListOfLeaves()->GetEntries() == 0) {
+				cout << "Couldn't find column " << v << " in " << file << endl;
+				ok = false;
+				break;
+			}
+			branches.push_back(b);
+			leaves.push_back((TLeaf*)b->GetListOfLeaves()->At(0));
+		}
+		TBranch *coinBranch = needCoin ? t->GetBranch("CoinType[32]") : NULL;
+		TBranch *cutBranch = needCut ? t->GetBranch("CutType[32]") : NULL;
+		int CoinType[32] = {0};
+		int CutType[32] = {0};
+		if (coinBranch) coinBranch->SetAddress(CoinType);
+		if (cutBranch) cutBranch->SetAddress(CutType);
+		if (!ok || (needCoin && coinBranch == NULL) || (needCut && cutBranch == NULL)) {
+			f->Close();
+			delete f;
+			continue;
+		}
 
-	// t->Project("hqt","events.totE");
-	// t->Project("hqt2","events.totE",tcut1);
-	t->Project("hqm","events.multip:events.totE",tcut1);
+		vector<double> val(vars.size());
+		long vEntries = t->GetEntries();
+		totEntries += vEntries;
+		for (long i = 0; i < vEntries; i++)
+		{
+			for (size_t k = 0; k < branches.size(); k++) {
+				branches[k]->GetEntry(i);
+				val[k] = leaves[k]->GetValue();
+			}
+			uint32_t coin = 0, cut = 0;
+			if (coinBranch) {
+				coinBranch->GetEntry(i);
+				for (int k = 0; k < 32; k++) if (CoinType[k]) coin |= (1u << k);
+			}
+			if (cutBranch) {
+				cutBranch->GetEntry(i);
+				for (int k = 0; k < 32; k++) if (CutType[k]) cut |= (1u << k);
+			}
+			for (auto &p : specs)
+			{
+				if ((coin & p.coinReq) != p.coinReq || (coin & p.coinVeto)) continue;
+				if ((cut & p.cutReq) != p.cutReq || (cut & p.cutVeto)) continue;
+				p.xBuf.push_back(val[p.ix]);
+				if (p.iy >= 0) p.yBuf.push_back(val[p.iy]);
+				if ((int)p.xBuf.size() < batch) continue;
+				if (p.iy >= 0) ((TH2*)p.h)->FillN((int)p.xBuf.size(),&p.xBuf[0],&p.yBuf[0],NULL);
+				else p.h->FillN((int)p.xBuf.size(),&p.xBuf[0],NULL);
+				p.xBuf.clear();
+				p.yBuf.clear();
+			}
+		}
+		f->Close();
+		delete f;
+	}
+	for (auto &p : specs) {
+		if (p.xBuf.size() == 0) continue;
+		if (p.iy >= 0) ((TH2*)p.h)->FillN((int)p.xBuf.size(),&p.xBuf[0],&p.yBuf[0],NULL);
+		else p.h->FillN((int)p.xBuf.size(),&p.xBuf[0],NULL);
+	}
+	printf("Filled %i plots from %li entries in %i files.\n",(int)specs.size(),totEntries,(int)files.size());
 
+	// one page per plot
+	TFile *out = new TFile("./output/plotter.root","RECREATE");
 	TCanvas* c1 = new TCanvas("c1","Bob Ross's Canvas",800,600);
-     
-	c1->cd(1);
-	// c1->SetLogy();
-	// hqt2->SetLineColor(kRed);
-	// hqt2->SetLineWidth(2.0);
-	// hqt2->Draw();
-	// hqt->Draw("same");
-
-	hqm->Draw("COL");
-	hqm->SetStats(0);
-
-	c1->Print("./output/plotter.pdf");
-
-	delete t;
-	f->Close();
-     
-}
\ No newline at end of file
+	for (size_t i = 0; i < specs.size(); i++)
+	{
+		MuPlotSpec &p = specs[i];
+		c1->cd();
+		p.h->SetStats(0);
+		p.h->Draw(p.iy >= 0 ? "COL" : "");
+		string page = "./output/plotter.pdf";
+		if (specs.size() > 1 && i == 0) page += "(";
+		else if (specs.size() > 1 && i == specs.size()-1) page += ")";
+		c1->Print(page.c_str());
+		out->cd();
+		p.h->Write();
+	}
+	out->Close();
+	delete c1;
+	for (auto &p : specs) delete p.h;
+}
@@ -4,9 +4,31 @@
 // 5/3/2016
 
 #include "vetoScan.hh"
+#include "code/vetoErrorPolicy.hh"
+#include "code/VetoSnapshot.hh"
+#include "code/RunSet.hh"
+#include "code/VetoWriter.hh"
+#include "code/RunState.hh"
 
 using namespace std;
 
+// One entry's output, filled by the event loop and written by the writer
+// thread (code/VetoWriter.hh).  The per-entry branches read from here.
+struct MuSimpleRow
+{
+	MJVetoEvent veto;
+	long rEntry;
+	double xTime;
+	int CoinType[32];
+	int CutType[32];
+	int PlaneHits[12];
+	int PlaneTrue[12];
+	int PlaneHitCount;
+	bool skipped;		// fatal errors: not written
+	int listType;		// muon list: 1 (2+ panels), 2 (vertical), 0 (none)
+	bool listGap;		// muon list: type 3 line for a gap since the last run
+};
+
 void muSimple(string Input, int *thresh)
 {
 	// LED Cut Parameters (C-f "Display Cut Parameters" below.)
@@ -28,37 +50,27 @@ void muSimple(string Input, int *thresh)
 	}
 
 	// Input a list of run numbers
-	ifstream InputList(Input.c_str());
-	if(!InputList.good()) {
-		cout << "Couldn't open " << Input << endl;
-		return;
-	}
+	RunSet runs;
+	if (!runs.Load(Input)) return;
 
 	// Set up output files
 	string Name = Input;
 	Name.erase(Name.find_last_of("."),string::npos);
 	Name.erase(0,Name.find_last_of("\\/")+1);
 	string outName = "./output/muSimpleList_"+Name+".txt";
-	ofstream MuonList(outName.c_str());
+	BufferedOfstream MuonList(outName.c_str());
 
-	// Set up ROOT output
+	// Set up ROOT output.  The per-run branches read these locals, so the
+	// writer is flushed before they change for the next run.
 	int isGood;
-	int run;
-	long rEntry;
 	long start;
 	long stop;
 	long prevStopTime = 0;
 	double duration;
-	int CoinType[32];
-	int CutType[32];
-	int PlaneHits[12];
-	int PlaneTrue[12];
-	int PlaneHitCount = 0;
 	int highestMultip = 0;
 	int multipThreshold = 0;
 	double LEDfreq = 0;
 	double LEDrms = 0;
-	double xTime = 0;
 	double x_deltaT = 0;	
 	double x_LEDDeltaT = 0;
 	Char_t OutputFile[200];
@@ -66,9 +78,12 @@ void muSimple(string Input, int *thresh)
 	TFile *RootFile = new TFile(OutputFile, "RECREATE"); 	
   	TH1::AddDirectory(kFALSE); // Global flag: "When a (root) file is closed, all histograms in memory associated with this file are automatically deleted."
 	TTree *vetoEvent = new TTree("vetoEvent","MJD Veto Events");
+	EnableOutputMT(GetNumThreads()-2);	// the rest of -j, besides this thread and the writer's
 	MJVetoEvent out;
-	vetoEvent->Branch("events","MJVetoEvent",&out,32000,1);
-	vetoEvent->Branch("rEntry",&rEntry,"rEntry/L");
+	MJVetoEvent *outPtr = &out;	// the events branch reads the event this points to
+	MuSimpleRow outRow;
+	vetoEvent->Branch("events","MJVetoEvent",&outPtr,32000,1);
+	vetoEvent->Branch("rEntry",&outRow.rEntry,"rEntry/L");
 	vetoEvent->Branch("LEDfreq",&LEDfreq);
 	vetoEvent->Branch("LEDrms",&LEDrms);
 	vetoEvent->Branch("multipThreshold",&multipThreshold);
@@ -78,20 +93,56 @@ void muSimple(string Input, int *thresh)
 	vetoEvent->Branch("LEDSimpleThreshold",&LEDSimpleThreshold); // add a bool signifiying it's in use
 	vetoEvent->Branch("start",&start,"start/L");
 	vetoEvent->Branch("stop",&stop,"stop/L");
-	vetoEvent->Branch("xTime",&xTime);
+	vetoEvent->Branch("xTime",&outRow.xTime);
 	vetoEvent->Branch("x_deltaT",&x_deltaT); 
 	vetoEvent->Branch("x_LEDDeltaT",&x_LEDDeltaT);
-	vetoEvent->Branch("CoinType[32]",CoinType,"CoinType[32]/I");
-	vetoEvent->Branch("CutType[32]",CutType,"CutType[32]/I");
-	vetoEvent->Branch("PlaneHits[12]",PlaneHits,"PlaneHits[12]/I");
-	vetoEvent->Branch("PlaneTrue[12]",PlaneTrue,"PlaneTrue[12]/I");
-	vetoEvent->Branch("PlaneHitCount",&PlaneHitCount);
+	vetoEvent->Branch("CoinType[32]",outRow.CoinType,"CoinType[32]/I");
+	vetoEvent->Branch("CutType[32]",outRow.CutType,"CutType[32]/I");
+	vetoEvent->Branch("PlaneHits[12]",outRow.PlaneHits,"PlaneHits[12]/I");
+	vetoEvent->Branch("PlaneTrue[12]",outRow.PlaneTrue,"PlaneTrue[12]/I");
+	vetoEvent->Branch("PlaneHitCount",&outRow.PlaneHitCount);
+
+	// The tree and the muon list are written on their own thread.  The list
+	// lines wait in runLines until the run is done (it may be scanned again).
+	// So do a warm run's rows, in heldRows, until its warm start holds.
+	int run = 0;
+	string runLines;
+	bool holdRows = false;
+	vector<MuSimpleRow> heldRows;
+	auto fillTree = [&](MuSimpleRow &row)
+	{
+		outRow.rEntry = row.rEntry;
+		outRow.xTime = row.xTime;
+		memcpy(outRow.CoinType,row.CoinType,sizeof(row.CoinType));
+		memcpy(outRow.CutType,row.CutType,sizeof(row.CutType));
+		memcpy(outRow.PlaneHits,row.PlaneHits,sizeof(row.PlaneHits));
+		memcpy(outRow.PlaneTrue,row.PlaneTrue,sizeof(row.PlaneTrue));
+		outRow.PlaneHitCount = row.PlaneHitCount;
+		outPtr = &row.veto;
+		vetoEvent->Fill();
+	};
+	VetoWriter<MuSimpleRow> writer([&](MuSimpleRow &row)
+	{
+		if (row.skipped) return;
+		char buffer[200];
+		if (row.listType > 0) {
+			sprintf(buffer,"%i %li %.8f %i %i\n",run,start,row.xTime,row.listType,row.veto.GetBadScaler());
+			runLines += buffer;
+		}
+		if (row.listGap) {
+			sprintf(buffer,"%i %li 0.0 3 0\n",run,start);
+			runLines += buffer;
+		}
+		if (holdRows) heldRows.push_back(row);
+		else fillTree(row);
+	});
 
 	// Loop over files.
-	while(!InputList.eof()){
+	RunState last;	// the last run's panels and SBC offset (code/RunState.hh)
+	for (int thisRun : runs) {
+		run = thisRun;
 
 		// initialize
-		InputList >> run;
 		GATDataSet *ds = new GATDataSet(run);
 		TChain *v = ds->GetVetoChain();
 		long vEntries = v->GetEntries();
@@ -112,58 +163,74 @@ void muSimple(string Input, int *thresh)
 		cout << "start: " << start << "  stop: " << stop << endl;
 
 		// ========= 1st loop over veto entries - Find highest multiplicity. =========
-		// 
+		//
+		// A run that follows another starts warm (code/RunState.hh): this loop
+		// stops at the first good entry, and the 2nd loop cuts with the last
+		// run's highest multiplicity while it finds this run's.  If they differ,
+		// or the SBC offset isn't the predicted one, it's done the old way.
+		//
 		bool badLEDFreq = false;
-		MJVetoEvent prev;
+		VetoRing<2> measureHistory;	// previous good entries (code/VetoSnapshot.hh)
 		// char hname[200];
-		highestMultip = 0;	// try to predict how many panels there are for this run.
+		int measuredMultip = 0;	// try to predict how many panels there are for this run.
 		long skippedEvents = 0;
+		VetoErrorCounts runErrors;	// added to the policy's counts once the run is done
 		long corruptScaler = 0;
 		bool foundFirst = false;
 		int firstGoodEntry = 0;
-		MJVetoEvent first;
-		highestMultip=0;
-		for (long i = 0; i < vEntries; i++) 
+		VetoSnapshot first;
+		first.Clear();
+		auto measure = [&](MJVetoEvent &veto, long i, int isGood)
 		{
-			v->GetEntry(i);
-			MJVetoEvent veto;
-			veto.SetSWThresh(swThresh);	
-	    	isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);
-    		if (CheckForBadErrors(veto,i,isGood,false)) {
+    		if (GetErrorPolicy().Check(veto,i,isGood,runErrors)) {
     			skippedEvents++;
-    			continue;
+    			return;
     		}
 
 	    	if (veto.GetBadScaler()) corruptScaler++;
 	    	
-	    	if (veto.GetMultip() > highestMultip && veto.GetMultip() < 33) {
-	    		highestMultip = veto.GetMultip();
-	    		// cout << "Finding highest multiplicity: " << highestMultip << "  entry: " << i << endl;
+	    	if (veto.GetMultip() > measuredMultip && veto.GetMultip() < 33) {
+	    		measuredMultip = veto.GetMultip();
+	    		// cout << "Finding highest multiplicity: " << measuredMultip << "  entry: " << i << endl;
 	    	}
 
 	    	// Save the first good entry number for the SBC offset
 			if (isGood == 1 && !foundFirst) {
-				first = veto;
+				first.Set(veto,isGood,i);
 				foundFirst = true;
 				firstGoodEntry = i;
 			}
 
-			prev = veto;
+			measureHistory.Push(veto,isGood,i);
+		};
+		bool warm = (last.highestMultip > 0 && last.WarmFor(run,start));
+		long measured = vEntries;
+		MJVetoEvent veto;
+		for (long i = 0; i < vEntries; i++) 
+		{
+			v->GetEntry(i);
+			veto.Clear();
+			veto.SetSWThresh(swThresh);	
+	    	isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);
+			measure(veto,i,isGood);
+			if (warm && foundFirst) {
+				if (last.SBCHolds(first.GetTimeSBC()-first.GetTimeSec(),start)) {
+					measured = i+1;
+					break;
+				}
+				printf("SBC offset isn't the one run %i predicts.  Not starting from it.\n",last.run);
+				warm = false;
+			}
 		}
 		// Find the SBC offset		
 		double SBCOffset = first.GetTimeSBC() - first.GetTimeSec();
 		printf("First good entry: %i  SBCOffset: %.2f\n",firstGoodEntry,SBCOffset);
 
 		// Find the LED frequency	
-		if (skippedEvents > 0) printf("Skipped %li of %li entries.\n",skippedEvents,vEntries);
+		if (!warm && skippedEvents > 0) printf("Skipped %li of %li entries.\n",skippedEvents,vEntries);
 		// if (corruptScaler > 0) printf("Corrupt scaler: %li of %li entries (%.2f%%) .\n"
 			// ,corruptScaler,vEntries,100*(double)corruptScaler/vEntries);
 		
-		bool LEDTurnedOff = false;
-		if (highestMultip < 20) {
-			printf("Warning!  LED's may be off!\n");
-			LEDTurnedOff = true;
-		}
 		// LEDrms = 0;
 		// LEDfreq = 0;
 		// int dtEntries = LEDDeltaT->GetEntries();
@@ -182,9 +249,23 @@ void muSimple(string Input, int *thresh)
 		// }
 		// double LEDperiod = 1/LEDfreq;
 
-		// Display Cut parameters
-		multipThreshold = highestMultip - LEDMultipThreshold;
-		printf("Panels: %i  Multip. Threshold: %i\n",highestMultip,multipThreshold);
+		// Set the cut from the highest multiplicity
+		bool LEDTurnedOff = false;
+		auto setCut = [&](int hm)
+		{
+			highestMultip = hm;
+			LEDTurnedOff = false;
+			if (highestMultip < 20) {
+				printf("Warning!  LED's may be off!\n");
+				LEDTurnedOff = true;
+			}
+
+			// Display Cut parameters
+			multipThreshold = highestMultip - LEDMultipThreshold;
+			printf("Panels: %i  Multip. Threshold: %i\n",highestMultip,multipThreshold);
+		};
+		if (warm) printf("Starting from run %i's panels after %li of %li entries.\n",last.run,measured,vEntries);
+		setCut(warm ? last.highestMultip : measuredMultip);
 
 		// printf("HM: %i LED_f: %.8f LED_t: %.8f RMS: %8f\n",highestMultip,LEDfreq,1/LEDfreq,LEDrms);
 		// printf("LED window: %.2f  Multip Threshold: %i\n",LEDWindow,multipThreshold);
@@ -199,224 +280,262 @@ void muSimple(string Input, int *thresh)
 		// ========= 2nd loop over veto entries - Find muons! =========
 		// This simple version will only tag LED events based on multiplicity.
 		//
-		prev.Clear();
-		MJVetoEvent prevLED;
+		VetoRing<2> history;
+		VetoRing<2> prevLEDs;
 		bool firstLED = false;
 		bool IsLEDPrev = false;
 		// int almostMissedLED = 0;
-		for (long i = 0; i < vEntries; i++) 
+		auto findMuons = [&]()
 		{
-			v->GetEntry(i);
-			rEntry = i;
-
-			MJVetoEvent veto;
-			veto.SetSWThresh(swThresh);	
-	    	isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);
-
-	    	//----------------------------------------------------------
-			// 0: Time of event and skipping if necessary.
-			// Employ alternate methods if the scaler is corrupted.
-			// Should implement an estimate of the error when alternate methods are used.
-			// 
-			bool ApproxTime = false;
-
-			xTime = -1; 
-
-			if (!veto.GetBadScaler()) xTime = veto.GetTimeSec();
-			else if (run > 8557 && veto.GetTimeSBC() < 2000000000) {
-				xTime = veto.GetTimeSBC() - SBCOffset;
-				ApproxTime = true;
-			}
-	    	else {
-	    		xTime = ((double)i / vEntries) * duration;
-	    		ApproxTime = true;
-	    	}
-
-	    	// Skip events after the event time is calculated.
-	    	if (CheckForBadErrors(veto,i,isGood,false)) 
-	    	{
-	    		printf("Skipping Entry %li.  Errors: ",i);
-
-	    		for (int j=0; j<18; j++) if (veto.GetError(j)==1) 
-	    		{
-	    			cout << j << " ";
-	    		}
-	    		cout << endl;
-	    		// cout << "\n \t Full event summary: " << endl;
-	    		// veto.Print();
-
-	    		// do the end-of-run reset
-	    		// if (veto.GetMultip() > multipThreshold) {
-					// xTimePrevLEDSimple = xTime;
-				// }
-				// IsLEDPrev = IsLED;
-				// prev = veto;
-				// xTimePrev = xTime;
-				// x_deltaTPrev = x_deltaT;
-	    		continue;
-	    	}
-
-			//----------------------------------------------------------
-			// 1. LED Cut
-			// 
-			// TRUE if an event PASSES (i.e. is physics.)  FALSE if an event is an LED.
-			//
-			bool IsLED = false;
-
-			// Set Cut
-			if (veto.GetMultip() > multipThreshold) IsLED = true;
-
-			// // Check output
-			// printf("%-3li  m %-3i LED? %i t %-6.2f LEDP %-5.2f  XDT %-6.2f LEDP-XDT %-6.2f\n"
-			// 	,i,veto.GetMultip(),IsLED,xTime,LEDperiod,x_deltaT,LEDperiod-x_deltaT);
-
-			//----------------------------------------------------------	    	
-	    	// 2: Energy (Gamma) Cut
-	    	// The measured muon energy threshold is QDC = 500.  
-	    	// Set TRUE if at least TWO panels are over 500.
-	    	//
-	    	bool EnergyCut = false;
-	    	
-	    	int over500Count = 0;
-	    	for (int q = 0; q < 32; q++) {
-	    		if (veto.GetQDC(q) > 500) 
-	    			over500Count++;
-	    	}
-	    	// if (over500Count >= 2) EnergyCut = true;	// used in DS1
-	    	if (over500Count >= 1) EnergyCut = true;	// used in DS0
-
-			//----------------------------------------------------------
-			// 3: Hit Pattern
-			// Map hits above SW threshold to planes and count the hits.
-			// 
-
-			// reset
-			PlaneHitCount = 0;
-			for (int k = 0; k < 12; k++) { 
-				PlaneTrue[k] = 0; 
-				PlaneHits[k]=0; 
-			}
-			for (int k = 0; k < 32; k++) 
+			history.Clear();
+			prevLEDs.Clear();
+			firstLED = false;
+			IsLEDPrev = false;
+			runLines.clear();
+			heldRows.clear();
+			holdRows = warm;
+			for (long i = 0; i < vEntries; i++) 
 			{
-				if (veto.GetQDC(k) > veto.GetSWThresh(k))
+				v->GetEntry(i);
+
+				MuSimpleRow &row = writer.Next();	// filled in place, written later
+				row.rEntry = i;
+				row.skipped = false;
+				row.listType = 0;
+				row.listGap = false;
+				int *CoinType = row.CoinType;
+				int *CutType = row.CutType;
+				int *PlaneHits = row.PlaneHits;
+				int *PlaneTrue = row.PlaneTrue;
+				int &PlaneHitCount = row.PlaneHitCount;
+				double &xTime = row.xTime;
+
+				MJVetoEvent &veto = row.veto;
+				veto.Clear();
+				veto.SetSWThresh(swThresh);	
+		    	isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);
+				if (warm && i >= measured) measure(veto,i,isGood);	// the 1st loop's job, for the entries it didn't get to
+
+		    	//----------------------------------------------------------
+				// 0: Time of event and skipping if necessary.
+				// Employ alternate methods if the scaler is corrupted.
+				// Should implement an estimate of the error when alternate methods are used.
+				// 
+				bool ApproxTime = false;
+
+				xTime = -1; 
+
+				if (!veto.GetBadScaler()) xTime = veto.GetTimeSec();
+				else if (run > 8557 && veto.GetTimeSBC() < 2000000000) {
+					xTime = veto.GetTimeSBC() - SBCOffset;
+					ApproxTime = true;
+				}
+		    	else {
+		    		xTime = ((double)i / vEntries) * duration;
+		    		ApproxTime = true;
+		    	}
+
+		    	// Skip events after the event time is calculated.
+		    	if (GetErrorPolicy().IsFatal(isGood)) 
+		    	{
+		    		printf("Skipping Entry %li.  Errors: ",i);
+
+		    		for (int j=0; j<18; j++) if (veto.GetError(j)==1) 
+		    		{
+		    			cout << j << " ";
+		    		}
+		    		cout << endl;
+		    		// cout << "\n \t Full event summary: " << endl;
+		    		// veto.Print();
+
+		    		// do the end-of-run reset
+		    		// if (veto.GetMultip() > multipThreshold) {
+						// xTimePrevLEDSimple = xTime;
+					// }
+					// IsLEDPrev = IsLED;
+					// prev = veto;
+					// xTimePrev = xTime;
+					// x_deltaTPrev = x_deltaT;
+					row.skipped = true;
+		    		continue;
+		    	}
+
+				//----------------------------------------------------------
+				// 1. LED Cut
+				// 
+				// TRUE if an event PASSES (i.e. is physics.)  FALSE if an event is an LED.
+				//
+				bool IsLED = false;
+
+				// Set Cut
+				if (veto.GetMultip() > multipThreshold) IsLED = true;
+
+				// // Check output
+				// printf("%-3li  m %-3i LED? %i t %-6.2f LEDP %-5.2f  XDT %-6.2f LEDP-XDT %-6.2f\n"
+				// 	,i,veto.GetMultip(),IsLED,xTime,LEDperiod,x_deltaT,LEDperiod-x_deltaT);
+
+				//----------------------------------------------------------	    	
+		    	// 2: Energy (Gamma) Cut
+		    	// The measured muon energy threshold is QDC = 500.  
+		    	// Set TRUE if at least TWO panels are over 500.
+		    	//
+		    	bool EnergyCut = false;
+	    	
+		    	int over500Count = 0;
+		    	for (int q = 0; q < 32; q++) {
+		    		if (veto.GetQDC(q) > 500) 
+		    			over500Count++;
+		    	}
+		    	// if (over500Count >= 2) EnergyCut = true;	// used in DS1
+		    	if (over500Count >= 1) EnergyCut = true;	// used in DS0
+
+				//----------------------------------------------------------
+				// 3: Hit Pattern
+				// Map hits above SW threshold to planes and count the hits.
+				// 
+
+				// reset
+				PlaneHitCount = 0;
+				for (int k = 0; k < 12; k++) { 
+					PlaneTrue[k] = 0; 
+					PlaneHits[k]=0; 
+				}
+				for (int k = 0; k < 32; k++) 
 				{
-					if (PanelMap(k)==0) { PlaneTrue[0]=1; PlaneHits[0]++; }			// 0: Lower Bottom
-					else if (PanelMap(k)==1) { PlaneTrue[1]=1; PlaneHits[1]++; }		// 1: Upper Bottom
-					else if (PanelMap(k)==2) { PlaneTrue[2]=1; PlaneHits[2]++; }		// 3: Inner Top
-					else if (PanelMap(k)==3) { PlaneTrue[3]=1; PlaneHits[3]++; }		// 4: Outer Top
-					else if (PanelMap(k)==4) { PlaneTrue[4]=1; PlaneHits[4]++; }		// 5: Inner North
-					else if (PanelMap(k)==5) { PlaneTrue[5]=1; PlaneHits[5]++; }		// 6: Outer North
-					else if (PanelMap(k)==6) { PlaneTrue[6]=1; PlaneHits[6]++; }		// 7: Inner South
-					else if (PanelMap(k)==7) { PlaneTrue[7]=1; PlaneHits[7]++; }		// 8: Outer South
-					else if (PanelMap(k)==8) { PlaneTrue[8]=1; PlaneHits[8]++; }		// 9: Inner West
-					else if (PanelMap(k)==9) { PlaneTrue[9]=1; PlaneHits[9]++; }		// 10: Outer West
-					else if (PanelMap(k)==10) { PlaneTrue[10]=1; PlaneHits[10]++; }	// 11: Inner East
-					else if (PanelMap(k)==11) { PlaneTrue[11]=1; PlaneHits[11]++; }	// 12: Outer East
+					if (veto.GetQDC(k) > veto.GetSWThresh(k))
+					{
+						if (PanelMap(k)==0) { PlaneTrue[0]=1; PlaneHits[0]++; }			// 0: Lower Bottom
+						else if (PanelMap(k)==1) { PlaneTrue[1]=1; PlaneHits[1]++; }		// 1: Upper Bottom
+						else if (PanelMap(k)==2) { PlaneTrue[2]=1; PlaneHits[2]++; }		// 3: Inner Top
+						else if (PanelMap(k)==3) { PlaneTrue[3]=1; PlaneHits[3]++; }		// 4: Outer Top
+						else if (PanelMap(k)==4) { PlaneTrue[4]=1; PlaneHits[4]++; }		// 5: Inner North
+						else if (PanelMap(k)==5) { PlaneTrue[5]=1; PlaneHits[5]++; }		// 6: Outer North
+						else if (PanelMap(k)==6) { PlaneTrue[6]=1; PlaneHits[6]++; }		// 7: Inner South
+						else if (PanelMap(k)==7) { PlaneTrue[7]=1; PlaneHits[7]++; }		// 8: Outer South
+						else if (PanelMap(k)==8) { PlaneTrue[8]=1; PlaneHits[8]++; }		// 9: Inner West
+						else if (PanelMap(k)==9) { PlaneTrue[9]=1; PlaneHits[9]++; }		// 10: Outer West
+						else if (PanelMap(k)==10) { PlaneTrue[10]=1; PlaneHits[10]++; }	// 11: Inner East
+						else if (PanelMap(k)==11) { PlaneTrue[11]=1; PlaneHits[11]++; }	// 12: Outer East
+					}
+				}
+				for (int k = 0; k < 12; k++) {
+					if (PlaneTrue[k]) PlaneHitCount++;
 				}
-			}
-			for (int k = 0; k < 12; k++) {
-				if (PlaneTrue[k]) PlaneHitCount++;
-			}
 
-			//----------------------------------------------------------
-			// 4: Muon Identification
-			// Use EnergyCut, TimeCut, and the Hit Pattern to identify them sumbitches.
+				//----------------------------------------------------------
+				// 4: Muon Identification
+				// Use EnergyCut, TimeCut, and the Hit Pattern to identify them sumbitches.
 
-			// reset
-			for (int r = 0; r < 32; r++) {CoinType[r]=0; CutType[r]=0;}
+				// reset
+				for (int r = 0; r < 32; r++) {CoinType[r]=0; CutType[r]=0;}
 
-			// Check output
-			// printf("i %-3li  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
-				// ,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
+				// Check output
+				// printf("i %-3li  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
+					// ,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
 
-			if (EnergyCut && !IsLED)
-			{
-				// 0. Everything that energy cut that is not an LED.
-				// This is what goes into the DEMONSTRATOR veto cut.
-				CoinType[0] = true;
-				printf("Entry: %li  2+Panel Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
-					,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
-
-				// 1. Definite Vertical Muons
-				if (PlaneTrue[0] && PlaneTrue[1] && PlaneTrue[2] && PlaneTrue[3]) {
-					CoinType[1] = true;
-					printf("Entry: %li  Vertical Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
+				if (EnergyCut && !IsLED)
+				{
+					// 0. Everything that energy cut that is not an LED.
+					// This is what goes into the DEMONSTRATOR veto cut.
+					CoinType[0] = true;
+					printf("Entry: %li  2+Panel Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
 						,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
-				}
 
-				// 2. Both top or side layers + both bottom layers.
-				if ((PlaneTrue[0] && PlaneTrue[1]) && ((PlaneTrue[2] && PlaneTrue[3]) || (PlaneTrue[4] && PlaneTrue[5])
-					|| (PlaneTrue[6] && PlaneTrue[7]) || (PlaneTrue[8] && PlaneTrue[9]) || (PlaneTrue[10] && PlaneTrue[11]))) {
-					CoinType[2] = true;
-					
-					// show output if we haven't seen it from CT1 already
-					if (!CoinType[1]) { 
-						printf("Entry: %li  Side+Bottom Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
+					// 1. Definite Vertical Muons
+					if (PlaneTrue[0] && PlaneTrue[1] && PlaneTrue[2] && PlaneTrue[3]) {
+						CoinType[1] = true;
+						printf("Entry: %li  Vertical Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
 							,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
 					}
-				}
 
-				// 3. Both Top + Both Sides
-				if ((PlaneTrue[2] && PlaneTrue[3]) && ((PlaneTrue[4] && PlaneTrue[5]) || (PlaneTrue[6] && PlaneTrue[7])
-					|| (PlaneTrue[8] && PlaneTrue[9]) || (PlaneTrue[10] && PlaneTrue[11]))) {
-					CoinType[3] = true;
-
-					// show output if we haven't seen it from CT1 or CT2 already
-					if (!CoinType[1] && !CoinType[2]) { 
-						printf("Entry: %li  Top+Sides Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
-							,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
+					// 2. Both top or side layers + both bottom layers.
+					if ((PlaneTrue[0] && PlaneTrue[1]) && ((PlaneTrue[2] && PlaneTrue[3]) || (PlaneTrue[4] && PlaneTrue[5])
+						|| (PlaneTrue[6] && PlaneTrue[7]) || (PlaneTrue[8] && PlaneTrue[9]) || (PlaneTrue[10] && PlaneTrue[11]))) {
+						CoinType[2] = true;
+					
+						// show output if we haven't seen it from CT1 already
+						if (!CoinType[1]) { 
+							printf("Entry: %li  Side+Bottom Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
+								,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
+						}
 					}
-				}
 
-				// Other coincidence types can be found by parsing the ROOT output.
-			}
+					// 3. Both Top + Both Sides
+					if ((PlaneTrue[2] && PlaneTrue[3]) && ((PlaneTrue[4] && PlaneTrue[5]) || (PlaneTrue[6] && PlaneTrue[7])
+						|| (PlaneTrue[8] && PlaneTrue[9]) || (PlaneTrue[10] && PlaneTrue[11]))) {
+						CoinType[3] = true;
 
-			//----------------------------------------------------------
-			// 5: Output
-			// The skim file used to take a text file of muon candidate events.
-			// Additionally, write the ROOT file containing all the real data.
-			// 
-
-			char buffer[200];
-			if (CoinType[1] || CoinType[0]) {
-				int type;
-				if (CoinType[0]) type = 1;
-				if (CoinType[1]) type = 2;
-				sprintf(buffer,"%i %li %.8f %i %i\n",run,start,xTime,type,veto.GetBadScaler());
-				MuonList << buffer;
-			}
-			// This is Jason's TYPE 3: flag runs with gaps since the last stop time.
-			if ((start - prevStopTime) > 10 && i == 0) {
-				sprintf(buffer,"%i %li 0.0 3 0\n",run,start);
-				MuonList << buffer;
-			}
+						// show output if we haven't seen it from CT1 or CT2 already
+						if (!CoinType[1] && !CoinType[2]) { 
+							printf("Entry: %li  Top+Sides Muon.  m %-3i  t %-6.2f  LED? %i  EC %i  QTot %i\n"
+								,i,veto.GetMultip(),xTime,IsLED,EnergyCut,veto.GetTotE());
+						}
+					}
 
-			// Assign all bools calculated to the int array CutType[32];
-			CutType[0] = LEDTurnedOff;
-			CutType[1] = EnergyCut;
-			CutType[2] = ApproxTime;
-			// CutType[3] = TimeCut;
-			CutType[4] = IsLED;
-			CutType[5] = firstLED;
-			CutType[6] = badLEDFreq;
-
-			// Write ROOT output
-			out = veto;
-			vetoEvent->Fill();
-
-			// Reset for next entry
-			//----------------------------------------------------------
-			if (IsLED) {
-				prevLED = veto;
+					// Other coincidence types can be found by parsing the ROOT output.
+				}
+
+				//----------------------------------------------------------
+				// 5: Output
+				// The skim file used to take a text file of muon candidate events.
+				// Additionally, write the ROOT file containing all the real data.
+				// 
+
+				if (CoinType[1] || CoinType[0]) {
+					int type;
+					if (CoinType[0]) type = 1;
+					if (CoinType[1]) type = 2;
+					row.listType = type;
+				}
+				// This is Jason's TYPE 3: flag runs with gaps since the last stop time.
+				if ((start - prevStopTime) > 10 && i == 0) row.listGap = true;
+
+				// Assign all bools calculated to the int array CutType[32];
+				CutType[0] = LEDTurnedOff;
+				CutType[1] = EnergyCut;
+				CutType[2] = ApproxTime;
+				// CutType[3] = TimeCut;
+				CutType[4] = IsLED;
+				CutType[5] = firstLED;
+				CutType[6] = badLEDFreq;
+
+				// ROOT output: the writer thread fills the tree from the row.
+
+				// Reset for next entry
+				//----------------------------------------------------------
+				if (IsLED) {
+					prevLEDs.Push(veto,isGood,i);
+				}
+				IsLEDPrev = IsLED;
+				history.Push(veto,isGood,i);
+		    }
+			writer.Flush();
+		};
+		findMuons();
+
+		// A warm start holds if the run has the panels the last one had.
+		if (warm) {
+			if (skippedEvents > 0) printf("Skipped %li of %li entries.\n",skippedEvents,vEntries);
+			if (measuredMultip != highestMultip) {
+				printf("Run %i has %i panels, not %i.  Scanning it again.\n",run,measuredMultip,highestMultip);
+				warm = false;
+				setCut(measuredMultip);
+				findMuons();
 			}
-			IsLEDPrev = IsLED;
-			prev = veto;
-	    } 	
+			else for (auto &row : heldRows) fillTree(row);
+			heldRows.clear();
+			holdRows = false;
+		}
+		GetErrorPolicy().Add(runErrors);
+		MuonList << runLines;
+		last.Set(run,start,highestMultip,0,0,SBCOffset);
 
 	    // done with this run.
 		delete ds;
 		prevStopTime = stop;
 	}
+	writer.Close();
+	outPtr = &out;
 
 	printf("\n===================== End of Scan. =====================\n");
 
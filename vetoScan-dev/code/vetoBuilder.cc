@@ -0,0 +1,308 @@
+// Build veto events straight from the built data's VetoTree packets.
+// Clint Wiseman, USC/Majorana
+//
+// Replaces the hand-built VEvent/QEvent matching in scripts/builtVeto.C and
+// builtVetoCal.C.  Each MJTVetoData packet is sorted by its card: QDC1
+// (panels 0-15), QDC2 (panels 16-31), or the scaler (any other card).  QDC
+// packets are grouped by EventCount, so QDC1 and QDC2 can come in different
+// VetoTree entries and in either order.  Up to `window` EventCounts are held
+// open at once.  When one is full it's written out, and when the window
+// overflows the oldest one is written out incomplete.  Older files have no
+// separate scaler packet, so the scaler info from the entry's first packet is used.
+//
+// Each event has the 32 QDC values and bitmasks of the under-threshold and
+// overflow channels.  Runs are built in parallel, one output file per run:
+//   ./output/<Name>_built/<Name>_run<N>.root (tree "vetoBuilt")
+// and a manifest (./output/<Name>_built_manifest.txt).  Mismatch counts,
+// numbered as in vetoCheck, go to ./output/vetoBuilt_<Name>.txt:
+//   10. Scaler EventCount - entry changed (relative to the run's first event)
+//   11. Scaler EventCount - QDC1 EventCount changed (same)
+//   12. An EventCount that only one QDC card ever sent
+//   13/14. QDC1/QDC2 packet index differs from the scaler's by more than 2
+//   15. A QDC packet index precedes the scaler's
+//   16. A QDC packet index equals the scaler's
+//   17. Unknown card (only counted if there's already a scaler packet in the entry)
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include "TSystem.h"
+#include "MJTVetoData.hh"
+#include "vetoScan.hh"
+#include "code/RunSet.hh"
+using namespace std;
+
+struct VBEvent {
+	long entry;		// VetoTree entry of the first packet
+	int nChan[2];	// channels seen from QDC1, QDC2
+	uint32_t seen;	// channel bits seen
+	bool hasScaler;
+	Long64_t SEC, QEC1, QEC2;
+	long sIndex, q1Index, q2Index;
+	double sTime;
+	bool badTS;
+	int qdc[32];
+	uint32_t under, over;
+	VBEvent() : entry(0), seen(0), hasScaler(false), SEC(0), QEC1(-1), QEC2(-1), sIndex(-1), q1Index(-1), q2Index(-1),
+		sTime(0), badTS(false), under(0), over(0) {
+		nChan[0] = nChan[1] = 0;
+		for (int i = 0; i < 32; i++) qdc[i] = 0;
+	}
+};
+
+struct VBStats {
+	long packets, events, complete, duplicates, reordered;
+	long err[18];
+	VBStats() : packets(0), events(0), complete(0), duplicates(0), reordered(0) {
+		for (int i = 0; i < 18; i++) err[i] = 0;
+	}
+};
+
+// Build one run.  Returns false if the file can't be read or doesn't hold veto packets.
+static bool BuildRun(int run, string inFile, string outFile, int card1, int card2, int window, VBStats &st, long &nOut)
+{
+	TFile *f = TFile::Open(inFile.c_str());
+	if (f == NULL || f->IsZombie()) {
+		printf("Couldn't open %s\n",inFile.c_str());
+		return false;
+	}
+	TTree *VetoTree = (TTree*)f->Get("VetoTree");
+	if (VetoTree == NULL) {
+		printf("No VetoTree in %s\n",inFile.c_str());
+		f->Close();
+		return false;
+	}
+	VetoTree->SetBranchStatus("*",0);
+	VetoTree->SetBranchStatus("vetoEvent*",1);
+	MGTBasicEvent *b = new MGTBasicEvent();
+	VetoTree->SetBranchAddress("vetoEvent",&b);
+	long nEntries = VetoTree->GetEntries();
+
+	// output
+	TFile *out = new TFile(outFile.c_str(),"RECREATE");
+	TTree *t = new TTree("vetoBuilt","built veto events");
+	int oRun = run;
+	Long64_t oEntry = 0, oSEC = 0, oQEC = 0, oQEC2 = 0;
+	double oTime = 0;
+	int oBadTS = 0, oComplete = 0;
+	int oQDC[32];
+	uint32_t oUnder = 0, oOver = 0;
+	t->Branch("run",&oRun,"run/I");
+	t->Branch("entry",&oEntry,"entry/L");
+	t->Branch("SEC",&oSEC,"SEC/L");
+	t->Branch("QEC",&oQEC,"QEC/L");
+	t->Branch("QEC2",&oQEC2,"QEC2/L");
+	t->Branch("sTime",&oTime,"sTime/D");
+	t->Branch("badTS",&oBadTS,"badTS/I");
+	t->Branch("complete",&oComplete,"complete/I");
+	t->Branch("QDC",oQDC,"QDC[32]/I");
+	t->Branch("underThresh",&oUnder,"underThresh/i");
+	t->Branch("overflow",&oOver,"overflow/i");
+
+	map<Long64_t,VBEvent> open;	// keyed by QDC EventCount
+	set<Long64_t> unpaired;		// EventCounts written with one card's packets, and not yet the other's
+	long lastEntry = -1;
+	bool haveOffsets = false;
+	Long64_t entryOffset = 0, qdcOffset = 0;
+
+	auto emit = [&](VBEvent &e)
+	{
+		bool complete = (e.nChan[0] == 16 && e.nChan[1] == 16);
+		st.events++;
+		if (complete) st.complete++;
+		if (e.QEC1 < 0 || e.QEC2 < 0) {
+			// the other card's half came before (out of the window), or may still come
+			Long64_t ec = (e.QEC1 >= 0) ? e.QEC1 : e.QEC2;
+			if (!unpaired.erase(ec)) unpaired.insert(ec);
+		}
+		if (e.entry < lastEntry) st.reordered++;
+		lastEntry = max(lastEntry,e.entry);
+		if (e.hasScaler && complete) {
+			if (!haveOffsets) {
+				entryOffset = e.SEC - e.entry;
+				qdcOffset = e.SEC - e.QEC1;
+				haveOffsets = true;
+			}
+			if (e.SEC - e.entry != entryOffset) st.err[10]++;
+			if (e.SEC - e.QEC1 != qdcOffset) st.err[11]++;
+			if (e.sIndex >= 0) {
+				if (labs(e.q1Index - e.sIndex) > 2) st.err[13]++;
+				if (labs(e.q2Index - e.sIndex) > 2) st.err[14]++;
+				if (e.q1Index < e.sIndex || e.q2Index < e.sIndex) st.err[15]++;
+				if (e.q1Index == e.sIndex || e.q2Index == e.sIndex) st.err[16]++;
+			}
+		}
+		oEntry = e.entry;
+		oSEC = e.SEC;
+		oQEC = e.QEC1;
+		oQEC2 = e.QEC2;
+		oTime = e.sTime;
+		oBadTS = e.badTS;
+		oComplete = complete;
+		memcpy(oQDC,e.qdc,sizeof(oQDC));
+		oUnder = e.under;
+		oOver = e.over;
+		t->Fill();
+	};
+
+	bool checked = false;
+	for (long i = 0; i < nEntries; i++)
+	{
+		VetoTree->GetEntry(i);
+		TClonesArray *arr = b->GetDetectorData();
+		int n = arr->GetEntriesFast();
+		if (n == 0) continue;
+		if (!checked) {
+			// the array holds one class, so one check per run is enough
+			if (dynamic_cast<MJTVetoData*>(arr->At(0)) == NULL) {
+				printf("Run %i: VetoTree doesn't hold MJTVetoData, skipping.\n",run);
+				out->Close();
+				delete out;
+				remove(outFile.c_str());
+				f->Close();
+				delete f;
+				delete b;
+				return false;
+			}
+			checked = true;
+		}
+
+		// scaler packet for this entry (or the first packet, for older files)
+		MJTVetoData *scaler = NULL;
+		for (int k = 0; k < n; k++) {
+			MJTVetoData *vd = (MJTVetoData*)arr->At(k);
+			if (vd->GetCard() != card1 && vd->GetCard() != card2) {
+				if (scaler != NULL) st.err[17]++;
+				else scaler = vd;
+			}
+		}
+		bool scalerPacket = (scaler != NULL);
+		if (scaler == NULL) scaler = (MJTVetoData*)arr->At(0);
+
+		for (int k = 0; k < n; k++)
+		{
+			MJTVetoData *vd = (MJTVetoData*)arr->At(k);
+			st.packets++;
+			int card = vd->GetCard();
+			if (card != card1 && card != card2) continue;
+			int q = (card == card1) ? 0 : 1;
+			Long64_t ec = vd->GetEventCount();
+			VBEvent &e = open[ec];
+			if (e.nChan[0] + e.nChan[1] == 0 && !e.hasScaler) e.entry = i;
+			if (q == 0) { e.QEC1 = ec; e.q1Index = vd->GetIndex(); }
+			else { e.QEC2 = ec; e.q2Index = vd->GetIndex(); }
+			int ch = vd->GetChannel();
+			if (ch < 0 || ch > 15) continue;
+			int p = 16*q + ch;
+			if (e.seen & (1u << p)) { st.duplicates++; continue; }
+			e.seen |= (1u << p);
+			e.nChan[q]++;
+			e.qdc[p] = vd->GetAmplitude();
+			if (vd->IsUnderThreshold()) e.under |= (1u << p);
+			if (vd->IsOverflow()) e.over |= (1u << p);
+			if (!e.hasScaler) {
+				e.hasScaler = true;
+				e.SEC = scaler->GetScalerCount();
+				e.sTime = scaler->GetTimeStamp()/1E8;
+				e.badTS = scaler->IsBadTS();
+				e.sIndex = scalerPacket ? scaler->GetIndex() : -1;
+			}
+		}
+
+		// write out what's complete, and the oldest events if the window is full
+		for (auto it = open.begin(); it != open.end(); ) {
+			if (it->second.nChan[0] == 16 && it->second.nChan[1] == 16) {
+				emit(it->second);
+				it = open.erase(it);
+			}
+			else it++;
+		}
+		while ((int)open.size() > window) {
+			emit(open.begin()->second);
+			open.erase(open.begin());
+		}
+	}
+	for (auto &e : open) emit(e.second);
+	st.err[12] = (long)unpaired.size();
+	nOut = st.events;
+
+	out->cd();
+	t->Write("",TObject::kOverwrite);
+	out->Close();
+	delete out;
+	f->Close();
+	delete f;
+	delete b;
+	return true;
+}
+
+void vetoBuilder(string Input, string partNum, int window)
+{
+	RunSet runSet;
+	if (!runSet.Load(Input)) return;
+	if (partNum == "") {
+		cout << "Warning!  Empty part number!" << endl;
+		return;
+	}
+	string Name = Input;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
+
+	string path = "/global/project/projectdirs/majorana/data/mjd/surfmjd/data";
+	if (getenv("MJDDATADIR") != NULL) path = getenv("MJDDATADIR");
+	const int card1 = 13, card2 = 18;	// QDC cards: panels 0-15, 16-31
+
+	vector<int> runs(runSet.begin(),runSet.end());
+	int nRuns = (int)runs.size();
+
+	string outDir = "./output/"+Name+"_built";
+	gSystem->mkdir(outDir.c_str(),kTRUE);
+	printf("Building %i runs with %i threads, reorder window %i.\n",nRuns,min(nRuns,GetNumThreads()),window);
+
+	vector<VBStats> stats(nRuns);
+	vector<long> nOut(nRuns,0);
+	vector<char> ok(nRuns,0);
+	vector<string> outFiles(nRuns);
+	RunParallel(nRuns, [&](int i)
+	{
+		char buf[300];
+		sprintf(buf,"%s/built/%s/OR_run%u.root",path.c_str(),partNum.c_str(),runs[i]);
+		string inFile = buf;
+		sprintf(buf,"%s/%s_run%i.root",outDir.c_str(),Name.c_str(),runs[i]);
+		outFiles[i] = buf;
+		ok[i] = BuildRun(runs[i],inFile,outFiles[i],card1,card2,window,stats[i],nOut[i]);
+	});
+
+	// manifest, in run order
+	string manifestName = "./output/"+Name+"_built_manifest.txt";
+	ofstream Manifest(manifestName.c_str());
+	Manifest << "# shardFile listFile firstRun lastRun nRuns entries\n";
+	for (int i = 0; i < nRuns; i++)
+		if (ok[i]) Manifest << outFiles[i] << " - " << runs[i] << " " << runs[i] << " 1 " << nOut[i] << "\n";
+	Manifest.close();
+
+	// mismatch statistics
+	string statName = "./output/vetoBuilt_"+Name+".txt";
+	ofstream Stats(statName.c_str());
+	Stats << "# run packets events complete duplicates reordered err10 err11 err12 err13 err14 err15 err16 err17\n";
+	VBStats tot;
+	char line[300];
+	for (int i = 0; i < nRuns; i++)
+	{
+		if (!ok[i]) continue;
+		VBStats &s = stats[i];
+		sprintf(line,"%i %li %li %li %li %li",runs[i],s.packets,s.events,s.complete,s.duplicates,s.reordered);
+		Stats << line;
+		for (int e = 10; e <= 17; e++) Stats << " " << s.err[e];
+		Stats << endl;
+		tot.packets += s.packets; tot.events += s.events; tot.complete += s.complete;
+		tot.duplicates += s.duplicates; tot.reordered += s.reordered;
+		for (int e = 10; e <= 17; e++) tot.err[e] += s.err[e];
+	}
+	Stats.close();
+
+	printf("\n%li packets, %li events (%li complete), %li duplicate channels, %li out of order.\n",
+		tot.packets,tot.events,tot.complete,tot.duplicates,tot.reordered);
+	for (int e = 10; e <= 17; e++) if (tot.err[e] > 0) printf("  Error[%i]: %li events\n",e,tot.err[e]);
+	printf("Statistics: %s\nManifest: %s\n",statName.c_str(),manifestName.c_str());
+}
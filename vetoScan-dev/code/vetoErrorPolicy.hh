@@ -0,0 +1,233 @@
+// VetoErrorPolicy: which MJVetoEvent errors make an entry unusable.
+// Replaces CheckForBadErrors.  Used by every routine that skips bad entries,
+// and by vetoCheck.
+//
+// Each of the 18 built-in error types (see vetoPerformance's error summary) is
+// fatal (the entry is skipped), warn (kept, but counted) or ignore.  The
+// actions come from vetoErrorPolicy.txt, one line per data set:
+//   name  a0 a1 ... a17      (a = F, W or I)
+// looked up by name like vetoSWThresholds.txt, falling back to "default",
+// then to the built-in default below.
+//
+// The actions are turned into a mask on the packed error code that
+// MJVetoEvent::WriteEvent returns, so checking an entry is one AND.  The bit
+// each error uses is found once, by unpacking single-bit codes.  Per-error
+// counts of the fatal and warn errors are kept for the end-of-job summary.
+// A routine that can scan a run twice counts each run on its own
+// (VetoErrorCounts) and adds the counts from the pass it keeps.
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef VETOERRORPOLICY_HH
+#define VETOERRORPOLICY_HH
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <atomic>
+#include <cstdio>
+#include <stdint.h>
+#include "MJVetoEvent.hh"
+
+enum VetoErrorAction { kErrIgnore = 0, kErrWarn = 1, kErrFatal = 2 };
+
+// One run's counts (see VetoErrorPolicy::Add)
+struct VetoErrorCounts
+{
+	long count[18];
+	long skipped;
+	VetoErrorCounts() { Clear(); }
+	void Clear() {
+		for (int q = 0; q < 18; q++) count[q] = 0;
+		skipped = 0;
+	}
+};
+
+class VetoErrorPolicy
+{
+	public:
+
+	static const int nErrs = 18;
+
+	// Built-in default (the old CheckForBadErrors list):
+	// 4: don't skip bad-scaler events
+	// 10: P3K93: don't skip "event count doesn't match ROOT entry" events
+	// 7 & 11: don't skip hw count mismatches or scaler != qdc event count.  Due to problems with continuous running mode.
+	// 12: don't skip QDC1/QDC2 event count mismatches.
+	VetoErrorPolicy() : fName("built-in")
+	{
+		MapBits();
+		for (int q = 0; q < nErrs; q++) fAction[q] = kErrFatal;
+		fAction[4] = fAction[7] = fAction[10] = fAction[11] = fAction[12] = kErrWarn;
+		Update();
+	}
+
+	// Copies the actions, not the counts.
+	VetoErrorPolicy(const VetoErrorPolicy &o) : fName(o.fName)
+	{
+		for (int b = 0; b < 32; b++) fBitErr[b] = o.fBitErr[b];
+		for (int q = 0; q < nErrs; q++) fAction[q] = o.fAction[q];
+		Update();
+	}
+
+	// Look up a data set in the policy file.  Returns false (and keeps the
+	// current actions) if neither it nor "default" is there.
+	bool Load(std::string dataSet, std::string file = "vetoErrorPolicy.txt")
+	{
+		std::ifstream InputList(file.c_str());
+		if (!InputList.good()) return false;
+		std::string line, def = "";
+		bool found = false;
+		while (!found && getline(InputList,line))
+		{
+			if (line.empty() || line[0] == '#') continue;
+			std::stringstream ss(line);
+			std::string name, rest;
+			ss >> name;
+			getline(ss,rest);
+			if (name == dataSet) { line = rest; found = true; }
+			else if (name == "default" && def == "") def = rest;
+		}
+		if (!found && def == "") return false;
+		if (!SetActions(found ? line : def)) {
+			std::cout << "Bad error policy for " << (found ? dataSet : "default") << " in " << file << std::endl;
+			return false;
+		}
+		fName = found ? dataSet : "default";
+		return true;
+	}
+
+	// 18 letters (F, W, I), spaces optional.
+	bool SetActions(std::string codes)
+	{
+		VetoErrorAction a[nErrs];
+		int n = 0;
+		for (size_t i = 0; i < codes.size(); i++) {
+			char c = codes[i];
+			if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;
+			if (n == nErrs) return false;
+			if (c == 'F' || c == 'f') a[n++] = kErrFatal;
+			else if (c == 'W' || c == 'w') a[n++] = kErrWarn;
+			else if (c == 'I' || c == 'i') a[n++] = kErrIgnore;
+			else return false;
+		}
+		if (n != nErrs) return false;
+		for (int q = 0; q < nErrs; q++) fAction[q] = a[q];
+		Update();
+		return true;
+	}
+
+	void SetAction(int err, VetoErrorAction a)
+	{
+		if (err < 0 || err >= nErrs) return;
+		fAction[err] = a;
+		Update();
+	}
+
+	VetoErrorAction GetAction(int err) const { return fAction[err]; }
+	std::string GetName() const { return fName; }
+
+	// Should this entry be skipped?  isGood is WriteEvent's return value (1 = no errors).
+	bool Check(MJVetoEvent &veto, int entry, int isGood, bool verbose = false)
+	{
+		if (isGood == 1) return false;
+		uint32_t code = (uint32_t)isGood;
+		for (uint32_t c = code & fCountMask; c != 0; c &= c-1) fCount[fBitErr[__builtin_ctz(c)]]++;
+		if ((code & fFatalMask) == 0) return false;
+		fSkipped++;
+		if (verbose) {
+			std::cout << "Skipped Entry: " << entry << std::endl;
+			veto.Print();
+			std::cout << std::endl;
+		}
+		return true;
+	}
+
+	// Same, counting into a run's own counts instead.
+	bool Check(MJVetoEvent &veto, int entry, int isGood, VetoErrorCounts &counts, bool verbose = false)
+	{
+		if (isGood == 1) return false;
+		uint32_t code = (uint32_t)isGood;
+		for (uint32_t c = code & fCountMask; c != 0; c &= c-1) counts.count[fBitErr[__builtin_ctz(c)]]++;
+		if ((code & fFatalMask) == 0) return false;
+		counts.skipped++;
+		if (verbose) {
+			std::cout << "Skipped Entry: " << entry << std::endl;
+			veto.Print();
+			std::cout << std::endl;
+		}
+		return true;
+	}
+
+	void Add(const VetoErrorCounts &counts)
+	{
+		for (int q = 0; q < nErrs; q++) fCount[q] += counts.count[q];
+		fSkipped += counts.skipped;
+	}
+
+	// Same test without counting, for a second pass over entries already checked.
+	bool IsFatal(int isGood) const
+	{
+		return isGood != 1 && ((uint32_t)isGood & fFatalMask) != 0;
+	}
+
+	long GetCount(int err) const { return fCount[err]; }
+	long GetSkipped() const { return fSkipped; }
+
+	void ResetCounts()
+	{
+		for (int q = 0; q < nErrs; q++) fCount[q] = 0;
+		fSkipped = 0;
+	}
+
+	// (prints nothing if no errors were seen)
+	void PrintCounts() const
+	{
+		long tot = fSkipped;
+		for (int q = 0; q < nErrs; q++) tot += fCount[q];
+		if (tot == 0) return;
+		const char act[3] = {'I','W','F'};
+		printf("Error policy \"%s\": skipped %li entries.\n",fName.c_str(),(long)fSkipped);
+		for (int q = 0; q < nErrs; q++)
+			if (fCount[q] > 0) printf("  %i (%c): %li\n",q,act[fAction[q]],(long)fCount[q]);
+	}
+
+	private:
+
+	void MapBits()
+	{
+		MJVetoEvent ev;
+		for (int b = 0; b < 32; b++)
+		{
+			fBitErr[b] = -1;
+			if (b == 31) break;
+			int err[nErrs] = {0};
+			ev.UnpackErrorCode(1 << b, err);
+			for (int q = 0; q < nErrs; q++) if (err[q] == 1) { fBitErr[b] = q; break; }
+		}
+	}
+
+	void Update()
+	{
+		fFatalMask = fCountMask = 0;
+		for (int b = 0; b < 32; b++) {
+			int q = fBitErr[b];
+			if (q < 0) continue;
+			if (fAction[q] == kErrFatal) fFatalMask |= (1u << b);
+			if (fAction[q] != kErrIgnore) fCountMask |= (1u << b);
+		}
+		ResetCounts();
+	}
+
+	std::string fName;
+	int fBitErr[32];			// error type of each bit of the packed code (-1: none)
+	VetoErrorAction fAction[nErrs];
+	uint32_t fFatalMask, fCountMask;
+	std::atomic<long> fCount[nErrs];
+	std::atomic<long> fSkipped;
+
+	VetoErrorPolicy& operator=(const VetoErrorPolicy&);
+};
+
+#endif
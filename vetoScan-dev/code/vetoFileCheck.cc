@@ -5,75 +5,199 @@
 
 	Macro to check a list of run numbers and determine if the built files exist.
 	Will also check if files have been blinded and aren't readable.
+
+	The check is done in two passes, both spread over the -j threads:
+	1. Cheap probes: stat, read permission (blinded files), the "root" magic
+	   and the end-of-file pointer in the header (truncated files).
+	2. Only for files that pass, and not with `checkQuick`: open the file and check
+	   the trees, their entry counts, and the run duration.
+	Writes a status table to ./output/FileCheck_<Name>.txt.
+
+	The data directory is $MJDDATADIR if it's set, otherwise the PDSF location.
 */
 
+#include <unistd.h>
+#include <sys/stat.h>
+#include "TTree.h"
 #include "vetoScan.hh"
+#include "code/RunSet.hh"
 
 using namespace std;
 
-void vetoFileCheck(string Input, string partNum, bool checkBuilt, bool checkGat, bool checkGDS)
+struct FileStatus {
+	long size;
+	string status;	// OK, MISSING, BLINDED, BADMAGIC, TRUNCATED, ZOMBIE, NOTREE, EMPTY
+};
+
+struct RunFileCheck {
+	int run;
+	FileStatus built, gat;
+	long mgEntries, vetoEntries, gatEntries;
+	double duration;
+	RunFileCheck() : run(0), mgEntries(-1), vetoEntries(-1), gatEntries(-1), duration(-1) {}
+};
+
+// stat the file and look at its header without going through ROOT
+static FileStatus ProbeFile(string file)
+{
+	FileStatus fs;
+	fs.size = -1;
+	struct stat st;
+	if (stat(file.c_str(),&st) != 0) { fs.status = "MISSING"; return fs; }
+	fs.size = (long)st.st_size;
+	if (access(file.c_str(),R_OK) != 0) { fs.status = "BLINDED"; return fs; }
+
+	unsigned char h[20] = {0};
+	FILE *f = fopen(file.c_str(),"rb");
+	if (f == NULL) { fs.status = "BLINDED"; return fs; }
+	size_t n = fread(h,1,sizeof(h),f);
+	fclose(f);
+	if (n < 16 || memcmp(h,"root",4) != 0) { fs.status = "BADMAGIC"; return fs; }
+
+	// header: "root", version, fBEGIN, fEND (64-bit for big files, version > 1000000)
+	// all big-endian.  If fEND is past the end of the file, it was cut short.
+	long version = ((long)h[4]<<24) | ((long)h[5]<<16) | ((long)h[6]<<8) | (long)h[7];
+	long end = 0;
+	if (version > 1000000 && n >= 20) {
+		for (int i = 12; i < 20; i++) end = (end<<8) | h[i];
+	}
+	else end = ((long)h[12]<<24) | ((long)h[13]<<16) | ((long)h[14]<<8) | (long)h[15];
+	if (end > fs.size) { fs.status = "TRUNCATED"; return fs; }
+
+	fs.status = "OK";
+	return fs;
+}
+
+// entries in a tree, or -1 if it isn't there
+static long TreeEntries(TFile *f, const char *name)
+{
+	TTree *t = (TTree*)f->Get(name);
+	if (t == NULL) return -1;
+	return (long)t->GetEntries();
+}
+
+void vetoFileCheck(string Input, string partNum, bool checkBuilt, bool checkGat, bool checkGDS, bool openFiles)
 {
 	// Input a list of run numbers
-	ifstream InputList(Input.c_str());
-	if(!InputList.good()) {
-    	cout << "Couldn't open " << Input << endl;
-    	return;
-    }
+	RunSet runs;
+	if (!runs.Load(Input)) return;
+	if (partNum == "") {
+		cout << "Warning!  Empty part number!" << endl;
+		return;
+	}
+	string Name = Input;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
 
-	int run;
-	char GATFile[200];
-	char BuiltFile[200];
-	char path[200];
-	double durationTotal = 0;
-	while(!InputList.eof())
-	{
-		InputList >> run;
+	string path = "/global/project/projectdirs/majorana/data/mjd/surfmjd/data";
+	if (getenv("MJDDATADIR") != NULL) path = getenv("MJDDATADIR");
+
+	vector<RunFileCheck> checks;
+	for (int run : runs) {
+		RunFileCheck c;
+		c.run = run;
+		checks.push_back(c);
+	}
+	int nRuns = (int)checks.size();
+	printf("Checking %i runs in %s with %i threads.\n",nRuns,path.c_str(),min(nRuns,GetNumThreads()));
 
-		if (partNum != "") {
-			sprintf(path,"/global/project/projectdirs/majorana/data/mjd/surfmjd/data");
-			sprintf(BuiltFile,"%s/built/%s/OR_run%u.root",path,partNum.c_str(),run); 
-			sprintf(GATFile,"%s/gatified/%s/mjd_run%u.root",path,partNum.c_str(),run); 
+	char BuiltFile[300];
+	char GATFile[300];
+	auto builtName = [&](int r) { sprintf(BuiltFile,"%s/built/%s/OR_run%u.root",path.c_str(),partNum.c_str(),r); return string(BuiltFile); };
+	auto gatName = [&](int r) { sprintf(GATFile,"%s/gatified/%s/mjd_run%u.root",path.c_str(),partNum.c_str(),r); return string(GATFile); };
+	vector<string> builtFiles(nRuns), gatFiles(nRuns);
+	for (int i = 0; i < nRuns; i++) {
+		builtFiles[i] = builtName(checks[i].run);
+		gatFiles[i] = gatName(checks[i].run);
+	}
+
+	// 1. cheap probes
+	RunParallel(nRuns, [&](int i) {
+		if (checkBuilt) checks[i].built = ProbeFile(builtFiles[i]);
+		if (checkGat) checks[i].gat = ProbeFile(gatFiles[i]);
+	});
+
+	// 2. open the files that passed.  Check the trees and the duration.
+	if (openFiles) RunParallel(nRuns, [&](int i) {
+		RunFileCheck &c = checks[i];
+		if (checkBuilt && c.built.status == "OK")
+		{
+			TFile *f = TFile::Open(builtFiles[i].c_str());
+			if (f == NULL || f->IsZombie()) c.built.status = "ZOMBIE";
+			else {
+				c.mgEntries = TreeEntries(f,"MGTree");
+				c.vetoEntries = TreeEntries(f,"VetoTree");
+				if (c.mgEntries < 0) c.built.status = "NOTREE";
+				else if (c.mgEntries == 0) c.built.status = "EMPTY";
+				else {
+					// Check also that the duration is not corrupted!
+					TTree *MGTree = (TTree*)f->Get("MGTree");
+					MJTRun *MyRun = new MJTRun();
+					MGTree->SetBranchAddress("run",&MyRun);
+					MGTree->GetEntry(0);
+					c.duration = MyRun->GetStopTime() - MyRun->GetStartTime();
+					MGTree->ResetBranchAddresses();
+					delete MyRun;
+				}
+			}
+			if (f != NULL) f->Close();
+			delete f;
 		}
-		else cout << "Warning!  Empty part number!" << endl;
+		if (checkGat && c.gat.status == "OK")
+		{
+			TFile *f = TFile::Open(gatFiles[i].c_str());
+			if (f == NULL || f->IsZombie()) c.gat.status = "ZOMBIE";
+			else {
+				c.gatEntries = TreeEntries(f,"mjdTree");
+				if (c.gatEntries < 0) c.gat.status = "NOTREE";
+			}
+			if (f != NULL) f->Close();
+			delete f;
+		}
+	});
 
-		if (checkBuilt && partNum != "") {
-			TFile *f1 = new TFile(BuiltFile);
-    		f1->Close();
-    		delete f1;
-    	}
-    	if (checkGat && partNum != "") {
-    		TFile *f2 = new TFile(GATFile);
-    		f2->Close();
-    		delete f2;
-    	}
-    	if (checkGDS){
-    		GATDataSet *ds = new GATDataSet(run);
-    		cout << ds->GetRunTime() << endl;
-    		// TChain *b = ds->GetBuiltChain();
-    		// cout << "Built file: " << b->GetEntries() << " entries\n";
-    		// TChain *g = ds->GetGatifiedChain();
-    		// cout << "Gatified file: " << g->GetEntries()<< " entries\n";
+	// GATDataSet isn't thread-safe, so this one stays serial.
+	if (checkGDS) {
+		for (auto &c : checks) {
+    		GATDataSet *ds = new GATDataSet(c.run);
+    		cout << c.run << " " << ds->GetRunTime() << endl;
     		delete ds;
     	}
+	}
 
-		// Check also that the duration is not corrupted!
-		if (checkBuilt) {
-			Float_t duration = 0;
-			TChain *MGTree = new TChain("MGTree");
-			MGTree->AddFile(BuiltFile);
-			MJTRun *MyRun = new MJTRun();
-			MGTree->SetBranchAddress("run",&MyRun);
-			MGTree->GetEntry(0);
-			duration = MyRun->GetStopTime() - MyRun->GetStartTime();
-			//if (duration >= 3595 && duration <= 3605) cout << run << endl;
-			if (duration <= 0 || duration > 4000 ) {
-				printf("\nRun %i has duration %.0f, skipping file!\n\n",run,duration);
-				continue;
+	// status table
+	string outName = "./output/FileCheck_"+Name+".txt";
+	ofstream Table(outName.c_str());
+	Table << "# run  built  gatified  builtMB  MGTree  VetoTree  mjdTree  duration\n";
+	double durationTotal = 0;
+	int nBad = 0;
+	char line[300];
+	for (auto &c : checks)
+	{
+		string note = "";
+		bool bad = false;
+		if (checkBuilt && c.built.status != "OK") bad = true;
+		if (checkGat && c.gat.status != "OK") bad = true;
+		if (checkBuilt && c.built.status == "OK" && openFiles) {
+			if (c.duration <= 0 || c.duration > 4000) {
+				printf("\nRun %i has duration %.0f, skipping file!\n\n",c.run,c.duration);
+				note = "  BADDURATION";
+				bad = true;
 			}
-			durationTotal+=duration;
-			delete MGTree;
-			delete MyRun;
+			else durationTotal += c.duration;
+		}
+		if (checkBuilt && checkGat && c.mgEntries >= 0 && c.gatEntries >= 0 && c.mgEntries != c.gatEntries)
+			note += "  ENTRYMISMATCH";
+		sprintf(line,"%-8i %-9s %-9s %8.1f %8li %8li %8li %6.0f%s",c.run,
+			checkBuilt ? c.built.status.c_str() : "-", checkGat ? c.gat.status.c_str() : "-",
+			c.built.size/1048576., c.mgEntries, c.vetoEntries, c.gatEntries, c.duration, note.c_str());
+		Table << line << endl;
+		if (bad) {
+			nBad++;
+			cout << line << endl;
 		}
-    }
-	cout << "Total duration: " << durationTotal << " seconds." << endl; 
+	}
+	Table.close();
+	printf("%i of %i runs have problems.  Status table: %s\n",nBad,nRuns,outName.c_str());
+	cout << "Total duration: " << durationTotal << " seconds." << endl;
 }
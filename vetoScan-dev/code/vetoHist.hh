@@ -0,0 +1,203 @@
+// VetoHist: fixed-binning integer-count histograms for the fill-heavy loops.
+// Used by vetoPerformance, vetoThreshFinder, vetoCheck and builtVetoCal.
+//
+// Same binning as TH1 (bin 0 = underflow, nBins+1 = overflow, low edge
+// inclusive, and the same arithmetic, so edges agree; scripts/checkVetoHist.C
+// checks it), but with no virtual calls, and FillN finds a batch of bins in
+// one branch-free loop before counting them.  VetoHistSet holds one histogram
+// per panel, and buffers events so each panel is filled a batch at a time.
+// The statistics (entries, sum x, sum x^2) are kept the same way TH1 keeps
+// them, so a histogram converted with CopyTo/ToTH1D has the same contents,
+// mean and RMS as one filled directly.
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef VETOHIST_HH
+#define VETOHIST_HH
+
+#include <vector>
+#include <cstdint>
+#include "TH1.h"
+#include "TH1D.h"
+
+class VetoHist
+{
+	public:
+
+	VetoHist(int nBins = 1, double lo = 0, double hi = 1)
+	: fN(nBins), fLo(lo), fHi(hi), fWidth(hi-lo), fCounts(nBins+2,0)
+	{ Reset(); }
+
+	int GetNbins() const { return fN; }
+	double GetLow() const { return fLo; }
+	double GetHigh() const { return fHi; }
+	long GetEntries() const { return fEntries; }
+	uint32_t GetBinContent(int bin) const { return fCounts[bin]; }
+
+	// TH1::FindBin for a uniform axis.  Same arithmetic as TAxis::FindBin,
+	// so values on or next to a bin edge land in the same bin, but with
+	// selects instead of branches (x < lo: 0, x >= hi or NaN: nBins+1).
+	int FindBin(double x) const { return Bin(x,fN,fLo,fHi,fWidth); }
+
+	void Fill(double x)
+	{
+		int b = FindBin(x);
+		fCounts[b]++;
+		fEntries++;
+		if (b > 0 && b <= fN) { fSumw++; fSumx += x; fSumx2 += x*x; }
+	}
+
+	// Batched fill: compute a chunk of bins first (a loop the compiler can
+	// vectorize), then increment.  The statistics are added in order, so
+	// they come out the same as n calls to Fill.
+	template<class T> void FillN(int n, const T *x)
+	{
+		const int chunk = 256;
+		int bins[chunk];
+		const double nb = fN, lo = fLo, hi = fHi, w = fWidth;	// (copies, so the loop doesn't reload them)
+		for (int k = 0; k < n; k += chunk)
+		{
+			int m = (n - k < chunk) ? n - k : chunk;
+			const T *xk = x + k;
+			for (int i = 0; i < m; i++) bins[i] = Bin((double)xk[i],nb,lo,hi,w);
+			for (int i = 0; i < m; i++) {
+				fCounts[bins[i]]++;
+				int in = (bins[i] > 0) & (bins[i] <= fN);
+				double v = in ? (double)xk[i] : 0;	// adding 0 leaves the sums as they are
+				fSumw += in; fSumx += v; fSumx2 += v*v;
+			}
+		}
+		fEntries += n;
+	}
+
+	// Add counts from a histogram with the same binning.
+	void Add(const VetoHist &o)
+	{
+		for (int i = 0; i < fN+2; i++) fCounts[i] += o.fCounts[i];
+		fEntries += o.fEntries;
+		fSumw += o.fSumw;
+		fSumx += o.fSumx;
+		fSumx2 += o.fSumx2;
+	}
+
+	// Add counts from a TH1 with the same binning (e.g. read back from a file).
+	void Add(const TH1 *h)
+	{
+		if (h == NULL || h->GetNbinsX() != fN) return;
+		for (int i = 0; i < fN+2; i++) fCounts[i] += (uint32_t)(h->GetBinContent(i) + 0.5);
+		double st[4];
+		h->GetStats(st);
+		fEntries += (long)h->GetEntries();
+		fSumw += st[0];
+		fSumx += st[2];
+		fSumx2 += st[3];
+	}
+
+	void Reset()
+	{
+		for (int i = 0; i < fN+2; i++) fCounts[i] = 0;
+		fEntries = 0;
+		fSumw = fSumx = fSumx2 = 0;
+	}
+
+	// Put the contents into an existing TH1 with the same binning (replacing what's there).
+	void CopyTo(TH1 *h) const
+	{
+		if (h == NULL || h->GetNbinsX() != fN) return;
+		h->Reset();
+		for (int i = 0; i < fN+2; i++) h->SetBinContent(i,fCounts[i]);
+		double st[4] = {fSumw, fSumw, fSumx, fSumx2};
+		h->PutStats(st);
+		h->SetEntries(fEntries);
+	}
+
+	// Make a TH1D, not attached to any file.  Caller owns it.
+	TH1D* ToTH1D(const char *name, const char *title = "") const
+	{
+		TH1D *h = new TH1D(name,title,fN,fLo,fHi);
+		h->SetDirectory(0);
+		CopyTo(h);
+		return h;
+	}
+
+	private:
+
+	// 1 + int(n*(x-lo)/w) in range, else 0 or n+1, without branches: x is
+	// clamped to the axis, and the result to -1 below it and n above it (or
+	// NaN, like TAxis), with selects and min/max, then converted to int once.
+	static int Bin(double x, double n, double lo, double hi, double w)
+	{
+		double xc = (x > lo) ? x : lo;
+		xc = (xc < hi) ? xc : hi;
+		double t = n*(xc-lo)/w;
+		double above = (x < hi) ? -1 : n;
+		double below = (x < lo) ? -1 : n;
+		t = (t > above) ? t : above;
+		t = (t < below) ? t : below;
+		return 1 + (int)t;
+	}
+
+	int fN;
+	double fLo, fHi, fWidth;
+	std::vector<uint32_t> fCounts;
+	long fEntries;
+	double fSumw, fSumx, fSumx2;	// in-range only, like TH1
+};
+
+// One histogram per panel, all with the same binning.
+// Push() buffers an event's values (one per panel), and every kBuffer events
+// each panel's values are filled at once with FillN.  Call Flush() before
+// reading, copying or adding the histograms.
+class VetoHistSet
+{
+	public:
+
+	static const int kBuffer = 1024;
+
+	VetoHistSet(int nHists = 32, int nBins = 1, double lo = 0, double hi = 1)
+	: fHists(nHists, VetoHist(nBins,lo,hi)), fBufN(0) {}
+
+	int GetSize() const { return (int)fHists.size(); }
+	VetoHist& operator[](int i) { return fHists[i]; }
+	const VetoHist& operator[](int i) const { return fHists[i]; }
+
+	// Fill histogram i with x[i], for every i.
+	template<class T> void FillAll(const T *x)
+	{
+		for (int i = 0; i < (int)fHists.size(); i++) fHists[i].Fill((double)x[i]);
+	}
+
+	// FillAll, buffered.
+	template<class T> void Push(const T *x)
+	{
+		if (fBuf.empty()) fBuf.resize(fHists.size()*kBuffer);
+		for (int i = 0; i < (int)fHists.size(); i++) fBuf[i*kBuffer + fBufN] = (double)x[i];
+		if (++fBufN == kBuffer) Flush();
+	}
+
+	void Flush()
+	{
+		if (fBufN == 0) return;
+		for (int i = 0; i < (int)fHists.size(); i++) fHists[i].FillN(fBufN,&fBuf[i*kBuffer]);
+		fBufN = 0;
+	}
+
+	void Add(const VetoHistSet &o)
+	{
+		for (int i = 0; i < (int)fHists.size() && i < o.GetSize(); i++) fHists[i].Add(o.fHists[i]);
+	}
+
+	void Reset()
+	{
+		for (int i = 0; i < (int)fHists.size(); i++) fHists[i].Reset();
+		fBufN = 0;
+	}
+
+	private:
+
+	std::vector<VetoHist> fHists;
+	std::vector<double> fBuf;	// kBuffer values per histogram
+	int fBufN;					// events in the buffer
+};
+
+#endif
@@ -0,0 +1,83 @@
+// Veto hit lists for the event display.
+// Written by muDisplayList (vetoScan -D), read by scripts/vetoDisplay32.C.
+//
+// Text format, one candidate per line:
+//   run entry SEC xTime qdc0 ... qdc31
+// Binary format: an 8-byte header ("VHL" + version byte + panel count),
+// then fixed-size little-endian records (VetoHitRecord).
+// QDC values under the software threshold are written as 0.
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef VETOHITLIST_HH
+#define VETOHITLIST_HH
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+struct VetoHitRecord {
+	int32_t run;
+	int32_t entry;
+	int64_t SEC;
+	double xTime;
+	uint16_t qdc[32];
+};	// 88 bytes, no padding
+
+static const char VetoHitListMagic[8] = {'V','H','L',1,32,0,0,0};
+
+// Binary lists end in ".bin", everything else is text.
+inline bool IsBinaryHitList(std::string file)
+{
+	return file.size() > 4 && file.substr(file.size()-4) == ".bin";
+}
+
+inline bool WriteHitListHeader(FILE *f)
+{
+	return fwrite(VetoHitListMagic,1,sizeof(VetoHitListMagic),f) == sizeof(VetoHitListMagic);
+}
+
+// Read a whole hit list (either format).  Returns false if it can't be read.
+inline bool ReadHitList(std::string file, std::vector<VetoHitRecord> &hits)
+{
+	hits.clear();
+	FILE *f = fopen(file.c_str(),"rb");
+	if (f == NULL) return false;
+	if (IsBinaryHitList(file))
+	{
+		char magic[8];
+		if (fread(magic,1,8,f) != 8 || memcmp(magic,VetoHitListMagic,8) != 0) {
+			fclose(f);
+			return false;
+		}
+		VetoHitRecord buf[1024];
+		size_t n;
+		while ((n = fread(buf,sizeof(VetoHitRecord),1024,f)) > 0) hits.insert(hits.end(),buf,buf+n);
+	}
+	else
+	{
+		char line[1000];
+		while (fgets(line,sizeof(line),f) != NULL)
+		{
+			VetoHitRecord h;
+			long long sec = 0;
+			int pos = 0, len = 0;
+			if (sscanf(line,"%d %d %lld %lf%n",&h.run,&h.entry,&sec,&h.xTime,&pos) != 4) continue;
+			h.SEC = sec;
+			bool ok = true;
+			for (int j = 0; j < 32 && ok; j++) {
+				int q = 0;
+				ok = (sscanf(line+pos,"%d%n",&q,&len) == 1);
+				h.qdc[j] = (uint16_t)q;
+				pos += len;
+			}
+			if (ok) hits.push_back(h);
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+#endif
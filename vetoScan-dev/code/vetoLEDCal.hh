@@ -0,0 +1,201 @@
+// LED peak calibration store.
+// Written by vetoPerformance (vetoScan -p), read by scripts/PlotLEDPeakDrift.C.
+//
+// During the scan, every panel's QDC from LED-tagged entries (multiplicity > 20,
+// over the software threshold) goes into a per-run spectrum, and the LED peak
+// is fit with FitLEDPeak.  The fit is a Gaussian, done without TF1/Minuit:
+// the seed comes from the peak's half-max width and the moments around it, and
+// a few Gauss-Newton steps then minimize the binned chi-square (weights 1/n)
+// within +/- 2.5 sigma of the seed.  Errors come from the curvature matrix.
+//
+// Store format, one line per run and panel, in scan order:
+//   run start panel counts mean meanErr sigma sigmaErr chi2NDF status
+// start is the run's unix start time.  status 0 is a good fit, 1 is too few
+// LED counts, 2 means the fit didn't converge (mean and sigma are the seed).
+//
+// Clint Wiseman, USC/Majorana
+
+#ifndef VETOLEDCAL_HH
+#define VETOLEDCAL_HH
+
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "vetoHist.hh"
+
+struct LEDPeak {
+	int run;
+	long start;
+	int panel;
+	long counts;
+	double mean, meanErr;
+	double sigma, sigmaErr;
+	double chi2NDF;
+	int status;
+	LEDPeak() : run(0), start(0), panel(0), counts(0), mean(0), meanErr(0), sigma(0), sigmaErr(0), chi2NDF(0), status(1) {}
+};
+
+// Solve the symmetric 3x3 system a x = b, and put the inverse of a in inv.
+inline bool SolveLEDFit3(const double a[3][3], const double b[3], double x[3], double inv[3][3])
+{
+	double det = a[0][0]*(a[1][1]*a[2][2]-a[1][2]*a[2][1])
+		- a[0][1]*(a[1][0]*a[2][2]-a[1][2]*a[2][0])
+		+ a[0][2]*(a[1][0]*a[2][1]-a[1][1]*a[2][0]);
+	if (!(fabs(det) > 1e-300)) return false;
+	inv[0][0] = (a[1][1]*a[2][2]-a[1][2]*a[2][1])/det;
+	inv[0][1] = (a[0][2]*a[2][1]-a[0][1]*a[2][2])/det;
+	inv[0][2] = (a[0][1]*a[1][2]-a[0][2]*a[1][1])/det;
+	inv[1][0] = (a[1][2]*a[2][0]-a[1][0]*a[2][2])/det;
+	inv[1][1] = (a[0][0]*a[2][2]-a[0][2]*a[2][0])/det;
+	inv[1][2] = (a[0][2]*a[1][0]-a[0][0]*a[1][2])/det;
+	inv[2][0] = (a[1][0]*a[2][1]-a[1][1]*a[2][0])/det;
+	inv[2][1] = (a[0][1]*a[2][0]-a[0][0]*a[2][1])/det;
+	inv[2][2] = (a[0][0]*a[1][1]-a[0][1]*a[1][0])/det;
+	for (int i = 0; i < 3; i++) x[i] = inv[i][0]*b[0] + inv[i][1]*b[1] + inv[i][2]*b[2];
+	return true;
+}
+
+// Fit the highest peak in h.  Fills mean, sigma, errors, chi2NDF, counts and status.
+inline int FitLEDPeak(const VetoHist &h, LEDPeak &pk, long minCounts = 20)
+{
+	int n = h.GetNbins();
+	double lo = h.GetLow();
+	double w = (h.GetHigh() - lo)/n;
+	pk.counts = 0;
+	pk.mean = pk.meanErr = pk.sigma = pk.sigmaErr = pk.chi2NDF = 0;
+	pk.status = 1;
+
+	// seed: half-max width of the peak (on a 5-bin running sum, so a
+	// sparse spectrum still has one), then the moments within +/- 2 sigma
+	std::vector<double> sm(n+2,0);
+	for (int i = 1; i <= n; i++) {
+		pk.counts += h.GetBinContent(i);
+		for (int k = std::max(1,i-2); k <= std::min(n,i+2); k++) sm[i] += h.GetBinContent(k);
+	}
+	if (pk.counts < minCounts) return pk.status;
+	int maxBin = 1;
+	for (int i = 1; i <= n; i++) if (sm[i] > sm[maxBin]) maxBin = i;
+	double yMax = sm[maxBin]/5;
+	int left = maxBin, right = maxBin;
+	while (left > 1 && sm[left-1] > sm[maxBin]/2) left--;
+	while (right < n && sm[right+1] > sm[maxBin]/2) right++;
+	double sigma = std::max(((right - left + 1) - 4) * w / 2.3548, w);
+	double mean = lo + (maxBin - 0.5) * w;
+	for (int iter = 0; iter < 2; iter++)
+	{
+		int b0 = std::max(1, (int)((mean - 2*sigma - lo)/w) + 1);
+		int b1 = std::min(n, (int)((mean + 2*sigma - lo)/w) + 1);
+		double s0 = 0, s1 = 0, s2 = 0;
+		for (int i = b0; i <= b1; i++) {
+			double x = lo + (i - 0.5) * w, y = h.GetBinContent(i);
+			s0 += y; s1 += y*x; s2 += y*x*x;
+		}
+		if (s0 <= 0) break;
+		mean = s1/s0;
+		double rms = sqrt(std::max(s2/s0 - mean*mean, 0.));
+		sigma = std::max(rms/0.8796, w);	// rms of a Gaussian cut at +/- 2 sigma
+	}
+	pk.mean = mean;
+	pk.sigma = sigma;
+	pk.status = 2;
+
+	// Gauss-Newton on y = A exp(-(x-mean)^2 / 2 sigma^2)
+	int b0 = std::max(1, (int)((mean - 2.5*sigma - lo)/w) + 1);
+	int b1 = std::min(n, (int)((mean + 2.5*sigma - lo)/w) + 1);
+	int ndf = (b1 - b0 + 1) - 3;
+	if (ndf < 1) return pk.status;
+	double p[3] = {yMax, mean, sigma};
+	double cov[3][3];
+	auto chi2 = [&](const double *q) {
+		double c = 0;
+		for (int i = b0; i <= b1; i++) {
+			double x = lo + (i - 0.5) * w, y = h.GetBinContent(i);
+			double d = (x - q[1])/q[2];
+			double r = y - q[0]*exp(-0.5*d*d);
+			c += r*r / std::max(y, 1.);
+		}
+		return c;
+	};
+	double c2 = chi2(p);
+	bool converged = false;
+	for (int iter = 0; iter < 20 && !converged; iter++)
+	{
+		double a[3][3] = {{0}}, b[3] = {0}, step[3];
+		for (int i = b0; i <= b1; i++) {
+			double x = lo + (i - 0.5) * w, y = h.GetBinContent(i);
+			double d = (x - p[1])/p[2];
+			double g = exp(-0.5*d*d);
+			double j[3] = {g, p[0]*g*d/p[2], p[0]*g*d*d/p[2]};
+			double wt = 1./std::max(y, 1.);
+			double r = y - p[0]*g;
+			for (int k = 0; k < 3; k++) {
+				b[k] += wt*j[k]*r;
+				for (int l = 0; l < 3; l++) a[k][l] += wt*j[k]*j[l];
+			}
+		}
+		if (!SolveLEDFit3(a,b,step,cov)) return pk.status;
+
+		// halve the step until chi-square doesn't go up
+		double q[3];
+		double lambda = 1, c2new = c2;
+		for (int t = 0; t < 10; t++, lambda /= 2) {
+			for (int k = 0; k < 3; k++) q[k] = p[k] + lambda*step[k];
+			if (q[0] <= 0 || q[2] <= 0) continue;
+			c2new = chi2(q);
+			if (c2new <= c2) break;
+		}
+		if (q[0] <= 0 || q[2] <= 0 || c2new > c2) break;
+		converged = (fabs(q[1] - p[1]) < 1e-4 * q[2] && fabs(q[2] - p[2]) < 1e-4 * q[2]);
+		for (int k = 0; k < 3; k++) p[k] = q[k];
+		c2 = c2new;
+	}
+	if (!converged) return pk.status;
+
+	pk.mean = p[1];
+	pk.sigma = p[2];
+	pk.meanErr = sqrt(std::max(cov[1][1], 0.));
+	pk.sigmaErr = sqrt(std::max(cov[2][2], 0.));
+	pk.chi2NDF = c2 / ndf;
+	pk.status = 0;
+	return pk.status;
+}
+
+inline void WriteLEDCalHeader(FILE *f)
+{
+	fprintf(f,"# run start panel counts mean meanErr sigma sigmaErr chi2NDF status\n");
+}
+
+inline void WriteLEDPeak(FILE *f, const LEDPeak &pk)
+{
+	fprintf(f,"%i %li %i %li %.2f %.2f %.2f %.2f %.3f %i\n",pk.run,pk.start,pk.panel,pk.counts,
+		pk.mean,pk.meanErr,pk.sigma,pk.sigmaErr,pk.chi2NDF,pk.status);
+}
+
+// Read a calibration store, sorted by start time (then run, then panel).
+// Returns false if it can't be opened.
+inline bool ReadLEDCal(std::string file, std::vector<LEDPeak> &peaks)
+{
+	peaks.clear();
+	FILE *f = fopen(file.c_str(),"r");
+	if (f == NULL) return false;
+	char line[500];
+	while (fgets(line,sizeof(line),f) != NULL)
+	{
+		if (line[0] == '#') continue;
+		LEDPeak pk;
+		if (sscanf(line,"%i %li %i %li %lf %lf %lf %lf %lf %i",&pk.run,&pk.start,&pk.panel,&pk.counts,
+			&pk.mean,&pk.meanErr,&pk.sigma,&pk.sigmaErr,&pk.chi2NDF,&pk.status) == 10)
+			peaks.push_back(pk);
+	}
+	fclose(f);
+	std::stable_sort(peaks.begin(),peaks.end(),[](const LEDPeak &a, const LEDPeak &b) {
+		if (a.start != b.start) return a.start < b.start;
+		if (a.run != b.run) return a.run < b.run;
+		return a.panel < b.panel;
+	});
+	return true;
+}
+
+#endif
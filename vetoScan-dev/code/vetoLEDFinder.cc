@@ -2,6 +2,7 @@
 // C. Wiseman.
 
 #include "vetoScan.hh"
+#include "code/RunSet.hh"
 
 void vetoLEDFinder(string file) 
 {
@@ -11,15 +12,13 @@ void vetoLEDFinder(string file)
 	// int LEDMultipThreshold = 10;  // "multipThreshold" = "highestMultip" - "LEDMultipThreshold"
 	// int LEDSimpleThreshold = 5;   // used when LED frequency measurement is bad.
 
-	int run;
 	long start;
 	long stop;
 	int duration;
-	ifstream InputList;
-  	InputList.open(file.c_str());
-	while(!InputList.eof())
+	RunSet runs;
+	if (!runs.Load(file)) return;
+	for (int run : runs)
 	{
-		InputList >> run;
 		GATDataSet ds(run);
 		start = GetStartUnixTime(ds);
 		stop = GetStopUnixTime(ds);
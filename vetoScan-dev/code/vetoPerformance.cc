@@ -10,112 +10,846 @@ entry 12  |  "good"  |  SEC: 12  |  QEC: 12
 ! SEC/QEC change found > +1 difference. 
 */
 
+#include <unistd.h>
+#include <cstdarg>
+#include <mutex>
+#include <algorithm>
+#include "TSystem.h"
+#include "TH2D.h"
+#include "TList.h"
 #include "vetoScan.hh"
+#include "code/RunWatcher.hh"
+#include "code/VetoSource.hh"
+#include "code/RunSet.hh"
+#include "code/vetoHist.hh"
+#include "code/vetoLEDCal.hh"
+#include "code/vetoErrorPolicy.hh"
+#include "code/RunSeries.hh"
+#include "code/VetoSnapshot.hh"
+#include "code/VetoWriter.hh"
+#include "code/RunState.hh"
+#include "code/CounterCheck.hh"
 
 using namespace std;
 
-void vetoPerformance(string Input, int *thresh, bool runBreakdowns) 
+// An entry with errors, kept for the "most errors" printout.
+// a < b: a has more errors, or the same number earlier in the run list.
+struct VPBadEntry
 {
-	// input a list of run numbers
-	ifstream InputList(Input.c_str());
-	if(!InputList.good()) {
-    	cout << "Couldn't open " << Input << endl;
-    	return;
-    }
+	int run, entry, errors;
+	double time;
+	bool operator<(const VPBadEntry &o) const {
+		if (errors != o.errors) return errors > o.errors;
+		if (run != o.run) return run < o.run;
+		return entry < o.entry;
+	}
+};
+
+// Everything vetoPerformance adds up over runs.
+// Each run is scanned into its own accumulator, and the accumulators are merged
+// into the totals in run-list order, so runs can be scanned in parallel (-j)
+// and the output is the same as a serial scan.
+struct VPAccumulator
+{
+	static const int nErrs = 18;
+	int globalErrorCount[nErrs];
+	int globalRunsWithErrors[nErrs];
+	int globalRunsWithErrorsAtBeginning[nErrs];
+	int globalErrorAtBeginningCount[nErrs];
+	int SJSBCCount;
+	vector<double> runs;
+	vector<double> freqs;
+	static const int nWorst = 20;
+	vector<VPBadEntry> worst;	// heap of the nWorst entries with the most errors
+	long totEntries;
+	long totDuration;
+	int totHighDT;
+	int totHighDTwBTS;	//number of high DT events with bad scaler time stamps
+	int totLED;
+	int totnonLED;
+	int totGoodEntries;
+	int SECResetCount;
+	int QECReset01count;
+	int QECReset02count;
+	int QEC1ChangeCount;
+	int QEC2ChangeCount;
+	int SECChangeCount;
+	TH1D *TotalMultip;
+	TH1D *TotalEnergy;
+	TH1D *deltaT;
+	TH1D *TotalEnergyNoLED;
+	TH1D *QDC_over_Multip;
+	VetoHistSet hRawQDC;	// converted to TH1D when written
+	TH1D *TimestampBadEntry;
+	TH1D *ScalerJumpTime;
+	TH2D *ErrorCountVsTime;
+	TH2D *ErrorCountVsEntryNum;
+
+	// The totals are booked in the output file.  Per-run accumulators
+	// are kept out of it (detached), so they don't collide with the totals.
+	VPAccumulator(bool detached = false) : hRawQDC(32,4200,0,4200)
+	{
+		for (int i = 0; i < nErrs; i++) {
+			globalErrorCount[i] = 0;
+			globalRunsWithErrors[i] = 0;
+			globalRunsWithErrorsAtBeginning[i] = 0;
+			globalErrorAtBeginningCount[i] = 0;
+		}
+		SJSBCCount = 0;
+		totEntries = 0;
+		totDuration = 0;
+		totHighDT = 0;
+		totHighDTwBTS = 0;
+		totLED = 0;
+		totnonLED = 0;
+		totGoodEntries = 0;
+		SECResetCount = 0;
+		QECReset01count = 0;
+		QECReset02count = 0;
+		QEC1ChangeCount = 0;
+		QEC2ChangeCount = 0;
+		SECChangeCount = 0;
+
+		TotalMultip = new TH1D("TotalMultip","Events over threshold",33,0,33);
+		TotalMultip->GetXaxis()->SetTitle("number of panels hit");
+
+		TotalEnergy = new TH1D("TotalEnergy","Total QDC from events",100,0,60000);
+		TotalEnergy->GetXaxis()->SetTitle("energy (QDC)");
+
+		deltaT = new TH1D("deltaT","Time between successive entries",200,0,20);
+		deltaT->GetXaxis()->SetTitle("seconds");
+
+		TotalEnergyNoLED = new TH1D("TotalEnergyNoLED","Total QDC from non-LED events",100,0,60000);
+		TotalEnergyNoLED->GetXaxis()->SetTitle("energy (QDC)");
+
+		QDC_over_Multip = new TH1D("QDC_over_Multip","Average QDC from events",1000,0,5000);
+		QDC_over_Multip->GetXaxis()->SetTitle("Average energy (QDC)");
+
+		// where in the runs the errors are (time and entry number from the start of each run).
+		// The x axes start at an hour-long run and double whenever a longer or bigger
+		// run comes along, so nothing goes into the overflow (see MergeRunHist).
+		TimestampBadEntry = new TH1D("TimestampBadEntry"," Timestamp of entries with > 2 errors",3650,0,3650);
+		TimestampBadEntry->GetXaxis()->SetTitle("seconds");
+
+		ScalerJumpTime = new TH1D("ScalerJumpTime","Scaler time of SBC/scaler jumps",3650,0,3650);
+		ScalerJumpTime->GetXaxis()->SetTitle("seconds");
+
+		// 2D histograms.  They replace the old TGraphs "ErrorCountEntryVsTime"
+		// and "ErrorCountEntryVsEntryNum", so they don't take those keys.
+		ErrorCountVsTime = new TH2D("ErrorCountVsTime","Error Count Vs Entry Time",365,0,3650,nErrs,0,nErrs);
+		ErrorCountVsTime->GetXaxis()->SetTitle("Entry Time (sec)");
+		ErrorCountVsTime->GetYaxis()->SetTitle("Error Count");
+
+		ErrorCountVsEntryNum = new TH2D("ErrorCountVsEntryNum","Error Count vs Entry Number",1000,0,100000,nErrs,0,nErrs);
+		ErrorCountVsEntryNum->GetXaxis()->SetTitle("Entry Number");
+		ErrorCountVsEntryNum->GetYaxis()->SetTitle("Error Count");
+
+		TimestampBadEntry->SetCanExtend(TH1::kXaxis);
+		ScalerJumpTime->SetCanExtend(TH1::kXaxis);
+		ErrorCountVsTime->SetCanExtend(TH1::kXaxis);
+		ErrorCountVsEntryNum->SetCanExtend(TH1::kXaxis);
+
+		if (detached) {
+			TotalMultip->SetDirectory(0);
+			TotalEnergy->SetDirectory(0);
+			deltaT->SetDirectory(0);
+			TotalEnergyNoLED->SetDirectory(0);
+			QDC_over_Multip->SetDirectory(0);
+			TimestampBadEntry->SetDirectory(0);
+			ScalerJumpTime->SetDirectory(0);
+			ErrorCountVsTime->SetDirectory(0);
+			ErrorCountVsEntryNum->SetDirectory(0);
+		}
+	}
+
+	~VPAccumulator()
+	{
+		delete TotalMultip;
+		delete TotalEnergy;
+		delete deltaT;
+		delete TotalEnergyNoLED;
+		delete QDC_over_Multip;
+		delete TimestampBadEntry;
+		delete ScalerJumpTime;
+		delete ErrorCountVsTime;
+		delete ErrorCountVsEntryNum;
+	}
+
+	// Add o to h.  Two copies of an extending histogram above can have
+	// different x ranges, which Add won't take, so this goes through Merge
+	// (it rebins to the wider one).
+	static void MergeRunHist(TH1 *h, TH1 *o)
+	{
+		TList l;
+		l.Add(o);
+		h->Merge(&l);
+	}
+
+	// Keep e if it's one of the nWorst entries with the most errors so far.
+	void AddBad(const VPBadEntry &e)
+	{
+		if ((int)worst.size() == nWorst && !(e < worst.front())) return;
+		worst.push_back(e);
+		push_heap(worst.begin(),worst.end());
+		if ((int)worst.size() > nWorst) {
+			pop_heap(worst.begin(),worst.end());
+			worst.pop_back();
+		}
+	}
+
+	// Add another accumulator onto the end of this one.
+	void Merge(const VPAccumulator &o)
+	{
+		for (int i = 0; i < nErrs; i++) {
+			globalErrorCount[i] += o.globalErrorCount[i];
+			globalRunsWithErrors[i] += o.globalRunsWithErrors[i];
+			globalRunsWithErrorsAtBeginning[i] += o.globalRunsWithErrorsAtBeginning[i];
+			globalErrorAtBeginningCount[i] += o.globalErrorAtBeginningCount[i];
+		}
+		SJSBCCount += o.SJSBCCount;
+		runs.insert(runs.end(),o.runs.begin(),o.runs.end());
+		freqs.insert(freqs.end(),o.freqs.begin(),o.freqs.end());
+		for (auto &e : o.worst) AddBad(e);
+		totEntries += o.totEntries;
+		totDuration += o.totDuration;
+		totHighDT += o.totHighDT;
+		totHighDTwBTS += o.totHighDTwBTS;
+		totLED += o.totLED;
+		totnonLED += o.totnonLED;
+		totGoodEntries += o.totGoodEntries;
+		SECResetCount += o.SECResetCount;
+		QECReset01count += o.QECReset01count;
+		QECReset02count += o.QECReset02count;
+		QEC1ChangeCount += o.QEC1ChangeCount;
+		QEC2ChangeCount += o.QEC2ChangeCount;
+		SECChangeCount += o.SECChangeCount;
+		TotalMultip->Add(o.TotalMultip);
+		TotalEnergy->Add(o.TotalEnergy);
+		deltaT->Add(o.deltaT);
+		TotalEnergyNoLED->Add(o.TotalEnergyNoLED);
+		QDC_over_Multip->Add(o.QDC_over_Multip);
+		hRawQDC.Add(o.hRawQDC);
+		MergeRunHist(TimestampBadEntry,o.TimestampBadEntry);
+		MergeRunHist(ScalerJumpTime,o.ScalerJumpTime);
+		MergeRunHist(ErrorCountVsTime,o.ErrorCountVsTime);
+		MergeRunHist(ErrorCountVsEntryNum,o.ErrorCountVsEntryNum);
+	}
+
+	// The counters, in the one order both the checkpoint and ScanTotals use.
+	static const int nCounters = 15 + 4*nErrs;
+	vector<double> PackCounters(int filesScanned) const
+	{
+		vector<double> c = {(double)filesScanned, (double)SJSBCCount, (double)totEntries, (double)totDuration,
+			(double)totHighDT, (double)totHighDTwBTS, (double)totLED, (double)totnonLED, (double)totGoodEntries,
+			(double)SECResetCount, (double)QECReset01count, (double)QECReset02count, (double)QEC1ChangeCount,
+			(double)QEC2ChangeCount, (double)SECChangeCount};
+		for (int i = 0; i < nErrs; i++) c.push_back(globalErrorCount[i]);
+		for (int i = 0; i < nErrs; i++) c.push_back(globalRunsWithErrors[i]);
+		for (int i = 0; i < nErrs; i++) c.push_back(globalRunsWithErrorsAtBeginning[i]);
+		for (int i = 0; i < nErrs; i++) c.push_back(globalErrorAtBeginningCount[i]);
+		return c;
+	}
+
+	// Read PackCounters back from c[k], leaving k after them.  Returns the number of files scanned.
+	int UnpackCounters(const vector<double> &c, int &k)
+	{
+		int filesScanned = (int)c[k++];
+		SJSBCCount = c[k++]; totEntries = c[k++]; totDuration = c[k++];
+		totHighDT = c[k++]; totHighDTwBTS = c[k++]; totLED = c[k++]; totnonLED = c[k++]; totGoodEntries = c[k++];
+		SECResetCount = c[k++]; QECReset01count = c[k++]; QECReset02count = c[k++]; QEC1ChangeCount = c[k++];
+		QEC2ChangeCount = c[k++]; SECChangeCount = c[k++];
+		for (int i = 0; i < nErrs; i++) globalErrorCount[i] = c[k++];
+		for (int i = 0; i < nErrs; i++) globalRunsWithErrors[i] = c[k++];
+		for (int i = 0; i < nErrs; i++) globalRunsWithErrorsAtBeginning[i] = c[k++];
+		for (int i = 0; i < nErrs; i++) globalErrorAtBeginningCount[i] = c[k++];
+		return filesScanned;
+	}
+
+	// The counters as a histogram (bin k+1 = counter k), which adds up when
+	// shard outputs are merged.
+	TH1D* TotalsHist(int filesScanned) const
+	{
+		vector<double> c = PackCounters(filesScanned);
+		TH1D *h = new TH1D("ScanTotals","vetoPerformance counters",(int)c.size(),0,(double)c.size());
+		h->SetDirectory(0);
+		for (size_t k = 0; k < c.size(); k++) h->SetBinContent(k+1,c[k]);
+		return h;
+	}
+
+	// Read TotalsHist back.  Returns the number of files scanned.
+	int SetTotals(TH1 *h)
+	{
+		vector<double> c(nCounters);
+		for (int k = 0; k < nCounters; k++) c[k] = h->GetBinContent(k+1);
+		int k = 0;
+		return UnpackCounters(c,k);
+	}
+
+	// The end-of-scan summary.
+	void PrintSummary(int filesScanned) const
+	{
+		printf("%i runs, %li total events, total duration: %ld seconds.\n",filesScanned,totEntries,totDuration);
+
+		// check for errors and print summary if we find them.
+		bool foundErrors = false;
+		for (int i = 0; i < nErrs; i++) { 
+			if (globalErrorCount[i] > 0) {
+				foundErrors = true; 
+				break;
+			}
+		}
+
+		if (foundErrors) 
+		{
+			printf("\nError summary:\n");
+			for (int i = 0; i < nErrs; i++) 
+			{
+				if (globalErrorCount[i] > 0) 
+				{
+					foundErrors = true;
+					printf("%i: %i events\t(%.2f%%)\t"
+						,i,globalErrorCount[i],100*(double)globalErrorCount[i]/totEntries);
+					printf("%i runs\t(%.2f%%)\n"
+						,globalRunsWithErrors[i],100*(double)globalRunsWithErrors[i]/filesScanned);
+				}
+			}
+			if (totHighDT>0) printf("High-DeltaT Events: %i  High DT Events with BadScaler: %i\n\n",totHighDT,totHighDTwBTS);
+			printf("Number of SBC/Scaler Jumps: %d\n",SJSBCCount);
+			printf("%li total events, %i total Good Events, %i LED events, %i nonLED events\n",totEntries,totGoodEntries,totLED,totnonLED);
+			printf("SECReset: %d  |  QECReset01: %d  |  QECReset02: %d\n",SECResetCount,QECReset01count,QECReset02count);
+			printf("SECChangeCount: %d  |  QEC1ChangeCount: %d  |  QEC2ChangeCount: %d\n",SECChangeCount,QEC1ChangeCount,QEC2ChangeCount);
+
+			vector<VPBadEntry> sorted = worst;
+			sort(sorted.begin(),sorted.end());
+			printf("\nEntries with the most errors:\n");
+			for (auto &e : sorted)
+				printf("Run %d  |  Entry %d  |  xTime: %f  |  Errors: %d\n",e.run,e.entry,e.time,e.errors);
+		
+			printf("\nBeginning of runs (i < 10) error summary:\n");
+			for (int i = 0; i < nErrs; i++) 
+			{
+				if (globalErrorAtBeginningCount[i] > 0) 
+				{
+					printf("%i: %i events\t (%.2f%%)\t",
+						i,globalErrorAtBeginningCount[i],100*(double)globalErrorAtBeginningCount[i]/totEntries);
+					printf("%i runs\t(%.2f%%)\n",
+						globalRunsWithErrorsAtBeginning[i],100*(double)globalRunsWithErrorsAtBeginning[i]/filesScanned);
+				}
+			}
+			printf("\nFor reference, error types are:\n");
+			cout << "1. Missing channels (< 32 veto datas in event) " << endl;
+			cout << "2. Extra Channels (> 32 veto datas in event) " << endl; 
+			cout << "3. Scaler only (no QDC data) " << endl;
+			cout << "4. Bad Timestamp: FFFF FFFF FFFF FFFF " << endl;
+			cout << "5. QDCIndex - ScalerIndex != 1 or 2 " << endl;
+			cout << "6. Duplicate channels (channel shows up multiple times) " << endl;
+			cout << "7. HW Count Mismatch (SEC - QEC != 1 or 2) " << endl;
+			cout << "8. MJTRun run number doesn't match input file" << endl;
+			cout << "9. MJTVetoData cast failed (missing QDC data)" << endl;
+			cout << "10. Scaler EventCount doesn't match ROOT entry" << endl;
+			cout << "11. Scaler EventCount doesn't match QDC1 EventCount" << endl;
+			cout << "12. QDC1 EventCount doesn't match QDC2 EventCount" << endl;
+			cout << "13. Indexes of QDC1 and Scaler differ by more than 2" << endl;
+			cout << "14. Indexes of QDC2 and Scaler differ by more than 2" << endl;
+			cout << "15. Indexes of either QDC1 or QDC2 PRECEDE the scaler index" << endl;
+			cout << "16. Indexes of either QDC1 or QDC2 EQUAL the scaler index" << endl;
+			cout << "17. Unknown Card is present." << endl;
+		}
+	}
+
+	private:
+	VPAccumulator(const VPAccumulator&);
+	VPAccumulator& operator=(const VPAccumulator&);
+};
+
+// What the merge step needs to know about a run, besides its accumulator.
+struct VPRunInfo
+{
+	long vEntries;
+	VetoSnapshot first;		// first good event
+	double SBCOffset;
+	bool hasLast;			// was the last entry good?
+	VetoSnapshot last;
+	vector<pair<TObject*,string> > plots;	// runBreakdowns plots, written when merged
+	string summary;
+	vector<LEDPeak> ledPeaks;	// one per panel, for the calibration store
+	RunSeries *series;		// runBreakdowns per-entry diagnostics, graphed when merged
+	string log;				// the scan's printout, printed when merged
+	VetoErrorCounts errors;	// the error policy's counts, added when merged
+	VPRunInfo() : vEntries(0), SBCOffset(0), hasLast(false), series(NULL) { first.Clear(); last.Clear(); }
+	~VPRunInfo() { delete series; }
+
+	// printf into the run's log, so runs scanned in parallel don't print over each other
+	void Log(const char *fmt, ...)
+	{
+		char buf[1000];
+		va_list args;
+		va_start(args,fmt);
+		int n = vsnprintf(buf,sizeof(buf),fmt,args);
+		va_end(args);
+		if (n < (int)sizeof(buf)) {
+			log += buf;
+			return;
+		}
+		vector<char> big(n+1);
+		va_start(args,fmt);
+		vsnprintf(&big[0],big.size(),fmt,args);
+		va_end(args);
+		log += &big[0];
+	}
+
+	// An entry's contents, in place of MJVetoEvent::Print (which goes straight to stdout)
+	void LogEvent(MJVetoEvent &veto, int entry)
+	{
+		Log("Entry %d  |  Multip: %d  |  TotE: %d  |  ScalerTime: %f  |  SBCTime: %f  |  SEC: %ld  |  QEC: %ld  |  QEC2: %ld\nQDC:",
+			entry,veto.GetMultip(),(int)veto.GetTotE(),veto.GetTimeSec(),veto.GetTimeSBC(),veto.GetSEC(),veto.GetQEC(),veto.GetQEC2());
+		for (int j = 0; j < 32; j++) Log(" %d",veto.GetQDC(j));
+		Log("\n");
+	}
+
+	private:
+	VPRunInfo(const VPRunInfo&);
+	VPRunInfo& operator=(const VPRunInfo&);
+};
+
+// A merged run's output, written on the writer thread (code/VetoWriter.hh):
+// its plots and summary lines, then a checkpoint of the totals as they were
+// just after it was merged.
+struct VPOutput
+{
+	int run;
+	VPRunInfo *info;		// deleted once written
+	vector<double> scalars;	// the checkpointed counters (none: no checkpoint)
+	vector<TH1*> hists;		// copies of the total histograms
+	vector<double> lastprevrun;
+	VPOutput() : run(0), info(NULL) {}
+};
+
+void vetoPerformance(string Input, int *thresh, bool runBreakdowns, RunWatcher *follow, bool resume) 
+{
+	// input a list of run numbers, or follow a data directory
+	RunSet runSet;
+	if (follow == NULL && !runSet.Load(Input)) return;
+	RunSet::iterator runIt = runSet.begin();
     int filesScanned = 0;	// 1-indexed.
 
     // output a ROOT file
 	string Name = Input;
 	Name.erase(Name.find_last_of("."),string::npos);
 	Name.erase(0,Name.find_last_of("\\/")+1);
+
+	// Checkpoint, written after every run and removed when the scan finishes.
+	// The ROOT file holds the counters and histograms.
+	string ckptName = "./output/VP_"+Name+"_ckpt.root";
+	TFile *ckptFile = NULL;
+	vector<double> *ckpt = NULL;
+	if (resume && follow == NULL) {
+		if (!gSystem->AccessPathName(ckptName.c_str())) ckptFile = TFile::Open(ckptName.c_str());
+		if (ckptFile != NULL) ckptFile->GetObject("scalars",ckpt);
+		if (ckpt == NULL) cout << "No usable checkpoint " << ckptName << ", starting from the beginning.\n";
+		else printf("Resuming from %s: %i runs already done.\n",ckptName.c_str(),(int)(*ckpt)[0]);
+	}
+	bool resuming = (ckpt != NULL);
+
 	Char_t OutputFile[200];
 	sprintf(OutputFile,"./output/VP_%s.root",Name.c_str());
-	TFile *RootFile = new TFile(OutputFile, "RECREATE"); 	
+	TFile *RootFile = new TFile(OutputFile, (resuming || follow != NULL) ? "UPDATE" : "RECREATE"); 	
   	TH1::AddDirectory(kFALSE); // Global flag: "When a (root) file is closed, all histograms in memory associated with this file are automatically deleted."
-	RootFile->mkdir("rawQDC");
-	if (runBreakdowns) RootFile->mkdir("runPlots");
-
-	// global counters
-	const int nErrs = 18;
-	int globalErrorCount[nErrs] = {0};
-	int globalRunsWithErrors[nErrs] = {0};
-	int globalRunsWithErrorsAtBeginning[nErrs] = {0};
-	int globalErrorAtBeginningCount[nErrs] = {0};
-	int SJSBCCount = 0;
-	vector<double> runs;
-	vector<double> freqs;
-	vector<double> ErrCountEntry;
-	vector<double> EntryTime;
-	vector<double> EntryNum;
-	vector<int> HighDTEvent;
-	vector<double> SJTime;
-	vector<int> SJIndex;
-	long totEntries = 0;
-	long totDuration = 0;
-	int totHighDT = 0;
-	int totHighDTwBTS = 0;	//number of high DT events with bad scaler time stamps
-	int totLED = 0;
-	int totnonLED = 0;
-	int totGoodEntries = 0;
-	bool SECReset = false;
-	bool QECReset01 = false;
-	bool QECReset02 = false;
-	int SECResetCount = 0;
-	int QECReset01count = 0;
-	int QECReset02count = 0;
-	int QEC1ChangeCount = 0;
-	int QEC2ChangeCount = 0;
-	int SECChangeCount = 0;
+	if (RootFile->GetDirectory("rawQDC") == NULL) RootFile->mkdir("rawQDC");
+	if (runBreakdowns && RootFile->GetDirectory("runPlots") == NULL) RootFile->mkdir("runPlots");
+
+	// output a one-line-per-run summary (appended to when following)
+	string sumName = "./output/VP_"+Name+"_summary.txt";
+	BufferedOfstream RunSummary;
+	if (follow != NULL) RunSummary.open(sumName.c_str(),ios::app);
+	else RunSummary.open(sumName.c_str());
+
+	// LED peak calibration store (see code/vetoLEDCal.hh), appended to after each run
+	string calName = "./output/LEDCal_"+Name+".txt";
+
+	// global counters and histograms (see VPAccumulator)
+	const int nErrs = VPAccumulator::nErrs;
+	VPAccumulator tot;
+	int *globalErrorCount = tot.globalErrorCount;
+	int *globalRunsWithErrors = tot.globalRunsWithErrors;
+	int *globalRunsWithErrorsAtBeginning = tot.globalRunsWithErrorsAtBeginning;
+	int *globalErrorAtBeginningCount = tot.globalErrorAtBeginningCount;
+	int &SJSBCCount = tot.SJSBCCount;
+	vector<double> &runs = tot.runs;
+	vector<double> &freqs = tot.freqs;
+	vector<VPBadEntry> &worst = tot.worst;
+	long &totEntries = tot.totEntries;
+	long &totDuration = tot.totDuration;
+	int &totHighDT = tot.totHighDT;
+	int &totHighDTwBTS = tot.totHighDTwBTS;
+	int &totLED = tot.totLED;
+	int &totnonLED = tot.totnonLED;
+	int &totGoodEntries = tot.totGoodEntries;
+	int &SECResetCount = tot.SECResetCount;
+	int &QECReset01count = tot.QECReset01count;
+	int &QECReset02count = tot.QECReset02count;
+	int &QEC1ChangeCount = tot.QEC1ChangeCount;
+	int &QEC2ChangeCount = tot.QEC2ChangeCount;
+	int &SECChangeCount = tot.SECChangeCount;
 	double PrevRunSBCOffset = 0;
 	double rungap = 0;
 	
 	// global histograms and graphs
 	TGraph *gRunVsLEDFreq;				// depends on: runs & freqs
-	TGraph *gErrorCountEntryVsTime; 	// depends on: ErrorCountEntry & EntryTime
-	TGraph *gErrorCountEntryVsEntryNum; // depends on: ErrorCountEntry & EntryNum
 
-	TH1D *TotalMultip = new TH1D("TotalMultip","Events over threshold",33,0,33);
-	TotalMultip->GetXaxis()->SetTitle("number of panels hit");
+	TH1D *TotalMultip = tot.TotalMultip;
+	TH1D *TotalEnergy = tot.TotalEnergy;
+	TH1D *deltaT = tot.deltaT;
+	TH1D *TotalEnergyNoLED = tot.TotalEnergyNoLED;
+	TH1D *QDC_over_Multip = tot.QDC_over_Multip;
+	VetoHistSet &hRawQDC = tot.hRawQDC;
+	TH1D *TimestampBadEntry = tot.TimestampBadEntry;
+	TH1D *ScalerJumpTime = tot.ScalerJumpTime;
+	TH2D *ErrorCountVsTime = tot.ErrorCountVsTime;
+	TH2D *ErrorCountVsEntryNum = tot.ErrorCountVsEntryNum;
+	char hname[50];
 	
-	TH1D *TotalEnergy = new TH1D("TotalEnergy","Total QDC from events",100,0,60000);
-	TotalEnergy->GetXaxis()->SetTitle("energy (QDC)");
+	//define lastprevrun vetoevent holder
+	VetoSnapshot lastprevrun;	//DO NOT CLEAR
+	lastprevrun.Clear();
 
-	TH1D *deltaT = new TH1D("deltaT","Time between successive entries",200,0,20);
-	deltaT->GetXaxis()->SetTitle("seconds");
-	
-	TH1D *TotalEnergyNoLED = new TH1D("TotalEnergyNoLED","Total QDC from non-LED events",100,0,60000);
-	TotalEnergyNoLED->GetXaxis()->SetTitle("energy (QDC)");
+	// The checkpointed counters: the accumulator's (VPAccumulator::PackCounters),
+	// then the ones below.  The runs/freqs vectors and the worst entries (run,
+	// entry, errors, time) follow these.  The sizes of the summary and calibration
+	// files are filled in when the checkpoint is written, after the run's lines are.
+	const int ckptSumBytes = VPAccumulator::nCounters + 2, ckptCalBytes = ckptSumBytes + 1;
+	auto packCounters = [&]()
+	{
+		vector<double> c = tot.PackCounters(filesScanned);
+		vector<double> more = {PrevRunSBCOffset, rungap, 0, 0, (double)runs.size(), (double)worst.size()};
+		c.insert(c.end(),more.begin(),more.end());
+		c.insert(c.end(),runs.begin(),runs.end());
+		c.insert(c.end(),freqs.begin(),freqs.end());
+		for (auto &e : worst) {
+			c.push_back(e.run); c.push_back(e.entry); c.push_back(e.errors); c.push_back(e.time);
+		}
+		return c;
+	};
 
-	TH1D *QDC_over_Multip = new TH1D("QDC_over_Multip","Average QDC from events",1000,0,5000);
-	QDC_over_Multip->GetXaxis()->SetTitle("Average energy (QDC)");
-	
-	TH1D *TimestampBadEntry = new TH1D("TimestampBadEntry"," Timestamp of entries with > 2 errors",3650,0,3650);
-	TimestampBadEntry->GetXaxis()->SetTitle("seconds");
-	
-	TH1D *hRawQDC[32];
-	char hname[50];
-	for (int i=0; i<32; i++)
+	// Pick up where the checkpoint left off
+	if (resuming)
+	{
+		vector<double> &c = *ckpt;
+		int k = 0;
+		filesScanned = tot.UnpackCounters(c,k);
+		PrevRunSBCOffset = c[k++]; rungap = c[k++];
+		long sumBytes = (long)c[k++];
+		long calBytes = (long)c[k++];
+		int nRuns = (int)c[k++];
+		int nWorst = (int)c[k++];
+		runs.assign(c.begin()+k,c.begin()+k+nRuns);
+		freqs.assign(c.begin()+k+nRuns,c.begin()+k+2*nRuns);
+		k += 2*nRuns;
+		for (int i = 0; i < nWorst; i++, k += 4) {
+			VPBadEntry e;
+			e.run = (int)c[k]; e.entry = (int)c[k+1]; e.errors = (int)c[k+2]; e.time = c[k+3];
+			tot.AddBad(e);
+		}
+
+		// histograms and the last event of the previous run
+		TH1 *hists[9] = {TotalMultip,TotalEnergy,deltaT,TotalEnergyNoLED,QDC_over_Multip,
+			TimestampBadEntry,ScalerJumpTime,ErrorCountVsTime,ErrorCountVsEntryNum};
+		for (int i = 0; i < 9; i++) {
+			TH1 *h = NULL;
+			ckptFile->GetObject(hists[i]->GetName(),h);
+			if (h != NULL) VPAccumulator::MergeRunHist(hists[i],h);
+		}
+		for (int i = 0; i < 32; i++) {
+			TH1D *h = NULL;
+			sprintf(hname,"hRawQDC%d",i);
+			ckptFile->GetObject(hname,h);
+			if (h != NULL) hRawQDC[i].Add(h);
+		}
+		vector<double> *lp = NULL;
+		ckptFile->GetObject("lastprevrun",lp);
+		if (lp != NULL) lastprevrun.Unpack(*lp);
+		ckptFile->Close();
+
+		RunSummary.close();
+		truncate(sumName.c_str(),(off_t)sumBytes);
+		RunSummary.open(sumName.c_str(),ios::app);
+		truncate(calName.c_str(),(off_t)calBytes);
+		RootFile->cd();
+	}
+
+	// A follower picks up the totals an earlier follower left in the ROOT file,
+	// so a restart adds to the file's history (like the summary text) instead of wiping it.
+	TH1 *prevTotals = NULL;
+	if (follow != NULL) RootFile->GetObject("ScanTotals",prevTotals);
+	if (prevTotals != NULL)
 	{
-		sprintf(hname,"hRawQDC%d",i);
-		hRawQDC[i] = new TH1D(hname,hname,4200,0,4200);
+		filesScanned = tot.SetTotals(prevTotals);
+		delete prevTotals;
+		const char *keys[9] = {"TotalMultip","TotalEnergy","deltaT","TotalEnergyNoLED","QDC_over_Multip",
+			"TimestampBadEntry","ScalerJumpTime","ErrorCountVsTime","ErrorCountVsEntryNum"};
+		TH1 *hists[9] = {TotalMultip,TotalEnergy,deltaT,TotalEnergyNoLED,QDC_over_Multip,
+			TimestampBadEntry,ScalerJumpTime,ErrorCountVsTime,ErrorCountVsEntryNum};
+		for (int i = 0; i < 9; i++) {
+			TH1 *h = NULL;
+			RootFile->GetObject(keys[i],h);
+			if (h != NULL) VPAccumulator::MergeRunHist(hists[i],h);
+			delete h;
+		}
+		for (int i = 0; i < 32; i++) {
+			TH1D *h = NULL;
+			sprintf(hname,"rawQDC/hRawQDC%d",i);
+			RootFile->GetObject(hname,h);
+			if (h != NULL) hRawQDC[i].Add(h);
+			delete h;
+		}
+		TGraph *g = NULL;
+		RootFile->GetObject("RunVsLEDFreq",g);
+		if (g != NULL) {
+			runs.assign(g->GetX(),g->GetX()+g->GetN());
+			freqs.assign(g->GetY(),g->GetY()+g->GetN());
+			delete g;
+		}
+		TTree *worstTree = NULL;
+		RootFile->GetObject("WorstEntries",worstTree);
+		if (worstTree != NULL) {
+			VPBadEntry e;
+			worstTree->SetBranchAddress("run",&e.run);
+			worstTree->SetBranchAddress("entry",&e.entry);
+			worstTree->SetBranchAddress("errors",&e.errors);
+			worstTree->SetBranchAddress("time",&e.time);
+			for (long i = 0; i < (long)worstTree->GetEntries(); i++) {
+				worstTree->GetEntry(i);
+				tot.AddBad(e);
+			}
+			delete worstTree;
+		}
+		printf("Following on from %s: %i runs already scanned.\n",OutputFile,filesScanned);
+		RootFile->cd();
 	}
+
+	FILE *LEDCal = fopen(calName.c_str(), (resuming || follow != NULL) ? "a" : "w");
+	if (LEDCal == NULL) {
+		cout << "Couldn't open " << calName << endl;
+		return;
+	}
+	if (GetFileSize(calName) <= 0) WriteLEDCalHeader(LEDCal);
+
+	// Copy what a checkpoint holds, as it is after merging a run.
+	auto snapshot = [&](VPOutput &o)
+	{
+		o.scalars = packCounters();
+		TH1 *hists[9] = {TotalMultip,TotalEnergy,deltaT,TotalEnergyNoLED,QDC_over_Multip,
+			TimestampBadEntry,ScalerJumpTime,ErrorCountVsTime,ErrorCountVsEntryNum};
+		o.hists.clear();
+		for (int i = 0; i < 9; i++) o.hists.push_back((TH1*)hists[i]->Clone());
+		for (int i = 0; i < 32; i++) {
+			sprintf(hname,"hRawQDC%d",i);
+			o.hists.push_back(hRawQDC[i].ToTH1D(hname,hname));
+		}
+		o.lastprevrun = lastprevrun.Pack();
+	};
+
+	// Save a checkpoint after a run (on the writer thread).  The ROOT file is
+	// renamed into place last, so a crash part way through leaves the previous
+	// checkpoint intact.
+	auto checkpoint = [&](VPOutput &o)
+	{
+		RootFile->Write(0,TObject::kOverwrite);
+		RunSummary.flush();
+		fflush(LEDCal);
+		o.scalars[ckptSumBytes] = GetFileSize(sumName);
+		o.scalars[ckptCalBytes] = GetFileSize(calName);
+
+		string tmp = ckptName + ".tmp";
+		TFile *f = new TFile(tmp.c_str(),"RECREATE");
+		f->WriteObject(&o.scalars,"scalars");
+		for (auto h : o.hists) {
+			h->Write();
+			delete h;
+		}
+		o.hists.clear();
+		f->WriteObject(&o.lastprevrun,"lastprevrun");
+		f->Close();
+		delete f;
+		rename(tmp.c_str(),ckptName.c_str());
+		RootFile->cd();
+	};
+
 	
-	//define lastprevrun vetoevent holder
-	MJVetoEvent lastprevrun;	//DO NOT CLEAR
+	// Write the global plots.  When following, this is called after every run
+	// so the ROOT file is always readable and current.
+	auto writeGlobal = [&]()
+	{
+		RootFile->cd();
+		gRunVsLEDFreq = new TGraph(runs.size(),&(runs[0]),&(freqs[0]));
+		gRunVsLEDFreq->SetTitle("LED Frequency vs Run Number");
+		gRunVsLEDFreq->GetXaxis()->SetTitle("Run Number");
+		gRunVsLEDFreq->GetYaxis()->SetTitle("LED Freq (Hz)");
+		gRunVsLEDFreq->SetMarkerColor(4);
+		gRunVsLEDFreq->SetMarkerStyle(21);
+		gRunVsLEDFreq->SetMarkerSize(0.5);
+		gRunVsLEDFreq->SetLineColorAlpha(kWhite,0);
+		gRunVsLEDFreq->Write("RunVsLEDFreq",TObject::kOverwrite);
+		delete gRunVsLEDFreq;
+	
+		TotalMultip->Write("TotalMultip",TObject::kOverwrite);
+		TotalEnergy->Write("TotalEnergy",TObject::kOverwrite);
+		TotalEnergyNoLED->Write("TotalEnergyNoLED",TObject::kOverwrite);
+		QDC_over_Multip->Write("QDC_over_Multip",TObject::kOverwrite);
+		TimestampBadEntry->Write("TimestampBadEntry",TObject::kOverwrite);
+		ScalerJumpTime->Write("ScalerJumpTime",TObject::kOverwrite);
+		ErrorCountVsTime->Write("ErrorCountVsTime",TObject::kOverwrite);
+		ErrorCountVsEntryNum->Write("ErrorCountVsEntryNum",TObject::kOverwrite);
 
 	
+		deltaT->Write("deltaT",TObject::kOverwrite);
+
+		// the counters and worst entries, so vetoScan --merge can redo the summary
+		TH1D *totals = tot.TotalsHist(filesScanned);
+		totals->Write("ScanTotals",TObject::kOverwrite);
+		delete totals;
+		TTree *worstTree = new TTree("WorstEntries","Entries with the most errors");
+		VPBadEntry e;
+		worstTree->Branch("run",&e.run);
+		worstTree->Branch("entry",&e.entry);
+		worstTree->Branch("errors",&e.errors);
+		worstTree->Branch("time",&e.time);
+		for (auto &w : worst) {
+			e = w;
+			worstTree->Fill();
+		}
+		worstTree->Write("WorstEntries",TObject::kOverwrite);
+		delete worstTree;
+
+		RootFile->cd("rawQDC");
+		for (int i=0;i<32;i++)
+		{	
+			sprintf(hname,"hRawQDC%d",i);
+			TH1D *h = hRawQDC[i].ToTH1D(hname,hname);
+			h->Write(hname,TObject::kOverwrite);
+			delete h;
+		}
+		RootFile->cd();
+		RootFile->Write(0,TObject::kOverwrite);	// one cycle per key, however many times it's called
+	};
+
+	// Graph a run's diagnostics into runPlots (min/max of each of seriesBuckets
+	// groups of entries, see code/RunSeries.hh).
+	const int seriesBuckets = 2000;
+	auto writeSeries = [&](int run, RunSeries &rs)
+	{
+		char gname[50];
+		TGraph *g[6] = {
+			RunSeries::MakeGraph(rs.time,rs.multip,NULL,seriesBuckets),
+			RunSeries::MakeGraph(rs.sIndex,rs.sTime,&rs.badScaler,seriesBuckets),
+			rs.MakeLEDGraph(seriesBuckets),
+			RunSeries::MakeGraph(rs.time,rs.SEC,NULL,seriesBuckets),
+			RunSeries::MakeGraph(rs.time,rs.QEC,NULL,seriesBuckets),
+			RunSeries::MakeGraph(rs.time,rs.QEC2,NULL,seriesBuckets)};
+		const char *names[6] = {"MultipVsTime","STimeVsfIndex","LEDTSVsLEDcount","EventCountScaler","EventCountQDC1","EventCountQDC2"};
+		const int markerStyle[6] = {21,21,21,20,21,22};
+		const int markerColor[6] = {4,4,4,2,4,6};
+		g[1]->GetXaxis()->SetTitle("Scaler Index");
+		g[1]->GetYaxis()->SetTitle("Scaler Time (sec)");
+		g[2]->GetXaxis()->SetTitle("LED count");
+		g[2]->GetYaxis()->SetTitle("LED Event Scaler Time (sec)");
+		for (int k = 0; k < 6; k++) {
+			sprintf(gname,"%d_%s",run,names[k]);
+			g[k]->SetMarkerStyle(markerStyle[k]);
+			g[k]->SetMarkerColor(markerColor[k]);
+			if (k < 3) g[k]->SetMarkerSize(0.5);
+			g[k]->SetLineColorAlpha(kWhite,0);
+			g[k]->Write(gname,TObject::kOverwrite);
+			delete g[k];
+		}
+	};
+
+	// The per-run output is written on its own thread, so the scan threads
+	// don't wait on the disk.  Only the writer touches RootFile, RunSummary
+	// and LEDCal until it's closed (or flushed, when following).
+	VetoWriter<VPOutput> writer([&](VPOutput &o)
+	{
+		VPRunInfo &info = *o.info;
+		if (runBreakdowns) {
+			RootFile->cd("runPlots");
+			for (auto &pl : info.plots) {
+				pl.first->Write(pl.second.c_str(),TObject::kOverwrite);
+				delete pl.first;
+			}
+			info.plots.clear();
+			if (info.series != NULL) writeSeries(o.run,*info.series);
+			RootFile->cd();
+		}
+		RunSummary << info.summary << "\n";
+		for (auto &pk : info.ledPeaks) WriteLEDPeak(LEDCal,pk);
+		if (follow != NULL) {
+			RunSummary.flush();
+			fflush(LEDCal);
+		}
+		delete o.info;
+		o.info = NULL;
+		if (!o.scalars.empty()) checkpoint(o);
+	},8);
+
 	// ==========================loop over input files==========================
 	//
-	while(!InputList.eof())
+	map<int,string> builtFiles;	// when following, runs are read from the watched directory
+	auto nextRun = [&](int &r) -> bool
 	{
-		int run = 0;
-		InputList >> run;
-		filesScanned++;
+		if (follow != NULL) {
+			RunWatcher::RunFiles files;
+			if (!follow->Next(r,&files)) return false;
+			builtFiles[r] = files.built;
+			return true;
+		}
+		if (runIt == runSet.end()) return false;
+		r = *runIt;
+		++runIt;
+		return true;
+	};
+	// ==================== scan one run into its own accumulator ====================
+	//
+	mutex gatLock;
+	auto scanRun = [&](int run, VPAccumulator &acc, VPRunInfo &info, RunState &state) -> bool
+	{
+		int *globalErrorCount = acc.globalErrorCount;
+		int *globalRunsWithErrors = acc.globalRunsWithErrors;
+		int *globalRunsWithErrorsAtBeginning = acc.globalRunsWithErrorsAtBeginning;
+		int *globalErrorAtBeginningCount = acc.globalErrorAtBeginningCount;
+		int &SJSBCCount = acc.SJSBCCount;
+		vector<double> &runs = acc.runs;
+		vector<double> &freqs = acc.freqs;
+		long &totEntries = acc.totEntries;
+		long &totDuration = acc.totDuration;
+		int &totHighDT = acc.totHighDT;
+		int &totHighDTwBTS = acc.totHighDTwBTS;
+		int &totLED = acc.totLED;
+		int &totnonLED = acc.totnonLED;
+		int &totGoodEntries = acc.totGoodEntries;
+		int &SECResetCount = acc.SECResetCount;
+		int &QECReset01count = acc.QECReset01count;
+		int &QECReset02count = acc.QECReset02count;
+		int &QEC1ChangeCount = acc.QEC1ChangeCount;
+		int &QEC2ChangeCount = acc.QEC2ChangeCount;
+		int &SECChangeCount = acc.SECChangeCount;
+		TH1D *TotalMultip = acc.TotalMultip;
+		TH1D *TotalEnergy = acc.TotalEnergy;
+		TH1D *deltaT = acc.deltaT;
+		TH1D *TotalEnergyNoLED = acc.TotalEnergyNoLED;
+		TH1D *QDC_over_Multip = acc.QDC_over_Multip;
+		VetoHistSet &hRawQDC = acc.hRawQDC;
+		char hname[50];
+		VetoHistSet ledQDC(32,1400,0.,4200.);	// LED-tagged QDC above threshold, for the calibration
+		int runGoodEntries = 0;
+		int runHighDT = 0;
 
-		// initialize
-		GATDataSet *ds = new GATDataSet(run);
+		// initialize (GATDataSet isn't thread-safe)
+		gatLock.lock();
+		VetoSource *ds = new VetoSource(run,builtFiles.count(run) ? builtFiles[run] : "");
 		TChain *v = ds->GetVetoChain();
 		long vEntries = v->GetEntries();
+		gatLock.unlock();
+		info.vEntries = vEntries;
 		MJTRun *vRun = new MJTRun();
 		MGTBasicEvent *vEvent = new MGTBasicEvent(); 
 		unsigned int mVeto = 0;
@@ -124,15 +858,25 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 		v->SetBranchAddress("mVeto",&mVeto);
 		v->SetBranchAddress("vetoEvent",&vEvent);
 		v->SetBranchAddress("vetoBits",&vBits);
-		
+	
 		long start = (long)vRun->GetStartTime();
 		long stop = (long)vRun->GetStopTime();
 		double duration = (double)(stop - start);
 		totEntries += vEntries;
 		totDuration += (long)duration;
 
+		// start, stop and duration are read before any entry is loaded, as they
+		// always have been, so the scan's output doesn't change.  The warm start
+		// and the LED peaks need the run's real start time.
+		v->GetEntry(0);
+		long runStart = (long)vRun->GetStartTime();
+
 		// run-by-run variables
 		int errorCount[nErrs] = {0};
+		vector<int> HighDTEvent;
+		bool SECReset = false;
+		bool QECReset01 = false;
+		bool QECReset02 = false;
 		vector<double> LocalErrCountEntry;
 		vector<double> LocalEntryTime;
 		vector<double> LocalEntryNum;
@@ -142,52 +886,31 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 		sprintf(hname,"%d_LEDDeltaT",run);
 		TH1D *LEDDeltaT = new TH1D(hname,hname,100000,0,100); // 0.001 sec/bin
 		TH1D *deltaTRun = NULL;
-		TGraph *gMultipVsTimeRun = NULL;
-		TGraph *gSTimeVsfIndex = NULL;	
-		TGraph *gLEDTSVsLEDCount = NULL;	
-		TGraph *gEventCountScaler = NULL;
-		TGraph *gEventCountQDC1 = NULL;
-		TGraph *gEventCountQDC2 = NULL;
+		RunSeries *series = NULL;
 		if (runBreakdowns)
 		{
 			sprintf(hname,"%d_deltaT", run);
 			deltaTRun = new TH1D(hname,hname,700,0,70);
-
-			sprintf(hname,"%d_MultipVsTime", run);
-			gMultipVsTimeRun = new TGraph(vEntries);
-			gMultipVsTimeRun->SetName(hname);
-			
-			sprintf(hname,"%d_STimeVsfIndex", run);
-			gSTimeVsfIndex = new TGraph(vEntries);
-			gSTimeVsfIndex->SetName(hname);
-			
-			sprintf(hname,"%d_LEDTSVsfIndex", run);
-			gLEDTSVsLEDCount = new TGraph(vEntries);
-			gLEDTSVsLEDCount->SetName(hname);
-			
-			sprintf(hname,"%d_EventCountScaler", run);
-			gEventCountScaler = new TGraph(vEntries);
-			gEventCountScaler->SetName(hname);
-			
-			sprintf(hname,"%d_EventCountQDC1", run);
-			gEventCountQDC1 = new TGraph(vEntries);
-			gEventCountQDC1->SetName(hname);
-			
-			sprintf(hname,"%d_EventCountQDC2", run);
-			gEventCountQDC2 = new TGraph(vEntries);
-			gEventCountQDC2->SetName(hname);
+			series = new RunSeries();
+			series->Reserve(vEntries);
+			info.series = series;
 		}
 
-		printf("\n======= Scanning run %i, %li entries, %.0f sec. =======\n",run,vEntries,duration);
-		MJVetoEvent prev;
-		MJVetoEvent first;
-		MJVetoEvent last;
+		info.Log("\n======= Scanning run %i, %li entries, %.0f sec. =======\n",run,vEntries,duration);
+		VetoRing<2> measureHistory;	// previous good entries (code/VetoSnapshot.hh)
+		CounterCheck counters;		// every entry's event counts, for the resets and changes
+		counters.Reserve(vEntries);
+		VetoSnapshot first;
+		VetoSnapshot last;
+		first.Clear();
+		last.Clear();
 		bool foundFirst = false;
 		int firstGoodEntry = 0;
 		int pureLEDcount = 0;
 		bool errorRunBools[nErrs] = {0};
 		bool errorRunBeginningBools[nErrs] = {0};
 		int highestMultip = 0;
+		int measuredMultip = 0;
 		double xTime = 0;
 		double lastGoodTime = 0;
 		bool FirstHighMultip = false;
@@ -196,13 +919,19 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 		double SBCOffset = 0;
 
 		// ====================== First loop over entries =========================
-		for (int i = 0; i < vEntries; i++)
+		//
+		// A run that follows another starts warm (code/RunState.hh): this loop
+		// stops at the first good entry, and the second loop does the rest of
+		// its job as it goes, with the last run's LED period and highest
+		// multiplicity.  At the end, the measured ones have to give the same
+		// high delta-t calls.  If they don't, or the second loop meets a bad
+		// scaler (its time needs the whole first loop), scanRun returns false,
+		// and the run is scanned again the old way.
+		//
+		auto measure = [&](MJVetoEvent &veto, int i, int isGood)
 		{
-			v->GetEntry(i);
-			MJVetoEvent veto;
-			veto.SetSWThresh(thresh);	
-	    	int isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true); // true: force-write event with errors.
 			bool isLED = false;
+			counters.Push(veto,!GetErrorPolicy().IsFatal(isGood));
 
 	    	// count up error types
 	    	int errorsThisEntry = 0; 
@@ -219,7 +948,7 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 	    			}
 	    		}
 	    	}
-				
+			
 	    	// find event time and fill vectors
 			if (!veto.GetBadScaler()) {
 				LocalBadScalers.push_back(0);
@@ -229,132 +958,162 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 				LocalBadScalers.push_back(1);
 				xTime = ((double)i / vEntries) * duration;
 			}
-			
-	    	// fill vectors
-	    	// (the time vectors are revised in the second loop)
-			EntryNum.push_back(i);
-			EntryTime.push_back(xTime);
-			ErrCountEntry.push_back(errorsThisEntry);
+		
+	    	// fill the error timeline, and the run's vectors
+	    	// (the run's time vector is revised in the second loop)
+			acc.ErrorCountVsTime->Fill(xTime,errorsThisEntry);
+			acc.ErrorCountVsEntryNum->Fill(i,errorsThisEntry);
+			if (errorsThisEntry > 2) acc.TimestampBadEntry->Fill(xTime);
+			if (errorsThisEntry > 0) {
+				VPBadEntry bad = {run, i, errorsThisEntry, xTime};
+				acc.AddBad(bad);
+			}
 			LocalEntryNum.push_back(i);		
 			LocalEntryTime.push_back(xTime);
 			LocalErrCountEntry.push_back(errorsThisEntry);
-			
-			// skip bad entries (true = print contents of skipped event)
-	    	if (CheckForBadErrors(veto,i,isGood,false)) continue;
-			
+		
+			// skip bad entries (see code/vetoErrorPolicy.hh)
+	    	if (GetErrorPolicy().Check(veto,i,isGood,info.errors)) return;
+		
 			totGoodEntries++;
 
     		// Save the first good entry number for the SBC offset
-			//deleted isGood == 1 requirement because we already checked for bad errors in CheckForBadErrors
+			//deleted isGood == 1 requirement because we already checked for bad errors with the error policy
 			if (!foundFirst && veto.GetTimeSBC() > 0 && veto.GetTimeSec() > 0 && errorRunBools[4] == false) { //current badtimestamp is not a "bad" error. include errorRunBools[4] ==false to make sure we get a good timestamp for SBC offset
-				first = veto;
+				first.Set(veto,isGood,i);
 				foundFirst = true;
 				firstGoodEntry = i;
 			}
-				
+			
 			// find the highest multiplicity in this run (used in 2nd loop)
-	    	if (veto.GetMultip() > highestMultip && veto.GetMultip() < 33) {
-	    		highestMultip = veto.GetMultip();
-	    		cout << "Finding highest multiplicity: " << highestMultip << "  entry: " << i << endl;
+	    	if (veto.GetMultip() > measuredMultip && veto.GetMultip() < 33) {
+	    		measuredMultip = veto.GetMultip();
+	    		info.Log("Finding highest multiplicity: %d  entry: %d\n",measuredMultip,i);
 	    	}
-			
+		
 	    	// very simple LED tag 
 			if (veto.GetMultip() > 20) {
-				LEDDeltaT->Fill(veto.GetTimeSec()-prev.GetTimeSec());
+				LEDDeltaT->Fill(veto.GetTimeSec()-measureHistory.Back().GetTimeSec());
 				pureLEDcount++;
 				isLED = true;
 				totLED++;
 				if (runBreakdowns) { 
 					if (!veto.GetBadScaler()) {
-						gLEDTSVsLEDCount->SetPoint(i,pureLEDcount,veto.GetTimeSec());
+						series->AddLED(veto.GetTimeSec());
 					}
-					else printf("bad scaler LED! run: %d  |  entry: %d  |  ledcount: %d\n",run,i,pureLEDcount);
+					else info.Log("bad scaler LED! run: %d  |  entry: %d  |  ledcount: %d\n",run,i,pureLEDcount);
 				}
 			}
-			
+		
 			if (!isLED) totnonLED++;
-			
+		
 			// end of loop : save things
-			prev = veto;
+			measureHistory.Push(veto,isGood,i);
 			lastGoodTime = xTime;
+		};
+		bool warm = (state.highestMultip > 0 && state.LEDperiod > 0 && state.WarmFor(run,runStart));
+		int measured = vEntries;
+		MJVetoEvent veto;
+		for (int i = 0; i < vEntries; i++)
+		{
+			v->GetEntry(i);
 			veto.Clear();
-			
-		}
-
-		// Make sure the local vectors are all the same size
-		if ((LocalEntryNum.size() != LocalEntryTime.size()) || (LocalEntryNum.size() != LocalErrCountEntry.size()))
-		printf("Warning! Local vectors are not the same size!\n");
-
-		// if duration is corrupted, use the last good timestamp as the duration.
-		if (duration == 0) {
-			printf("Corrupted duration. Using last good timestamp: %.2f\n",lastGoodTime-first.GetTimeSec());
-			duration = lastGoodTime-first.GetTimeSec();
-			totDuration += duration;
+			veto.SetSWThresh(thresh);	
+	    	int isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true); // true: force-write event with errors.
+			measure(veto,i,isGood);
+			if (warm && foundFirst) {
+				if (state.SBCHolds(first.GetTimeSBC()-first.GetTimeSec(),runStart)) {
+					measured = i+1;
+					break;
+				}
+				info.Log("SBC offset isn't the one run %d predicts.  Not starting from it.\n",state.run);
+				warm = false;
+			}
 		}
 
-		// find the SBC offset		
-		SBCOffset = first.GetTimeSBC() - first.GetTimeSec();
-		printf("First good entry: %i  |  SBCOffset: %.2f  |  firstScalerTime: %lf  |  firstSBCTime: %lf  |  firstScalerIndex: %ld\n",firstGoodEntry,SBCOffset,first.GetTimeSec(),first.GetTimeSBC(),first.GetScalerIndex());
-
-		// find the LED frequency, set time window, 
+		// the first loop's results (the rest of it, when starting warm)
 		double RMSTimeWindow = 0.1;
-		printf("\"Simple\" LED count: %i.  Approx rate: %.3f\n",pureLEDcount,pureLEDcount/duration);
 		double LEDrms = 0;
 		double LEDfreq = 0;
-		int dtEntries = LEDDeltaT->GetEntries();
-		if (dtEntries > 0) {
-			int maxbin = LEDDeltaT->GetMaximumBin();
-			LEDDeltaT->GetXaxis()->SetRange(maxbin-100,maxbin+100); // looks at +/- 0.1 seconds of max bin.
-			LEDrms = LEDDeltaT->GetRMS();
-			LEDfreq = 1/LEDDeltaT->GetMean();
-		}
-		else {
-			printf("Warning! No multiplicity > 20 events!!\n");
-			LEDrms = 9999;
-			LEDfreq = 9999;
-		}
-		double LEDperiod = 1/LEDfreq;
-		printf("Histo method: LED_f: %.8f LED_t: %.8f RMS: %8f\n",LEDfreq,LEDperiod,LEDrms);
-		delete LEDDeltaT;
-		if (LEDfreq != 9999 && vEntries > 100) {
-			runs.push_back(run);
-			freqs.push_back(LEDfreq);
-		}
-
-		// set a flag for "bad LED" (usually a short run causes it)
-		// and replace the period with the "simple" one if possible
+		double LEDperiod = 0;
 		bool badLEDFreq = false;
-		if (LEDperiod > 9 || vEntries < 100) 
+		auto finishMeasure = [&]()
 		{
-			printf("Warning: Short run.\n");
-			if (pureLEDcount > 3) {
-				printf("   From histo method, LED freq is %.2f.\n   Reverting to the approx rate (%.2fs) ... \n"
-					,LEDfreq,(double)pureLEDcount/duration);
-				LEDperiod = duration/pureLEDcount;
+			// Make sure the local vectors are all the same size
+			if ((LocalEntryNum.size() != LocalEntryTime.size()) || (LocalEntryNum.size() != LocalErrCountEntry.size()))
+			info.Log("Warning! Local vectors are not the same size!\n");
+
+			// if duration is corrupted, use the last good timestamp as the duration.
+			if (duration == 0) {
+				info.Log("Corrupted duration. Using last good timestamp: %.2f\n",lastGoodTime-first.GetTimeSec());
+				duration = lastGoodTime-first.GetTimeSec();
+				totDuration += duration;
+			}
+
+			// find the SBC offset		
+			SBCOffset = first.GetTimeSBC() - first.GetTimeSec();
+			info.first = first;
+			info.SBCOffset = SBCOffset;
+			info.Log("First good entry: %i  |  SBCOffset: %.2f  |  firstScalerTime: %lf  |  firstSBCTime: %lf  |  firstScalerIndex: %ld\n",firstGoodEntry,SBCOffset,first.GetTimeSec(),first.GetTimeSBC(),first.GetScalerIndex());
+
+			// find the LED frequency, set time window, 
+			info.Log("\"Simple\" LED count: %i.  Approx rate: %.3f\n",pureLEDcount,pureLEDcount/duration);
+			LEDrms = 0;
+			LEDfreq = 0;
+			int dtEntries = LEDDeltaT->GetEntries();
+			if (dtEntries > 0) {
+				int maxbin = LEDDeltaT->GetMaximumBin();
+				LEDDeltaT->GetXaxis()->SetRange(maxbin-100,maxbin+100); // looks at +/- 0.1 seconds of max bin.
+				LEDrms = LEDDeltaT->GetRMS();
+				LEDfreq = 1/LEDDeltaT->GetMean();
 			}
-			else { 
-				printf("   Warning: LED info is corrupted!  Will not use LED period information for this run.\n");
-				LEDperiod = 9999;
-				badLEDFreq = true;
+			else {
+				info.Log("Warning! No multiplicity > 20 events!!\n");
+				LEDrms = 9999;
+				LEDfreq = 9999;
+			}
+			LEDperiod = 1/LEDfreq;
+			info.Log("Histo method: LED_f: %.8f LED_t: %.8f RMS: %8f\n",LEDfreq,LEDperiod,LEDrms);
+			delete LEDDeltaT;
+			LEDDeltaT = NULL;
+			if (LEDfreq != 9999 && vEntries > 100) {
+				runs.push_back(run);
+				freqs.push_back(LEDfreq);
 			}
-		}
 
-		// add error counts to global totals
-		for (int q = 0; q < nErrs; q++) {
-			if (errorRunBools[q]) {
-				globalRunsWithErrors[q]++;
-				if (q == 1) printf("Missing Channels in run %d\n",run);
-				if (q == 6) printf("Duplicate Channels in run %d\n",run);
-				if (q == 7) printf("Hardware Count Mismatch in run %d\n",run);
-			}	
-			if (errorRunBeginningBools[q]) globalRunsWithErrorsAtBeginning[q]++;
-		}
-		
+			// set a flag for "bad LED" (usually a short run causes it)
+			// and replace the period with the "simple" one if possible
+			badLEDFreq = false;
+			if (LEDperiod > 9 || vEntries < 100) 
+			{
+				info.Log("Warning: Short run.\n");
+				if (pureLEDcount > 3) {
+					info.Log("   From histo method, LED freq is %.2f.\n   Reverting to the approx rate (%.2fs) ... \n"
+						,LEDfreq,(double)pureLEDcount/duration);
+					LEDperiod = duration/pureLEDcount;
+				}
+				else { 
+					info.Log("   Warning: LED info is corrupted!  Will not use LED period information for this run.\n");
+					LEDperiod = 9999;
+					badLEDFreq = true;
+				}
+			}
+
+			// add error counts to global totals
+			for (int q = 0; q < nErrs; q++) {
+				if (errorRunBools[q]) {
+					globalRunsWithErrors[q]++;
+					if (q == 1) info.Log("Missing Channels in run %d\n",run);
+					if (q == 6) info.Log("Duplicate Channels in run %d\n",run);
+					if (q == 7) info.Log("Hardware Count Mismatch in run %d\n",run);
+				}	
+				if (errorRunBeginningBools[q]) globalRunsWithErrorsAtBeginning[q]++;
+			}
+		};
+
 		// ====================== Second loop over entries =========================
 		//
 		double xTimePrev = 0;
-		if (start != 0) xTimePrev = (double)start;
-		else xTimePrev = first.GetTimeSec();
 		int TimeMethod = 0; //1 = scaler, 2 = SBC, 3 = interp
 		double STime = 0;
 		double STimePrev = 0;
@@ -362,17 +1121,14 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 		int SIndexPrev = 0;
 		double SBCTime = 0;
 		double TSdifference = 0;
-		prev.Clear();
-		
-		//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-		for (int i = 0; i < vEntries; i++)
+		VetoRing<2> history;
+		double dtLow = 0, dtHigh = 1e9;	// the largest delta-t under the high delta-t window, and the smallest over it
+	
+		// Returns false if a warm start doesn't hold for this entry.
+		auto scanEntry = [&](MJVetoEvent &veto, int i, int isGood) -> bool
 		{
-			// this time we don't skip anything until all the time information is found.
-			v->GetEntry(i);
-			MJVetoEvent veto;
-			veto.SetSWThresh(thresh);	
-	    	int isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);	// true: force-write event with errors.
-			
+			const VetoSnapshot &prev = history.Back();
+		
 	    	// find event time 
 			if (!veto.GetBadScaler()) {
 				xTime = veto.GetTimeSec();
@@ -380,29 +1136,24 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 				SIndex = veto.GetScalerIndex();
 				TimeMethod = 1;
 				if(run > 8557 && veto.GetTimeSBC() < 2000000000) SBCTime = (veto.GetTimeSBC() - SBCOffset);
-				
+			
 			}
+			else if (warm) return false;	// both methods below need the whole first loop
 			else if (run > 8557 && veto.GetTimeSBC() < 2000000000) {
 				xTime = veto.GetTimeSBC() - SBCOffset;
 				double interpTime = InterpTime(i,LocalEntryTime,LocalEntryNum,LocalBadScalers);
-				printf("Entry %i : SBC method: %.2f  Interp method: %.2f  sbc-interp: %.2f\n",i,xTime,interpTime,xTime-interpTime);
+				info.Log("Entry %i : SBC method: %.2f  Interp method: %.2f  sbc-interp: %.2f\n",i,xTime,interpTime,xTime-interpTime);
 				TimeMethod = 2;
 			}
 			else {
 				double eTime = ((double)i / vEntries) * duration;
 				xTime = InterpTime(i,LocalEntryTime,LocalEntryNum,LocalBadScalers);
-				printf("Entry %i : Entry method: %.2f  Interp method: %.2f  eTime-interp: %.2f\n",i,eTime,xTime,eTime-xTime);
+				info.Log("Entry %i : Entry method: %.2f  Interp method: %.2f  eTime-interp: %.2f\n",i,eTime,xTime,eTime-xTime);
 				TimeMethod = 3;
 			}
 			LocalEntryTime[i] = xTime;	// replace entry with the more accurate one
-					
-			if (i == firstGoodEntry && filesScanned > 1 && runs.back() - runs[runs.size()-2] == 1){ //if this run immediately follows the previous run, calculate the run gap
-				rungap = (first.GetTimeSBC()-SBCOffset) - (lastprevrun.GetTimeSBC()-PrevRunSBCOffset);
-				printf("[BETWEEN RUNS] difference in time: %f seconds  |  difference in SEC: %ld  |  difference in QEC: %ld  |  difference in QEC2: %ld\n",rungap,first.GetSEC()-lastprevrun.GetSEC(),first.GetQEC()-lastprevrun.GetQEC(),first.GetQEC2()-lastprevrun.GetQEC2());
-			if (rungap > 15) printf("Rungap > 15 seconds, buffer events might have problems. run: %d   |  previous run: %d  |  rungap: %f\n",run,(int)runs[runs.size()-2],rungap);
-			}	
-			
-			if (veto.GetError(1)) printf("QDC Channels < 32, missing packet. entry: %d  |  Scaler Index: %ld  |  Scaler Time: %f  |  SBC Time: %f\n",i,veto.GetScalerIndex(),veto.GetTimeSec(),veto.GetTimeSBC());
+				
+			if (veto.GetError(1)) info.Log("QDC Channels < 32, missing packet. entry: %d  |  Scaler Index: %ld  |  Scaler Time: %f  |  SBC Time: %f\n",i,veto.GetScalerIndex(),veto.GetTimeSec(),veto.GetTimeSBC());
 
 			// look at delta-t between events
 			double dt = xTime - xTimePrev;
@@ -410,74 +1161,64 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 			if (dt > 8) largedt++;
 			if (runBreakdowns) { 
 				deltaTRun->Fill(dt);
-				gMultipVsTimeRun->SetPoint(i,LocalEntryTime[i],veto.GetMultip());
-				if (!veto.GetBadScaler()) {
-					gSTimeVsfIndex->SetPoint(i,veto.GetScalerIndex(),veto.GetTimeSec());		
-				}
-				gEventCountScaler->SetPoint(i,xTime,veto.GetSEC());
-				gEventCountQDC1->SetPoint(i,xTime,veto.GetQEC());
-				gEventCountQDC2->SetPoint(i,xTime,veto.GetQEC2());
+				series->Add(xTime,veto.GetMultip(),veto.GetBadScaler(),veto.GetTimeSec(),
+					veto.GetScalerIndex(),veto.GetSEC(),veto.GetQEC(),veto.GetQEC2());
 			}
 			if (dt > LEDperiod + RMSTimeWindow && i > 0){
-				printf("High delta-T event: Entry %i, Prev %i.  dt = %.2f  xTime = %.2f (Method: %d) xTimePrev = %.2f  |  window: dt > %.2fs\n"
+				info.Log("High delta-T event: Entry %i, Prev %i.  dt = %.2f  xTime = %.2f (Method: %d) xTimePrev = %.2f  |  window: dt > %.2fs\n"
 					,i,i-1,dt,xTime,TimeMethod,xTimePrev,LEDperiod+RMSTimeWindow);
 				HighDTEvent.push_back(i-1);
 				HighDTEvent.push_back(i);
 				totHighDT++;
 				if (LocalBadScalers[i-1] == 1 || LocalBadScalers[i] == 1) totHighDTwBTS++;
 			}
-			
-			//track Event Count Changes/resets			
-			if (veto.GetSEC() == 0 && i != 0) {
-				printf("SEC reset found: Run: %d  |  entry: %d  |  SEC: %ld  |  prevSEC: %ld\n",run,i,veto.GetSEC(),prev.GetSEC());
+			if (i > 0) {
+				if (dt > LEDperiod + RMSTimeWindow) dtHigh = min(dtHigh,dt);
+				else dtLow = max(dtLow,dt);
+			}
+		
+			//track Event Count Changes/resets (found by the counter check, code/CounterCheck.hh)
+			unsigned counts = counters.Flags(i);
+			if (counts & CounterCheck::kSECReset) {
+				info.Log("SEC reset found: Run: %d  |  entry: %d  |  SEC: %ld  |  prevSEC: %ld\n",run,i,veto.GetSEC(),prev.GetSEC());
 				SECReset = true;
-				SECResetCount++;
 			}
 			else SECReset = false;
-			
-			if (veto.GetQEC() == 0 && i != 0){
-				printf("QEC1 reset found: Run: %d  |  entry: %d  |  Index: %ld  |  QEC1: %ld  |  prevQEC1: %ld\n",run,i,veto.GetScalerIndex(),veto.GetQEC(),prev.GetQEC());
-				QECReset01count++;
-			}
+		
+			if (counts & CounterCheck::kQEC1Reset)
+				info.Log("QEC1 reset found: Run: %d  |  entry: %d  |  Index: %ld  |  QEC1: %ld  |  prevQEC1: %ld\n",run,i,veto.GetScalerIndex(),veto.GetQEC(),prev.GetQEC());
 			else QECReset01 = false;
-			
-			if (veto.GetQEC2() == 0 && i != 0){
-				printf("QEC2 reset found: Run: %d  |  entry: %d  |  Index: %ld  |  QEC2: %ld  |  prevQEC2: %ld\n",run,i,veto.GetScalerIndex(),veto.GetQEC2(),prev.GetQEC2());
-				QECReset02count++;
-			}
+		
+			if (counts & CounterCheck::kQEC2Reset)
+				info.Log("QEC2 reset found: Run: %d  |  entry: %d  |  Index: %ld  |  QEC2: %ld  |  prevQEC2: %ld\n",run,i,veto.GetScalerIndex(),veto.GetQEC2(),prev.GetQEC2());
 			else QECReset02 = false;
-			
-			if(abs(veto.GetSEC() - prev.GetSEC()) > 1 && i > firstGoodEntry) {
-				printf("SEC Change found!!:  entry: %d  |  xTime: %f  |  Index: %ld  |  SEC: %ld  |  prevSEC: %ld\n", i,xTime,veto.GetScalerIndex(),veto.GetSEC(),prev.GetSEC()); 
-				SECChangeCount++;
-			}
-			
-			if(abs(veto.GetQEC() - prev.GetQEC()) > 1 && i > firstGoodEntry) {
-				printf("QEC1 Change found!!:  entry: %d  |  xTime: %f  |  Index: %ld  |  QEC1: %ld  |  prevQEC1: %ld\n", i,xTime,veto.GetQDC1Index(),veto.GetQEC(),prev.GetQEC()); 
-				QEC1ChangeCount++;
-			}
-			
-			if(abs(veto.GetQEC2() - prev.GetQEC2()) > 1 && i > firstGoodEntry) {
-				printf("QEC2 Change found!!:  entry: %d  |  xTime: %f  |  Index: %ld  |  QEC2: %ld  |  prevQEC2: %ld\n", i,xTime,veto.GetQDC2Index(),veto.GetQEC2(),prev.GetQEC2()); 
-				QEC2ChangeCount++;
-			}
-			
+		
+			if (counts & CounterCheck::kSECJump)
+				info.Log("SEC Change found!!:  entry: %d  |  xTime: %f  |  Index: %ld  |  SEC: %ld  |  prevSEC: %ld\n", i,xTime,veto.GetScalerIndex(),veto.GetSEC(),prev.GetSEC()); 
+		
+			if (counts & CounterCheck::kQEC1Jump)
+				info.Log("QEC1 Change found!!:  entry: %d  |  xTime: %f  |  Index: %ld  |  QEC1: %ld  |  prevQEC1: %ld\n", i,xTime,veto.GetQDC1Index(),veto.GetQEC(),prev.GetQEC()); 
+		
+			if (counts & CounterCheck::kQEC2Jump)
+				info.Log("QEC2 Change found!!:  entry: %d  |  xTime: %f  |  Index: %ld  |  QEC2: %ld  |  prevQEC2: %ld\n", i,xTime,veto.GetQDC2Index(),veto.GetQEC2(),prev.GetQEC2()); 
+		
 			if (STime != 0 && SBCTime !=0 && SBCOffset != 0){
 				//removed from 453: fabs(STime - SBCTime) > 1 && 
 				if(fabs(fabs(STime - SBCTime) - TSdifference) > 1 ){ //TSdifference will allow us to locate only the FIRST entries where timestamps get out of sync
 					SJSBCCount++;
 					localSJSBCcount++;
 					TSdifference = STime - SBCTime;
-					printf("SBC Scaler Jump found!!! Run: %d  |  Entry: %d  |  DeltaT: %f  |  Scaler DeltaT: %f  |  ScalerIndex: %d  |  PrevScalerIndex: %d  |  (rough)LED count: %f\n|  ScalerTime: %f  |  SBCTime: %f  | SECReset?: %d  |  QECReset01?: %d  |  QECReset02?: %d\n",run,i,fabs(STime-SBCTime),fabs(STime-STimePrev),SIndex,SIndexPrev,(STime-first.GetTimeSec())/LEDperiod,STime,SBCTime,SECReset,QECReset01,QECReset02); 
+					acc.ScalerJumpTime->Fill(STime);
+					info.Log("SBC Scaler Jump found!!! Run: %d  |  Entry: %d  |  DeltaT: %f  |  Scaler DeltaT: %f  |  ScalerIndex: %d  |  PrevScalerIndex: %d  |  (rough)LED count: %f\n|  ScalerTime: %f  |  SBCTime: %f  | SECReset?: %d  |  QECReset01?: %d  |  QECReset02?: %d\n",run,i,fabs(STime-SBCTime),fabs(STime-STimePrev),SIndex,SIndexPrev,(STime-first.GetTimeSec())/LEDperiod,STime,SBCTime,SECReset,QECReset01,QECReset02); 
 				}	
 			}
-	
+
 			if (i == vEntries-1) {
-				printf("run %d last event-> Start Time: %ld  |  Stop Time: %ld  |  Scaler Time: %f  |  SBC Time: %f  |  LED estimated duration: %f (# of LEDs: %d  Period: %f)\n",run,start,stop,STime,SBCTime,pureLEDcount*LEDperiod, pureLEDcount,LEDperiod);
-				printf("Scaler/SBC duration difference: %f\n",STime - SBCTime);
-				if (STime - SBCTime > 4 && SBCOffset != 0) printf("Found Scaler/SBC duration conflict!\n");
+				info.Log("run %d last event-> Start Time: %ld  |  Stop Time: %ld  |  Scaler Time: %f  |  SBC Time: %f  |  LED estimated duration: %f (# of LEDs: %d  Period: %f)\n",run,start,stop,STime,SBCTime,pureLEDcount*LEDperiod, pureLEDcount,LEDperiod);
+				info.Log("Scaler/SBC duration difference: %f\n",STime - SBCTime);
+				if (STime - SBCTime > 4 && SBCOffset != 0) info.Log("Found Scaler/SBC duration conflict!\n");
 			}
-			
+		
 			// save previous xTime
 			xTimePrev = xTime;
 			STimePrev = STime;
@@ -485,52 +1226,113 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 			STime = 0;
 			SBCTime = 0;
 			SIndex = 0;
-			
-			// skip bad entries (true = print contents of skipped event)
-	    	if (CheckForBadErrors(veto,i,isGood,false)) continue;
+		
+			// skip bad entries (already counted in the first loop)
+	    	if (GetErrorPolicy().IsFatal(isGood)) return true;
 
 			// fill energy/multiplicity histos
 	    	TotalEnergy->Fill(veto.GetTotE());
 	    	TotalMultip->Fill(veto.GetMultip());
 			QDC_over_Multip->Fill(veto.GetTotE()/(double)veto.GetMultip());	    	
-	    	
-	    	for (int j = 0; j < 32; j++) { 
-	    		hRawQDC[j]->Fill(veto.GetQDC(j));
+    	
+	    	int qdc[32];
+	    	for (int j = 0; j < 32; j++) qdc[j] = veto.GetQDC(j);
+	    	hRawQDC.Push(qdc);
+			if (veto.GetMultip() > 20) {
+				for (int j = 0; j < 32; j++)
+					if (qdc[j] >= veto.GetSWThresh(j)) ledQDC[j].Fill(qdc[j]);
 			}
 			if (veto.GetMultip() <= 20) 
 				TotalEnergyNoLED->Fill(veto.GetTotE());
-			
+		
 			if (veto.GetMultip() < highestMultip-5 && veto.GetMultip() > 8){
-				
-				printf("Found event with multiplicity > 8 and < highestMultip ... Multip: %i  Entry: %i\n",veto.GetMultip(),i);
+			
+				info.Log("Found event with multiplicity > 8 and < highestMultip ... Multip: %i  Entry: %i\n",veto.GetMultip(),i);
 				if (!FirstHighMultip){
-					printf("First Strange Multip Event: Entry %d\n",(int)LocalEntryNum[i]);
-					veto.Print();
+					info.Log("First Strange Multip Event: Entry %d\n",(int)LocalEntryNum[i]);
+					info.LogEvent(veto,i);
 					FirstHighMultip =  true;
 				}	
 			}
-			
+		
 			// end of loop : save things
-			prev = veto;
+			history.Push(veto,isGood,i);
 			if (i == vEntries-1){
-				last = veto;
-				PrevRunSBCOffset = SBCOffset;
-				lastprevrun = last;
-			}	
-			veto.Clear();
-		}		
-		
-		cout << "=================== End Run " << run << ". =====================\n";
+				last = history.Back();
+				info.last = last;
+				info.hasLast = true;
+			}
+			return true;
+		};
+	
+		//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+		if (!warm)
+		{
+			finishMeasure();
+			highestMultip = measuredMultip;
+			counters.CheckChanges(0,vEntries,firstGoodEntry);
+			xTimePrev = first.GetTimeSec();
+			for (int i = 0; i < vEntries; i++)
+			{
+				// this time we don't skip anything until all the time information is found.
+				v->GetEntry(i);
+				veto.Clear();
+				veto.SetSWThresh(thresh);	
+		    	int isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);	// true: force-write event with errors.
+				scanEntry(veto,i,isGood);
+			}
+		}
+		else
+		{
+			// both loops in one pass, with the last run's values
+			SBCOffset = first.GetTimeSBC() - first.GetTimeSec();
+			highestMultip = state.highestMultip;
+			LEDperiod = state.LEDperiod;
+			info.Log("Starting from run %d after %i of %li entries.  Panels: %d  LED period: %.4f\n",state.run,measured,vEntries,highestMultip,LEDperiod);
+			xTimePrev = first.GetTimeSec();
+			bool held = true;
+			for (int i = 0; i < vEntries && held; i++)
+			{
+				v->GetEntry(i);
+				veto.Clear();
+				veto.SetSWThresh(thresh);	
+		    	int isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);
+				if (i >= measured) measure(veto,i,isGood);
+				counters.CheckChanges(i,i+1,firstGoodEntry);
+				held = scanEntry(veto,i,isGood);
+			}
+			if (held) {
+				finishMeasure();
+				held = (measuredMultip == highestMultip && dtLow <= LEDperiod + RMSTimeWindow && dtHigh > LEDperiod + RMSTimeWindow);
+			}
+			if (!held) {
+				delete LEDDeltaT;
+				delete deltaTRun;
+				gatLock.lock();
+				delete ds;
+				gatLock.unlock();
+				return false;
+			}
+		}
+		hRawQDC.Flush();
+		SECResetCount += counters.Count(CounterCheck::kSECReset);
+		QECReset01count += counters.Count(CounterCheck::kQEC1Reset);
+		QECReset02count += counters.Count(CounterCheck::kQEC2Reset);
+		SECChangeCount += counters.Count(CounterCheck::kSECJump);
+		QEC1ChangeCount += counters.Count(CounterCheck::kQEC1Jump);
+		QEC2ChangeCount += counters.Count(CounterCheck::kQEC2Jump);
+
+		info.Log("=================== End Run %d. =====================\n",run);
 		for (int i = 0; i < nErrs; i++) {
 			if (errorCount[i] > 0) {
-				printf("%i: %i errors\t(%.2f%% of total)\n",i,errorCount[i],100*(double)errorCount[i]/vEntries);
+				info.Log("%i: %i errors\t(%.2f%% of total)\n",i,errorCount[i],100*(double)errorCount[i]/vEntries);
 				globalErrorCount[i] += errorCount[i];
 			}
 		}
-		printf("Number of SBC-Scaler mismatches  (possible scaler jumps) this run: %d\n",localSJSBCcount);
-		printf("Number of large DT this run: %d\n",largedt);
-		printf("[FIRST EVENT] Run: %d  |  firstSEC: %ld  |  firstQEC: %ld  |  firstQEC2: %ld  |  firstScalerTime: %f  |  firstSBCTime: %f  |  Scaler Index: %ld  |  vEntries: %ld\n",run,first.GetSEC(),first.GetQEC(),first.GetQEC2(),first.GetTimeSec(),first.GetTimeSBC()-SBCOffset,first.GetScalerIndex(),vEntries);
-		printf("[LAST EVENT] Run: %d  |  LastSEC: %ld  |  LastQEC: %ld  |  LastQEC2: %ld  |  LastScalerTime: %f  |  LastSBCTime: %f  |  Scaler Index: %ld  |  vEntries: %ld\n",run,last.GetSEC(),last.GetQEC(),last.GetQEC2(),last.GetTimeSec(),last.GetTimeSBC()-SBCOffset,last.GetScalerIndex(),vEntries);
+		info.Log("Number of SBC-Scaler mismatches  (possible scaler jumps) this run: %d\n",localSJSBCcount);
+		info.Log("Number of large DT this run: %d\n",largedt);
+		info.Log("[FIRST EVENT] Run: %d  |  firstSEC: %ld  |  firstQEC: %ld  |  firstQEC2: %ld  |  firstScalerTime: %f  |  firstSBCTime: %f  |  Scaler Index: %ld  |  vEntries: %ld\n",run,first.GetSEC(),first.GetQEC(),first.GetQEC2(),first.GetTimeSec(),first.GetTimeSBC()-SBCOffset,first.GetScalerIndex(),vEntries);
+		info.Log("[LAST EVENT] Run: %d  |  LastSEC: %ld  |  LastQEC: %ld  |  LastQEC2: %ld  |  LastScalerTime: %f  |  LastSBCTime: %f  |  Scaler Index: %ld  |  vEntries: %ld\n",run,last.GetSEC(),last.GetQEC(),last.GetQEC2(),last.GetTimeSec(),last.GetTimeSBC()-SBCOffset,last.GetScalerIndex(),vEntries);
 
 		// end of run cleanup
 		LocalBadScalers.clear();
@@ -540,177 +1342,197 @@ void vetoPerformance(string Input, int *thresh, bool runBreakdowns)
 		HighDTEvent.clear();
 		if (runBreakdowns) 
 		{
-			RootFile->cd("runPlots");
 			sprintf(hname,"%d_deltaT", run);
-			deltaTRun->Write(hname,TObject::kOverwrite); 
-
-			sprintf(hname,"%d_MultipVsTime", run);
-			gMultipVsTimeRun->SetMarkerColor(4);
-			gMultipVsTimeRun->SetMarkerStyle(21);
-			gMultipVsTimeRun->SetMarkerSize(0.5);
-			gMultipVsTimeRun->SetLineColorAlpha(kWhite,0);
-			gMultipVsTimeRun->Write(hname,TObject::kOverwrite);
-			
-			sprintf(hname,"%d_STimeVsfIndex", run);
-			gSTimeVsfIndex->GetXaxis()->SetTitle("Scaler Index");
-			gSTimeVsfIndex->GetYaxis()->SetTitle("Scaler Time (sec)");
-			gSTimeVsfIndex->SetMarkerColor(4);
-			gSTimeVsfIndex->SetMarkerStyle(21);
-			gSTimeVsfIndex->SetMarkerSize(0.5);
-			gSTimeVsfIndex->SetLineColorAlpha(kWhite,0);
-			gSTimeVsfIndex->Write(hname,TObject::kOverwrite);
-			
-			sprintf(hname,"%d_LEDTSVsLEDcount", run);
-			gLEDTSVsLEDCount->GetXaxis()->SetTitle("LED count");
-			gLEDTSVsLEDCount->GetYaxis()->SetTitle("LED Event Scaler Time (sec)");
-			gLEDTSVsLEDCount->SetMarkerColor(4);
-			gLEDTSVsLEDCount->SetMarkerStyle(21);
-			gLEDTSVsLEDCount->SetMarkerSize(0.5);
-			gLEDTSVsLEDCount->SetLineColorAlpha(kWhite,0);
-			gLEDTSVsLEDCount->Write(hname,TObject::kOverwrite);
-			
-			sprintf(hname,"%d_EventCountScaler", run);
-			gEventCountScaler->SetMarkerStyle(20);
-			gEventCountScaler->SetMarkerColor(2);
-			gEventCountScaler->SetLineColorAlpha(kWhite,0);
-			gEventCountScaler->Write(hname,TObject::kOverwrite);
-			
-			sprintf(hname,"%d_EventCountQDC1", run);
-			gEventCountQDC1->SetMarkerStyle(21);
-			gEventCountQDC1->SetMarkerColor(4);
-			gEventCountQDC1->SetLineColorAlpha(kWhite,0);
-			gEventCountQDC1->Write(hname,TObject::kOverwrite);
-			
-			sprintf(hname,"%d_EventCountQDC2", run);
-			gEventCountQDC2->SetMarkerStyle(22);
-			gEventCountQDC2->SetMarkerColor(6);
-			gEventCountQDC2->SetLineColorAlpha(kWhite,0);
-			gEventCountQDC2->Write(hname,TObject::kOverwrite);	
-
-			delete deltaTRun;
-			delete gMultipVsTimeRun;
-			delete gSTimeVsfIndex;
-			delete gEventCountScaler;
-			delete gEventCountQDC1;
-			delete gEventCountQDC2;
-			RootFile->cd();
+			info.plots.push_back(make_pair((TObject*)deltaTRun,string(hname)));
 		}	
-	}
-	
-	for (int i = 0; i < (int)ErrCountEntry.size(); i++){
-		if (ErrCountEntry[i] > 2) TimestampBadEntry->Fill(EntryTime[i]);
-	}
-	
-	cout << "\n\n================= END OF SCAN. =====================\n";
-	printf("%i runs, %li total events, total duration: %ld seconds.\n",filesScanned,totEntries,totDuration);
 
-	// check for errors and print summary if we find them.
-	bool foundErrors = false;
-	for (int i = 0; i < nErrs; i++) { 
-		if (globalErrorCount[i] > 0) {
-			foundErrors = true; 
-			break;
+		gatLock.lock();
+		delete ds;
+		gatLock.unlock();
+
+		// LED peak positions for this run.  The store is sorted and plotted
+		// by start time: without one in the run header, use the SBC clock's
+		// time at the scaler's zero.
+		long peakStart = (runStart != 0) ? runStart : (long)SBCOffset;
+		if (peakStart == 0) info.Log("Run %d has no start time.  Its LED peaks won't be plotted.\n",run);
+		for (int j = 0; j < 32; j++) {
+			LEDPeak pk;
+			pk.run = run;
+			pk.start = peakStart;
+			pk.panel = j;
+			FitLEDPeak(ledQDC[j],pk);
+			info.ledPeaks.push_back(pk);
 		}
-	}
 
-	if (foundErrors) 
+		// run summary: run, entries, good entries, duration, LED freq, high-dt events, SBC jumps, error counts 1-17
+		char sumLine[500];
+		int pos = sprintf(sumLine,"%i %li %i %.0f %.4f %i %i",run,vEntries,totGoodEntries-runGoodEntries,
+			duration,LEDfreq,totHighDT-runHighDT,localSJSBCcount);
+		for (int i = 1; i < nErrs; i++) pos += sprintf(sumLine+pos," %i",errorCount[i]);
+		info.summary = sumLine;
+
+		// the next run starts from this one
+		state.Set(run,runStart,highestMultip,badLEDFreq ? 0 : LEDperiod,LEDrms,SBCOffset);
+		return true;
+	};
+
+	// Scan a run, starting from state if it can, and leave this run's in it.
+	// If the warm start doesn't hold, the run is scanned again into new accumulators.
+	auto scanWarm = [&](int run, VPAccumulator *&acc, VPRunInfo *&info, RunState &state)
 	{
-		printf("\nError summary:\n");
-		for (int i = 0; i < nErrs; i++) 
-		{
-			if (globalErrorCount[i] > 0) 
-			{
-				foundErrors = true;
-				printf("%i: %i events\t(%.2f%%)\t"
-					,i,globalErrorCount[i],100*(double)globalErrorCount[i]/totEntries);
-				printf("%i runs\t(%.2f%%)\n"
-					,globalRunsWithErrors[i],100*(double)globalRunsWithErrors[i]/filesScanned);
-			}
-		}
-		if (totHighDT>0) printf("High-DeltaT Events: %i  High DT Events with BadScaler: %i\n\n",totHighDT,totHighDTwBTS);
-		printf("Number of SBC/Scaler Jumps: %d\n",SJSBCCount);
-		printf("%li total events, %i total Good Events, %i LED events, %i nonLED events\n",totEntries,totGoodEntries,totLED,totnonLED);
-		printf("SECReset: %d  |  QECReset01: %d  |  QECReset02: %d\n",SECResetCount,QECReset01count,QECReset02count);
-		printf("SECChangeCount: %d  |  QEC1ChangeCount: %d  |  QEC2ChangeCount: %d\n",SECChangeCount,QEC1ChangeCount,QEC2ChangeCount);
-		
-		printf("\nBeginning of runs (i < 10) error summary:\n");
-		for (int i = 0; i < nErrs; i++) 
+		acc = new VPAccumulator(true);
+		info = new VPRunInfo();
+		if (scanRun(run,*acc,*info,state)) return;
+		delete acc;
+		delete info;
+		acc = new VPAccumulator(true);
+		info = new VPRunInfo();
+		info->Log("Run %d didn't hold to run %d's values.  Scanning it again.\n",run,state.run);
+		state.Clear();
+		scanRun(run,*acc,*info,state);
+	};
+
+	// ============ merge a run into the totals (always called in run order) ============
+	// The run's info goes to the writer, which deletes it.
+	//
+	auto reduceRun = [&](int run, VPAccumulator &acc, VPRunInfo *runInfo)
+	{
+		VPRunInfo &info = *runInfo;
+		cout << info.log;
+		info.log.clear();
+		GetErrorPolicy().Add(info.errors);
+		filesScanned++;
+		tot.Merge(acc);
+
+		//if this run immediately follows the previous run, calculate the run gap
+		VetoSnapshot &first = info.first;
+		if (info.vEntries > 0 && filesScanned > 1 && runs.size() > 1 && runs.back() - runs[runs.size()-2] == 1) {
+			rungap = (first.GetTimeSBC()-info.SBCOffset) - (lastprevrun.GetTimeSBC()-PrevRunSBCOffset);
+			printf("[BETWEEN RUNS] run %d  |  difference in time: %f seconds  |  difference in SEC: %ld  |  difference in QEC: %ld  |  difference in QEC2: %ld\n",run,rungap,first.GetSEC()-lastprevrun.GetSEC(),first.GetQEC()-lastprevrun.GetQEC(),first.GetQEC2()-lastprevrun.GetQEC2());
+			if (rungap > 15) printf("Rungap > 15 seconds, buffer events might have problems. run: %d   |  previous run: %d  |  rungap: %f\n",run,(int)runs[runs.size()-2],rungap);
+		}
+		if (info.hasLast) {
+			lastprevrun = info.last;
+			PrevRunSBCOffset = info.SBCOffset;
+		}
+
+		VPOutput &o = writer.Next();
+		o.run = run;
+		o.info = runInfo;
+		o.scalars.clear();
+		if (follow == NULL) snapshot(o);
+
+		// keep the ROOT file current when following
+		if (follow != NULL) {
+			writer.Flush();
+			writeGlobal();
+		}
+		else writer.Send();
+	};
+
+	// ==========================loop over input files==========================
+	//
+	int run = 0;
+	if (resuming) {
+		int skipped = 0;
+		while (skipped < filesScanned && nextRun(run)) skipped++;
+		printf("Skipped %i runs, continuing after run %i.\n",skipped,run);
+	}
+	if (follow != NULL) {
+		// runs come in one at a time, each starting from the one before
+		RunState last;
+		while (nextRun(run)) {
+			VPAccumulator *acc;
+			VPRunInfo *info;
+			scanWarm(run,acc,info,last);
+			reduceRun(run,*acc,info);
+			delete acc;
+		}
+	}
+	else {
+		// Scan runs in parallel.  Whenever the next run in order is finished,
+		// it's merged, so only the runs that finished early wait in memory.
+		// A run starts from the run before it if that one's already merged, and
+		// cold otherwise, so it never starts from a run further back.
+		vector<int> runList;
+		while (nextRun(run)) runList.push_back(run);
+		int nRuns = (int)runList.size();
+		vector<VPAccumulator*> accs(nRuns,(VPAccumulator*)NULL);
+		vector<VPRunInfo*> infos(nRuns,(VPRunInfo*)NULL);
+		vector<RunState> states(nRuns);
+		int nextReduce = 0;
+		mutex reduceLock;
+		if (GetNumThreads() > 1 && nRuns > 1) printf("Scanning %i runs with %i threads.\n",nRuns,min(nRuns,GetNumThreads()));
+		RunParallel(nRuns, [&](int j)
 		{
-			if (globalErrorAtBeginningCount[i] > 0) 
-			{
-				printf("%i: %i events\t (%.2f%%)\t",
-					i,globalErrorAtBeginningCount[i],100*(double)globalErrorAtBeginningCount[i]/totEntries);
-				printf("%i runs\t(%.2f%%)\n",
-					globalRunsWithErrorsAtBeginning[i],100*(double)globalRunsWithErrorsAtBeginning[i]/filesScanned);
-			}
-		}
-		printf("\nFor reference, error types are:\n");
-		cout << "1. Missing channels (< 32 veto datas in event) " << endl;
-		cout << "2. Extra Channels (> 32 veto datas in event) " << endl; 
-		cout << "3. Scaler only (no QDC data) " << endl;
-		cout << "4. Bad Timestamp: FFFF FFFF FFFF FFFF " << endl;
-		cout << "5. QDCIndex - ScalerIndex != 1 or 2 " << endl;
-		cout << "6. Duplicate channels (channel shows up multiple times) " << endl;
-		cout << "7. HW Count Mismatch (SEC - QEC != 1 or 2) " << endl;
-		cout << "8. MJTRun run number doesn't match input file" << endl;
-		cout << "9. MJTVetoData cast failed (missing QDC data)" << endl;
-		cout << "10. Scaler EventCount doesn't match ROOT entry" << endl;
-		cout << "11. Scaler EventCount doesn't match QDC1 EventCount" << endl;
-		cout << "12. QDC1 EventCount doesn't match QDC2 EventCount" << endl;
-		cout << "13. Indexes of QDC1 and Scaler differ by more than 2" << endl;
-		cout << "14. Indexes of QDC2 and Scaler differ by more than 2" << endl;
-		cout << "15. Indexes of either QDC1 or QDC2 PRECEDE the scaler index" << endl;
-		cout << "16. Indexes of either QDC1 or QDC2 EQUAL the scaler index" << endl;
-		cout << "17. Unknown Card is present." << endl;
+			RunState state;
+			reduceLock.lock();
+			if (j > 0 && nextReduce >= j) state = states[j-1];
+			reduceLock.unlock();
+			VPAccumulator *acc;
+			VPRunInfo *info;
+			scanWarm(runList[j],acc,info,state);
+
+			lock_guard<mutex> lock(reduceLock);
+			states[j] = state;
+			accs[j] = acc;
+			infos[j] = info;
+			while (nextReduce < nRuns && accs[nextReduce] != NULL) {
+				reduceRun(runList[nextReduce],*accs[nextReduce],infos[nextReduce]);
+				delete accs[nextReduce];
+				infos[nextReduce] = NULL;
+				nextReduce++;
+			}
+		});
 	}
 	
-	// write global plots
-	gRunVsLEDFreq = new TGraph(runs.size(),&(runs[0]),&(freqs[0]));
-	gRunVsLEDFreq->SetTitle("LED Frequency vs Run Number");
-	gRunVsLEDFreq->GetXaxis()->SetTitle("Run Number");
-	gRunVsLEDFreq->GetYaxis()->SetTitle("LED Freq (Hz)");
-	gRunVsLEDFreq->SetMarkerColor(4);
-	gRunVsLEDFreq->SetMarkerStyle(21);
-	gRunVsLEDFreq->SetMarkerSize(0.5);
-	gRunVsLEDFreq->SetLineColorAlpha(kWhite,0);
-	gRunVsLEDFreq->Write("RunVsLEDFreq",TObject::kOverwrite);
-	
-	gErrorCountEntryVsTime = new TGraph(EntryTime.size(),&(EntryTime[0]),&(ErrCountEntry[0]));
-	gErrorCountEntryVsTime->SetTitle("Error Count Vs Entry Time");
-	gErrorCountEntryVsTime->GetXaxis()->SetTitle("Entry Time (sec)");
-	gErrorCountEntryVsTime->GetYaxis()->SetTitle("Error Count");
-	gErrorCountEntryVsTime->SetMarkerColor(4);
-	gErrorCountEntryVsTime->SetMarkerStyle(21);
-	gErrorCountEntryVsTime->SetMarkerSize(0.5);
-	gErrorCountEntryVsTime->SetLineColorAlpha(kWhite,0);
-	gErrorCountEntryVsTime->Write("ErrorCountEntryVsTime",TObject::kOverwrite);
-	
-	gErrorCountEntryVsEntryNum = new TGraph(EntryNum.size(),&(EntryNum[0]),&(ErrCountEntry[0]));
-	gErrorCountEntryVsEntryNum->SetTitle("Error Count vs Entry Number");
-	gErrorCountEntryVsEntryNum->GetXaxis()->SetTitle("Entry Number");
-	gErrorCountEntryVsEntryNum->GetYaxis()->SetTitle("Error Count");
-	gErrorCountEntryVsEntryNum->SetMarkerColor(4);
-	gErrorCountEntryVsEntryNum->SetMarkerStyle(21);
-	gErrorCountEntryVsEntryNum->SetMarkerSize(0.5);
-	gErrorCountEntryVsEntryNum->SetLineColorAlpha(kWhite,0);
-	gErrorCountEntryVsEntryNum->Write("ErrorCountEntryVsEntryNum",TObject::kOverwrite);
-
-	TotalMultip->Write("TotalMultip",TObject::kOverwrite);
-	TotalEnergy->Write("TotalEnergy",TObject::kOverwrite);
-	TotalEnergyNoLED->Write("TotalEnergyNoLED",TObject::kOverwrite);
-	QDC_over_Multip->Write("QDC_over_Multip",TObject::kOverwrite);
-	TimestampBadEntry->Write("TimestampBadEntry",TObject::kOverwrite);
+	writer.Close();
 
-	
-	deltaT->Write("deltaT",TObject::kOverwrite);
+	cout << "\n\n================= END OF SCAN. =====================\n";
+	tot.PrintSummary(filesScanned);
 
-	RootFile->cd("rawQDC");
-	for (int i=0;i<32;i++)
-	{	
-		sprintf(hname,"hRawQDC%d",i);
-		hRawQDC[i]->Write(hname,TObject::kOverwrite);
-	}
+	// write global plots
+	writeGlobal();
 	
 	RootFile->Close();
+	RunSummary.close();
+	fclose(LEDCal);
+	printf("LED peak calibration: %s\n",calName.c_str());
+	if (follow == NULL) remove(ckptName.c_str());
 	cout << "\nWrote ROOT file." << endl;
-}
\ No newline at end of file
+}
+
+// The error summary of a merged VP file (vetoScan --merge).
+void vetoPerformanceMerge(string file)
+{
+	TFile *f = TFile::Open(file.c_str());
+	if (f == NULL) {
+		cout << "Couldn't open " << file << endl;
+		return;
+	}
+	TH1D *totals = NULL;
+	f->GetObject("ScanTotals",totals);
+	if (totals == NULL) {
+		cout << "No ScanTotals in " << file << endl;
+		f->Close();
+		return;
+	}
+	VPAccumulator tot(true);
+	int filesScanned = tot.SetTotals(totals);
+	TTree *worstTree = NULL;
+	f->GetObject("WorstEntries",worstTree);
+	if (worstTree != NULL) {
+		VPBadEntry e;
+		worstTree->SetBranchAddress("run",&e.run);
+		worstTree->SetBranchAddress("entry",&e.entry);
+		worstTree->SetBranchAddress("errors",&e.errors);
+		worstTree->SetBranchAddress("time",&e.time);
+		for (long i = 0; i < worstTree->GetEntries(); i++) {
+			worstTree->GetEntry(i);
+			tot.AddBad(e);
+		}
+	}
+	printf("\n================= %s =====================\n",file.c_str());
+	tot.PrintSummary(filesScanned);
+	f->Close();
+}
@@ -0,0 +1,345 @@
+// Sharded scans for batch arrays.
+// Clint Wiseman, USC/Majorana
+//
+// vetoScan --shard i/N scans the i'th of N pieces (i = 0 ... N-1) of the -F list.
+// The pieces are contiguous blocks of the list, cut where the running total
+// of veto entries passes k/N of the whole, so each job gets about the same
+// amount of data and neighbouring runs stay together.  (muFinder's run-gap
+// flags and vetoPerformance's between-run checks only break at the N-1 cuts,
+// the same as with the hand-split DS0_01..05 lists.)
+//
+// The entry counts and the cuts are kept in ./output/<Name>_shardplan.txt:
+//   # <N> shards of <Input>
+//   run entries shard
+// Every job reads the same plan, so the partition doesn't depend on which
+// job starts first.  Make it once before submitting (vetoScan -F list --shard N),
+// otherwise each job counts the entries itself and writes the same file.
+// If the list or N changes, the plan is redone (known entry counts are kept).
+//
+// Shard i's run list is ./output/<Name>_shard<i>of<N>.txt, so everything it
+// writes is named after <Name>_shard<i>of<N>.  vetoScan --merge finds those
+// and writes the files a full scan would have:
+//   .root   added with TFileMerger (histograms add, trees and graphs append)
+//   .txt    joined in shard order, repeated comment lines dropped
+// and then redoes the results for the whole data set: vetoPerformance's
+// error summary, and vetoThreshFinder's thresholds.
+//
+// vetoScan --launch N runs the N shards as local processes, and merges
+// them when they're all done.  Logs: ./output/<Name>_shard<i>of<N>.log
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <map>
+#include <algorithm>
+#include <cctype>
+#include "TFileMerger.h"
+#include "vetoScan.hh"
+#include "code/RunSet.hh"
+
+using namespace std;
+
+static string ShardStem(string Name, int shard, int nShards)
+{
+	char buf[300];
+	sprintf(buf,"%s_shard%iof%i",Name.c_str(),shard,nShards);
+	return buf;
+}
+
+static string ShardPlanName(string Input)
+{
+	string Name = Input;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
+	return "./output/"+Name+"_shardplan.txt";
+}
+
+// Read a plan: returns N (0 if there isn't one).
+static int ReadShardPlan(string planName, map<int,long> &entries, map<int,int> &shard)
+{
+	ifstream Plan(planName.c_str());
+	if (!Plan.good()) return 0;
+	int nShards = 0;
+	string line;
+	while (getline(Plan,line))
+	{
+		if (line.empty()) continue;
+		if (line[0] == '#') {
+			if (nShards == 0) sscanf(line.c_str(),"# %i shards",&nShards);
+			continue;
+		}
+		int run = 0, s = -1;
+		long n = 0;
+		if (sscanf(line.c_str(),"%i %li %i",&run,&n,&s) < 2) continue;
+		entries[run] = n;
+		shard[run] = s;
+	}
+	return nShards;
+}
+
+// The shard of each run in the list, in list order.
+// Uses the saved plan if it's for this list and N, and makes it otherwise.
+static bool GetShardPlan(string Input, int nShards, vector<int> &runs, vector<int> &shard)
+{
+	RunSet runSet;
+	if (!runSet.Load(Input)) return false;
+	runs.assign(runSet.begin(),runSet.end());
+	if (runs.size() == 0) {
+		cout << "No runs in " << Input << endl;
+		return false;
+	}
+
+	string planName = ShardPlanName(Input);
+	map<int,long> entries;
+	map<int,int> saved;
+	int savedShards = ReadShardPlan(planName,entries,saved);
+	bool same = (savedShards == nShards && saved.size() == runs.size());
+	for (size_t j = 0; same && j < runs.size(); j++) same = (saved.count(runs[j]) && saved[runs[j]] >= 0);
+	shard.assign(runs.size(),0);
+	if (same) {
+		for (size_t j = 0; j < runs.size(); j++) shard[j] = saved[runs[j]];
+		return true;
+	}
+
+	// entry counts from the veto chains (a run with none still counts as one)
+	vector<long> w(runs.size(),1);
+	long total = 0;
+	int nCounted = 0;
+	for (size_t j = 0; j < runs.size(); j++)
+	{
+		if (entries.count(runs[j]) == 0) {
+			GATDataSet ds(runs[j]);
+			TChain *v = ds.GetVetoChain();
+			entries[runs[j]] = (v != NULL) ? (long)v->GetEntries() : 0;
+			nCounted++;
+		}
+		if (entries[runs[j]] > 0) w[j] = entries[runs[j]];
+		total += w[j];
+	}
+	if (nCounted > 0) printf("Counted the entries of %i runs.\n",nCounted);
+
+	// Cut where the running total passes k/N.  A run goes in the shard that
+	// holds the middle of its entries.
+	long before = 0;
+	for (size_t j = 0; j < runs.size(); j++)
+	{
+		long double mid = before + 0.5L*w[j];
+		int s = (int)(mid * nShards / total);
+		shard[j] = (s < nShards) ? s : nShards-1;
+		before += w[j];
+	}
+
+	// write it next to where it's read, then move it into place
+	char tmp[300];
+	sprintf(tmp,"%s.%i.tmp",planName.c_str(),(int)getpid());
+	ofstream Plan(tmp);
+	Plan << "# " << nShards << " shards of " << Input << "\n";
+	Plan << "# run entries shard\n";
+	for (size_t j = 0; j < runs.size(); j++) Plan << runs[j] << " " << entries[runs[j]] << " " << shard[j] << "\n";
+	Plan.close();
+	if (rename(tmp,planName.c_str()) != 0) printf("Couldn't write %s\n",planName.c_str());
+
+	vector<long> load(nShards,0);
+	vector<int> nRuns(nShards,0);
+	for (size_t j = 0; j < runs.size(); j++) { load[shard[j]] += w[j]; nRuns[shard[j]]++; }
+	printf("Shard plan for %s (%i runs, %li entries): %s\n",Input.c_str(),(int)runs.size(),total,planName.c_str());
+	for (int s = 0; s < nShards; s++) printf("  shard %i: %i runs, %li entries\n",s,nRuns[s],load[s]);
+	return true;
+}
+
+bool MakeShardPlan(string Input, int nShards)
+{
+	vector<int> runs, shard;
+	return GetShardPlan(Input,nShards,runs,shard);
+}
+
+string GetShardList(string Input, int shard, int nShards)
+{
+	if (nShards < 1 || shard < 0 || shard >= nShards) {
+		printf("Bad shard: %i/%i (shards are numbered 0 to N-1)\n",shard,nShards);
+		return "";
+	}
+	vector<int> runs, plan;
+	if (!GetShardPlan(Input,nShards,runs,plan)) return "";
+
+	RunSet all, mine;
+	all.Load(Input);
+	for (size_t j = 0; j < runs.size(); j++)
+		if (plan[j] == shard) mine.Add(runs[j],all.GetSection(runs[j]));
+	if (mine.Empty()) {
+		printf("Shard %i of %i has no runs.\n",shard,nShards);
+		return "";
+	}
+
+	string Name = Input;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
+	string listName = "./output/"+ShardStem(Name,shard,nShards)+".txt";
+	ofstream List(listName.c_str());
+	List << "# shard " << shard << " of " << nShards << " of " << Input << "\n";
+	string section = "";
+	for (auto &r : mine.GetRanges())
+	{
+		string sec = mine.GetSection(r.lo);
+		if (sec != section) {
+			List << "@" << sec << "\n";
+			section = sec;
+		}
+		if (r.lo == r.hi) List << r.lo << "\n";
+		else List << r.lo << "-" << r.hi << "\n";
+	}
+	List.close();
+	printf("Shard %i of %i: runs %i to %i (%li runs), list %s\n",shard,nShards,mine.First(),mine.Last(),mine.Size(),listName.c_str());
+	return listName;
+}
+
+int LaunchShards(string Input, int nShards)
+{
+	if (nShards < 1 || !MakeShardPlan(Input,nShards)) return -2;
+	string Name = Input;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
+
+	// the cores are split between the shards
+	int threads = GetNumThreads() / nShards;
+	cout.flush();
+	fflush(stdout);
+	vector<pid_t> pids(nShards,-1);
+	for (int s = 0; s < nShards; s++)
+	{
+		pid_t pid = fork();
+		if (pid == 0) {
+			string logName = "./output/"+ShardStem(Name,s,nShards)+".log";
+			freopen(logName.c_str(),"w",stdout);
+			dup2(fileno(stdout),fileno(stderr));
+			SetNumThreads(threads > 1 ? threads : 1);
+			return s;
+		}
+		pids[s] = pid;
+		if (pid < 0) printf("Couldn't start shard %i!\n",s);
+	}
+	printf("Started %i shards of %s.  Logs: ./output/%s_shard*of%i.log\n",nShards,Input.c_str(),Name.c_str(),nShards);
+	fflush(stdout);
+
+	int nBad = 0;
+	for (int s = 0; s < nShards; s++)
+	{
+		if (pids[s] < 0) { nBad++; continue; }
+		int wstat = 0;
+		waitpid(pids[s],&wstat,0);
+		if (WIFEXITED(wstat) && WEXITSTATUS(wstat) == 0) printf("Shard %i: done\n",s);
+		else {
+			nBad++;
+			if (WIFSIGNALED(wstat)) printf("Shard %i: crashed (signal %i)\n",s,WTERMSIG(wstat));
+			else printf("Shard %i: exit code %i\n",s,WEXITSTATUS(wstat));
+		}
+		fflush(stdout);
+	}
+	if (nBad > 0) printf("%i of %i shards failed.  Their outputs will be missing from the merge.\n",nBad,nShards);
+	return -1;
+}
+
+// Join text files: comment lines that were already written are left out.
+static bool MergeText(string outName, vector<string> &parts)
+{
+	ofstream Out(outName.c_str());
+	if (!Out.good()) return false;
+	vector<string> comments;
+	for (auto &p : parts)
+	{
+		ifstream In(p.c_str());
+		string line;
+		while (getline(In,line)) {
+			if (!line.empty() && line[0] == '#') {
+				if (find(comments.begin(),comments.end(),line) != comments.end()) continue;
+				comments.push_back(line);
+			}
+			Out << line << "\n";
+		}
+	}
+	Out.close();
+	return true;
+}
+
+void vetoShardMerge(string Input)
+{
+	string Name = Input;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
+
+	map<int,long> entries;
+	map<int,int> shard;
+	string planName = ShardPlanName(Input);
+	int nShards = ReadShardPlan(planName,entries,shard);
+	if (nShards < 1) {
+		cout << "No shard plan " << planName << ".  Was this list scanned with --shard?\n";
+		return;
+	}
+
+	// Find each shard's outputs.  The canonical name has <Name> in place of
+	// <Name>_shard<i>of<N>.  The shard's own run list, logs and checkpoints
+	// aren't merged, and neither are directories (muFinder --split shards
+	// stay where their manifests say they are).
+	map<string, vector<string> > pieces;
+	DIR *d = opendir("./output");
+	if (d == NULL) {
+		cout << "Couldn't open ./output\n";
+		return;
+	}
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL)
+	{
+		string f = ent->d_name;
+		for (int s = 0; s < nShards; s++)
+		{
+			string stem = ShardStem(Name,s,nShards);
+			size_t pos = f.find(stem);
+			if (pos == string::npos) continue;
+			size_t end = pos + stem.size();
+			if ((pos > 0 && f[pos-1] != '_') || (end < f.size() && isdigit(f[end]))) continue;
+			if (f == stem+".txt" || f == stem+".log" || f.find("_ckpt") != string::npos || f.find(".tmp") != string::npos) continue;
+			struct stat st;
+			if (stat(("./output/"+f).c_str(),&st) != 0 || S_ISDIR(st.st_mode)) continue;
+			string canon = f;
+			canon.replace(pos,stem.size(),Name);
+			if (pieces[canon].size() == 0) pieces[canon].assign(nShards,"");
+			pieces[canon][s] = "./output/"+f;
+		}
+	}
+	closedir(d);
+	if (pieces.size() == 0) {
+		printf("No shard outputs for %s in ./output\n",Name.c_str());
+		return;
+	}
+
+	printf("Merging %i shards of %s:\n",nShards,Name.c_str());
+	for (auto &pc : pieces)
+	{
+		string outName = "./output/"+pc.first;
+		vector<string> parts;
+		for (auto &p : pc.second) if (p != "") parts.push_back(p);
+		string ext = pc.first.substr(pc.first.find_last_of(".")+1);
+		bool ok = true;
+		if (ext == "root") {
+			TFileMerger merger(kFALSE);
+			merger.SetFastMethod(kTRUE);
+			merger.OutputFile(outName.c_str(),"RECREATE");
+			for (auto &p : parts) merger.AddFile(p.c_str(),kFALSE);
+			ok = merger.Merge();
+		}
+		else if (ext == "txt") ok = MergeText(outName,parts);
+		else {
+			printf("  %s: can't merge .%s files, skipping.\n",pc.first.c_str(),ext.c_str());
+			continue;
+		}
+		printf("  %s: %i of %i shards%s\n",outName.c_str(),(int)parts.size(),nShards,ok ? "" : "  MERGE FAILED");
+	}
+
+	// results that need the whole data set
+	string vpName = "VP_"+Name+".root";
+	if (pieces.count(vpName)) vetoPerformanceMerge("./output/"+vpName);
+	string vtfName = "VTF_"+Name+"_spectra.root";
+	if (pieces.count(vtfName)) vetoThreshMerge("./output/"+vtfName);
+}
@@ -1,4 +1,67 @@
 #include "vetoScan.hh"
+#include "code/vetoHist.hh"
+#include "code/vetoErrorPolicy.hh"
+#include "code/RunSet.hh"
+
+// Output: Find the QDC Pedestal location in each channel.
+// Give a threshold that is 20 QDC above this location, and output a plot
+// that confirms this choice.
+static void ThreshFromSpectra(string Name, TH1F **hLowQDC, TH1F **hFullQDC, bool writeCanvas)
+{
+	// Draw full QDC spectrum
+	TCanvas *vcan1 = new TCanvas("vcan1","veto QDC, panels 1-32",0,0,800,600);
+	vcan1->Divide(8,4,0,0);
+	for (int i=0; i<32; i++)
+	{
+		vcan1->cd(i+1);
+		TVirtualPad *vpad1 = vcan1->cd(i+1); vpad1->SetLogy();
+		hFullQDC[i]->Draw();
+	}
+
+	// Draw threshold region of QDC spectrum
+	int thresh[32] = {9999};
+	TCanvas *vcan0 = new TCanvas("vcan0","veto QDC thresholds, panels 1-32",0,0,800,600);
+	vcan0->Divide(8,4,0,0);
+	for (int i=0; i<32; i++)
+	{
+		vcan0->cd(i+1);
+		TVirtualPad *vpad0 = vcan0->cd(i+1); vpad0->SetLogy();
+
+		// find overall threshold for this panel
+		thresh[i] = FindQDCThreshold(hLowQDC[i],i,true);
+
+		// reset histo range and draw
+		hLowQDC[i]->GetXaxis()->SetRange(0,hLowQDC[i]->GetNbinsX());
+		hLowQDC[i]->Draw();
+
+		double ymax = hLowQDC[i]->GetMaximum();
+		TLine *line = new TLine(thresh[i],0,thresh[i],ymax+10);
+		line->SetLineColor(kRed);
+		line->SetLineWidth(2.0);
+		line->Draw();		
+	}
+
+
+
+	// End of Scan Output
+
+	cout << "\nMeasured QDC thresholds:\n\n";
+	for (int r = 0; r < 32; r++) printf("[%i] %i  ",r,thresh[r]);
+	cout << "\n\n";
+
+	cout << Name << " ";
+	for (int r = 0; r < 32; r++) cout << thresh[r] << " ";
+	cout << "\n\n";
+    	
+   	// Write canvas
+	Char_t OutputName[200];	
+	sprintf(OutputName,"./output/SWThresh_%s.C",Name.c_str());
+	vcan0->Print(OutputName);
+
+	char fullSpecName[200];
+	sprintf(fullSpecName,"QDCSpectrum_%s",Name.c_str());
+	if (writeCanvas) vcan1->Write(fullSpecName,TObject::kOverwrite);
+}
 
 // I'm sick of programming in QDC thresholds by hand.
 // Figure them out for me, computer!
@@ -8,11 +71,8 @@
 void vetoThreshFinder(string Input, bool runHistos)
 {
 	// Input a list of run numbers
-	ifstream InputList(Input.c_str());
-	if(!InputList.good()) {
-    	cout << "Couldn't open " << Input << endl;
-    	return;
-    }
+	RunSet runs;
+	if (!runs.Load(Input)) return;
 
 	// Strip off path and extension: use for output files.
 	string Name = Input;
@@ -44,16 +104,17 @@ void vetoThreshFinder(string Input, bool runHistos)
 		sprintf(hname,"hFullQDC%d",i);
 		hFullQDC[i] = new TH1F(hname,hname,4200,0,4200);
 	}
+	// filled in the event loop, copied into the TH1's after the scan
+	VetoHistSet lowQDC(32,bins,lower,upper);
+	VetoHistSet fullQDC(32,4200,0,4200);
 	bool pedestalShift = false;
 	int runThresh[32] = {0};	// run-by-run threshold
 	int prevThresh[32] = {0};	
 		
-	int run = 0;
 	int filesScanned = 0;
-	while(!InputList.eof()){
+	for (int run : runs) {
 
 		// initialize 
-		InputList >> run;
 		GATDataSet *ds = new GATDataSet(run);
 
 		// standard veto initialization block
@@ -80,6 +141,8 @@ void vetoThreshFinder(string Input, bool runHistos)
 			sprintf(hname,"hRunQDC%d",i);
 			hRunQDC[i] = new TH1F(hname,hname,bins,lower,upper);
 		}
+		VetoHistSet runQDC(32,bins,lower,upper);
+		int qdc[32];
 
 		long skippedEvents = 0;
 		int isGood = 0;
@@ -91,18 +154,21 @@ void vetoThreshFinder(string Input, bool runHistos)
 			MJVetoEvent veto;
 			veto.SetSWThresh(def);	
 	    	isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run,true);
-	    	if (CheckForBadErrors(veto,i,isGood,false)) {
+	    	if (GetErrorPolicy().Check(veto,i,isGood)) {
 	    		skippedEvents++;
 	    		continue;
 	    	}
 
 	    	// Fill raw histogram under 500
-	    	for (int q = 0; q < 32; q++) {
-	    		hLowQDC[q]->Fill(veto.GetQDC(q));
-	    		hRunQDC[q]->Fill(veto.GetQDC(q));
-	    		hFullQDC[q]->Fill(veto.GetQDC(q));
-			}
+	    	for (int q = 0; q < 32; q++) qdc[q] = veto.GetQDC(q);
+	    	lowQDC.Push(qdc);
+	    	runQDC.Push(qdc);
+	    	fullQDC.Push(qdc);
 		}
+		lowQDC.Flush();
+		runQDC.Flush();
+		fullQDC.Flush();
+		for (int c = 0; c < 32; c++) runQDC[c].CopyTo(hRunQDC[c]);
 		if (skippedEvents > 0) printf("Skipped %li of %li entries.\n",skippedEvents,vEntries);
 
 		// Set up a 32-panel plot for each run if runHistos = true.
@@ -148,46 +214,22 @@ void vetoThreshFinder(string Input, bool runHistos)
 	}
 	cout << "\n==================== End of Scan. ====================\n\n";
 
-	// Output: Find the QDC Pedestal location in each channel.
-	// Give a threshold that is 20 QDC above this location, and output a plot
-	// that confirms this choice.
-
-	// Draw full QDC spectrum
-	TCanvas *vcan1 = new TCanvas("vcan1","veto QDC, panels 1-32",0,0,800,600);
-	vcan1->Divide(8,4,0,0);
-	for (int i=0; i<32; i++)
-	{
-		vcan1->cd(i+1);
-		TVirtualPad *vpad1 = vcan1->cd(i+1); vpad1->SetLogy();
-		hFullQDC[i]->Draw();
+	for (int i = 0; i < 32; i++) {
+		lowQDC[i].CopyTo(hLowQDC[i]);
+		fullQDC[i].CopyTo(hFullQDC[i]);
 	}
 
-	// Draw threshold region of QDC spectrum
-	int thresh[32] = {9999};
-	TCanvas *vcan0 = new TCanvas("vcan0","veto QDC thresholds, panels 1-32",0,0,800,600);
-	vcan0->Divide(8,4,0,0);
-	for (int i=0; i<32; i++)
-	{
-		vcan0->cd(i+1);
-		TVirtualPad *vpad0 = vcan0->cd(i+1); vpad0->SetLogy();
-
-		// find overall threshold for this panel
-		thresh[i] = FindQDCThreshold(hLowQDC[i],i,true);
-
-		// reset histo range and draw
-		hLowQDC[i]->GetXaxis()->SetRange(lower,upper);
-		hLowQDC[i]->Draw();
-
-		double ymax = hLowQDC[i]->GetMaximum();
-		TLine *line = new TLine(thresh[i],0,thresh[i],ymax+10);
-		line->SetLineColor(kRed);
-		line->SetLineWidth(2.0);
-		line->Draw();		
+	// Keep the summed spectra, so the shards of a batch array can be added
+	// up and the thresholds found again (vetoScan --merge).
+	sprintf(OutputFile,"./output/VTF_%s_spectra.root",Name.c_str());
+	TFile *SpecFile = new TFile(OutputFile,"RECREATE");
+	for (int i = 0; i < 32; i++) {
+		hLowQDC[i]->Write(hLowQDC[i]->GetName(),TObject::kOverwrite);
+		hFullQDC[i]->Write(hFullQDC[i]->GetName(),TObject::kOverwrite);
 	}
-
-
-
-	// End of Scan Output
+	SpecFile->Close();
+	delete SpecFile;
+	if (runHistos) RootFile->cd();
 
 	if (pedestalShift) {
 		printf("Warning: Found a pedestal shift by more than 5%% of its previous value.\n");
@@ -195,22 +237,43 @@ void vetoThreshFinder(string Input, bool runHistos)
 		printf("         It can be caused by including a run with very few entries.\n");
 	}
 
-	cout << "\nMeasured QDC thresholds:\n\n";
-	for (int r = 0; r < 32; r++) printf("[%i] %i  ",r,thresh[r]);
-	cout << "\n\n";
+	ThreshFromSpectra(Name,hLowQDC,hFullQDC,runHistos);
 
-	cout << Name << " ";
-	for (int r = 0; r < 32; r++) cout << thresh[r] << " ";
-	cout << "\n\n";
-    	
-   	// Write canvas
-	Char_t OutputName[200];	
-	sprintf(OutputName,"./output/SWThresh_%s.C",Name.c_str());
-	vcan0->Print(OutputName);
+	if (runHistos) RootFile->Close();
+}
 
-	char fullSpecName[200];
-	sprintf(fullSpecName,"QDCSpectrum_%s",Name.c_str());
-	if(runHistos) vcan1->Write(fullSpecName,TObject::kOverwrite); 
+// Thresholds from merged spectra (vetoScan --merge), as if the data set was scanned in one go.
+void vetoThreshMerge(string file)
+{
+	TFile *f = TFile::Open(file.c_str());
+	if (f == NULL) {
+		cout << "Couldn't open " << file << endl;
+		return;
+	}
+	TH1F *hLowQDC[32];
+	TH1F *hFullQDC[32];
+	char hname[50];
+	for (int i = 0; i < 32; i++) {
+		hLowQDC[i] = hFullQDC[i] = NULL;
+		sprintf(hname,"hLowQDC%d",i);
+		f->GetObject(hname,hLowQDC[i]);
+		sprintf(hname,"hFullQDC%d",i);
+		f->GetObject(hname,hFullQDC[i]);
+		if (hLowQDC[i] == NULL || hFullQDC[i] == NULL) {
+			printf("Missing %s in %s\n",hname,file.c_str());
+			f->Close();
+			return;
+		}
+	}
 
-	if (runHistos) RootFile->Close();
-}
\ No newline at end of file
+	// VTF_<Name>_spectra.root
+	string Name = file;
+	Name.erase(Name.find_last_of("."),string::npos);
+	Name.erase(0,Name.find_last_of("\\/")+1);
+	if (Name.find("VTF_") == 0) Name.erase(0,4);
+	if (Name.find("_spectra") != string::npos) Name.erase(Name.find("_spectra"),string::npos);
+
+	cout << "\n==================== Thresholds for " << Name << " ====================\n\n";
+	ThreshFromSpectra(Name,hLowQDC,hFullQDC,false);
+	f->Close();
+}
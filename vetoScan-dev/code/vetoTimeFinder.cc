@@ -1,4 +1,6 @@
 #include "vetoScan.hh"
+#include "code/vetoErrorPolicy.hh"
+#include "code/RunSet.hh"
 using namespace std;
 /*
 	Methods of calculating time of veto events:
@@ -11,17 +13,18 @@ using namespace std;
 
 void vetoTimeFinder(string file) 
 {
+	// The time methods are only compared on entries whose only problem
+	// (if any) is a bad scaler, so every error the policy warns about is fatal here.
+	VetoErrorPolicy errPolicy(GetErrorPolicy());
+	for (int q = 0; q < VetoErrorPolicy::nErrs; q++)
+		if (q != 4 && errPolicy.GetAction(q) == kErrWarn) errPolicy.SetAction(q,kErrFatal);
+
 	// Input a list of run numbers
-	ifstream InputList(file.c_str());
-	if(!InputList.good()) {
-    	cout << "Couldn't open " << file << endl;
-    	return;
-    }
+	RunSet runs;
+	if (!runs.Load(file)) return;
 	
-	int run = 0;
-	while(!InputList.eof())
+	for (int run : runs)
 	{
-		InputList >> run;
 
 		// standard initialization
 		GATDataSet *ds = new GATDataSet(run);
@@ -140,21 +143,10 @@ void vetoTimeFinder(string file)
 			veto.SetSWThresh();	
 	    	isGood = veto.WriteEvent(i,vRun,vEvent,vBits,run);
 
-	    	if (isGood != 1) 
-	    	{
-				int error[18] = {0};
-	    		veto.UnpackErrorCode(isGood,error);
-	    		bool worseProblems = false;
-	    		for (int q=0; q<18; q++) 
-	    		{
-	    			// don't skip bad-scaler events
-	    			if (q!=4 && error[q] == 1) worseProblems = true;
-	    		}
-	    		if (worseProblems) {
-	    			cout << "Skipped Entry: " << i  << endl;
-	    			// if (i < 500) veto.Print();
-	    			continue;
-	    		}
+	    	if (errPolicy.Check(veto,i,isGood)) {
+	    		cout << "Skipped Entry: " << i  << endl;
+	    		// if (i < 500) veto.Print();
+	    		continue;
 	    	}
 
 			// ---------------------------------------------
@@ -2,7 +2,14 @@
 // Processing Functions
 // ==================================================
 
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "TROOT.h"
 #include "vetoScan.hh"
+#include "code/vetoErrorPolicy.hh"
+#include "code/RunSet.hh"
 using namespace std;
 
 void Test()
@@ -36,23 +43,10 @@ long GetStopUnixTime(GATDataSet ds)
 
 int GetNumFiles(string arg)
 {
-	int run = 0; 
-
-	ifstream InputList;
-	InputList.open(arg.c_str());
-	if(!InputList.good()) {
-    	cout << "Couldn't open " << arg << " !" << endl;
-    	return 0;
-    }
-
-	int filesToScan = 0;
-  	while(!InputList.eof()) { 
-  		InputList >> run; 
-  		filesToScan++; 
-  	}
-  	cout << "Scanning " << filesToScan << " files." << endl;	  	
-  	InputList.close();
-  	
+	RunSet runs;
+	if (!runs.Load(arg)) return 0;
+	int filesToScan = (int)runs.Size();
+  	cout << "Scanning " << filesToScan << " files." << endl;
   	return filesToScan;
 }
 
@@ -128,38 +122,11 @@ int PanelMap(int i){
 }
 
 // MJVetoEvent "error filter" - analysis codes skip events which fail
-// the cuts here.  Returns true if there is a bad error.
-bool CheckForBadErrors(MJVetoEvent veto, int entry, int isGood, bool verbose) 
+// the policy's fatal errors.  Set up once in main (vetoErrorPolicy.txt).
+VetoErrorPolicy& GetErrorPolicy()
 {
-	bool badError = false;
-
-	if (isGood != 1) {
-		int error[18] = {0};
-		veto.UnpackErrorCode(isGood,error);
-		
-		// search for particular errors and set a flag.
-		for (int q=0; q<18; q++) 
-		{
-			// 4: don't skip bad-scaler events
-			// 10: P3K93: don't skip "event count doesn't match ROOT entry" events
-			// 7 & 11: don't skip hw count mismatches or scaler != qdc event count.  Due to problems with continuous running mode.
-
-			// if (q!=4 && q!=10 && error[q] == 1) badError = true;
-			if (q != 4 && q != 7 && q != 10 && q != 11 && q != 12 && error[q] == 1) badError = true;
-		}
-		
-		if (badError) {
-			if (verbose == true) {
-				cout << "Skipped Entry: " << entry << endl;
-				veto.Print();
-				cout << endl;
-			}
-			return badError;
-		}
-	}
-	else return badError;	// no bad errors found
-
-	return false;
+	static VetoErrorPolicy policy;
+	return policy;
 }
 
 // Place threshold 35 qdc above pedestal location.
@@ -275,4 +242,124 @@ double InterpTime(int entry, vector<double> times, vector<double> entries, vecto
 	}
 
 	return iTime;
-}
\ No newline at end of file
+}
+// Number of worker threads used by the parallel routines.
+// Set with -j on the command line, defaults to the number of cores.
+static int gVetoThreads = 0;
+
+void SetNumThreads(int n)
+{
+	gVetoThreads = n;
+}
+
+int GetNumThreads()
+{
+	if (gVetoThreads > 0) return gVetoThreads;
+	int n = (int)thread::hardware_concurrency();
+	return (n > 0) ? n : 1;
+}
+
+// Run job(0) ... job(nJobs-1) on a pool of worker threads.
+// Jobs are handed out one at a time, so uneven jobs (long runs vs. short runs)
+// still keep every thread busy.  Each job must only touch its own output.
+void RunParallel(int nJobs, function<void(int)> job)
+{
+	int nThreads = min(GetNumThreads(), nJobs);
+	if (nThreads <= 1) {
+		for (int i = 0; i < nJobs; i++) job(i);
+		return;
+	}
+	ROOT::EnableThreadSafety();
+
+	atomic<int> next(0);
+	vector<thread> pool;
+	for (int t = 0; t < nThreads; t++) {
+		pool.push_back(thread([&]() {
+			int i;
+			while ((i = next++) < nJobs) job(i);
+		}));
+	}
+	for (auto &th : pool) th.join();
+}
+
+// Read a shard manifest written by muFinder (-m with --split).
+// Each line is: shardFile listFile firstRun lastRun nRuns entries
+// A single .root file is also accepted, and is treated as a one-shard manifest.
+vector<string> GetShardFiles(string manifest)
+{
+	vector<string> files;
+	if (manifest.size() > 5 && manifest.substr(manifest.size()-5) == ".root") {
+		files.push_back(manifest);
+		return files;
+	}
+	ifstream InputList(manifest.c_str());
+	if(!InputList.good()) {
+		cout << "Couldn't open " << manifest << endl;
+		return files;
+	}
+	string line;
+	while (getline(InputList,line))
+	{
+		if (line.empty() || line[0] == '#') continue;
+		stringstream ss(line);
+		string shard;
+		ss >> shard;
+		if (shard != "") files.push_back(shard);
+	}
+	return files;
+}
+
+// Only read the listed branches from a tree.
+// Split MJVetoEvent members ("run", "multip", ...) can be given by name.
+void SetActiveBranches(TTree *t, vector<string> names)
+{
+	t->SetBranchStatus("*",0);
+	for (auto &name : names)
+	{
+		// SetBranchStatus takes a wildcard, so "CoinType[32]" has to become "CoinType*"
+		string pattern = name;
+		if (pattern.find('[') != string::npos) pattern = pattern.substr(0,pattern.find('['))+"*";
+
+		if (t->GetBranch(name.c_str())) t->SetBranchStatus(pattern.c_str(),1);
+		else if (t->GetBranch(("events."+name).c_str())) t->SetBranchStatus(("events."+name).c_str(),1);
+		else cout << "SetActiveBranches: couldn't find branch " << name << endl;
+	}
+}
+
+// Save a checkpoint (one line of numbers) so an interrupted scan can be resumed.
+// The file is written to a temp file and renamed, so a crash never leaves
+// a half-written checkpoint behind.
+void WriteCheckpoint(string file, vector<double> vals)
+{
+	string tmp = file + ".tmp";
+	FILE *f = fopen(tmp.c_str(),"w");
+	if (f == NULL) {
+		cout << "Couldn't write checkpoint " << tmp << endl;
+		return;
+	}
+	for (auto v : vals) fprintf(f,"%.17g ",v);
+	fprintf(f,"\n");
+	fflush(f);
+	fsync(fileno(f));
+	fclose(f);
+	rename(tmp.c_str(),file.c_str());
+}
+
+// Returns an empty vector if there's no checkpoint.
+vector<double> ReadCheckpoint(string file)
+{
+	vector<double> vals;
+	ifstream InputList(file.c_str());
+	if (!InputList.good()) return vals;
+	double v;
+	while (InputList >> v) vals.push_back(v);
+	return vals;
+}
+
+// Size of a file in bytes (-1 if it doesn't exist)
+long GetFileSize(string file)
+{
+	struct stat st;
+	if (stat(file.c_str(),&st) != 0) return -1;
+	return (long)st.st_size;
+}
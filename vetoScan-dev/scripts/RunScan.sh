@@ -19,8 +19,7 @@ echo $1
 cd /global/u1/w/wisecg/vetoScan/
 echo job start
 date
-make clean
-make --quiet
+# build once before submitting (make), not in every job
 ./vetoScan ./runs/$1
 echo job end
 date
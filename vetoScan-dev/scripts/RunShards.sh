@@ -0,0 +1,28 @@
+#!/bin/csh -f
+#$ -cwd
+#$ -j y
+#$ -o /global/u1/w/wisecg/vetoScan/output
+#$ -P majorana
+
+source /etc/profile.d/modules.csh
+source /common/majorana/scripts/setupMajorana.csh
+source /global/u1/w/wisecg/ManualSetup.csh
+
+# One task of an array job: scans piece (SGE_TASK_ID-1) of N of a run list.
+# Build and make the shard plan once, submit the array, then merge:
+# 1. make
+#    ./vetoScan -F ./runs/DS0.txt -n 5
+# 2. qsub -t 1-5 RunShards.sh DS0.txt 5 -p totals -m list
+# 3. ./vetoScan -F ./runs/DS0.txt -q
+# (On one machine, ./vetoScan -F ./runs/DS0.txt -a 5 -p totals -m list does all three.)
+
+set list = $1
+set nShards = $2
+@ shard = $SGE_TASK_ID - 1
+
+cd /global/u1/w/wisecg/vetoScan/
+echo job start: shard $shard of $nShards of $list
+date
+./vetoScan -F ./runs/$list -n $shard/$nShards $argv[3-]
+echo job end
+date
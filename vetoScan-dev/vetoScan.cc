@@ -5,6 +5,8 @@
 // Andrew Lopez, UTK/Majorana
 
 #include "vetoScan.hh"
+#include "code/RunWatcher.hh"
+#include "code/vetoErrorPolicy.hh"
 
 using namespace std;
 
@@ -12,19 +14,26 @@ static const char Usage[] =
 "\n"
 "Usage: vetoScan [options].\n"
 "     REQUIRED for most routines : \n"
-"     -F (--file) ./path/to/your/runList.txt\n\n"
+"     -F (--file) ./path/to/your/runList.txt\n"
+"                 (runs, ranges like 2688-2790, and include/exclude/intersect lines: see code/RunSet.hh)\n\n"
 "Additional options:\n"
 "     -h (--help) : Print usage info\n"
 "     -S (--serial) : Set the part number (P3JDY, etc.)  REQUIRED to use checkFiles.\n"
 "     -f (--checkFiles) : Check that files exist.\n"
 "                       : Options: `checkBuilt`, `checkGAT`, `checkBoth`, `checkGDS`, `checkAll`\n" 
+"                       : `checkQuick` only probes the headers of both files without opening them in ROOT.\n"
 "                       : (checkBuilt and checkGAT both require PDSF)\n"
 "     -H (--findThresh) : Find QDC software thresholds for a set of runs.\n"
 "                       : Options: `runs` or `totals`\n"
 "     -T (--swThresh) : Set QDC software threshold using `vetoSWThresholds.txt`\n"
+"     -e (--errPolicy) : Which entry of `vetoErrorPolicy.txt` decides the skipped errors\n"
+"                      : (default: the -F list name, then `default`)\n"
 "     -m (--muFinder) : Scan runs for muons.\n"
 "                     : If -T is specified, user picks which SW thresholds to use.\n"
 "                     : Output options: `root`,`list`,`both`\n"
+"     -y (--twoPass) : muFinder: measure each run's LED period with a full first pass,\n"
+"                    : instead of locking onto the LEDs as it goes (see code/LEDTracker.hh)\n"
+"                    : or starting from the last run's LED period (code/RunState.hh)\n"
 "     -p (--perfCheck) : Veto performance check (data quality).\n"
 "                      : Option: `runs`, `totals`\n"
 "                      : If -T is specified, user picks which SW thresholds to use.\n"
@@ -32,12 +41,35 @@ static const char Usage[] =
 "     -u (--duration) : Find duration (in seconds) of file list.\n"
 "     -l (--findLED) : Find veto LED events.\n"
 "     -d (--dead) : Calculate Ge dead time from a muon list.\n"
-"     -o (--plot) : Run muPlotter\n"
-"     -r (--parse) : Run muParser\n"
+"     -o (--plot) : Quick plots from muFinder output (-F takes a ROOT file or manifest)\n"
+"     -P (--plotSpec) : Plot spec file for muPlotter (one plot per line: name x[:y] nx xlo xhi [ny ylo yhi] [cut])\n"
+"     -r (--parse) : Muon rate and live time per time bin (-F takes a muFinder manifest/ROOT file or a MuonList)\n"
+"     -B (--rateBin) : Bin width for muParser: `hour`, `day` (default), `week`, or seconds\n"
 "     -G (--geCoins) : run muGeCoins\n"
-"     -D (--dispList) : Create veto hit list for vetoDisplay code\n"
+"     -D (--dispList) : Create veto hit list for vetoDisplay code (-F takes a muFinder ROOT file or manifest)\n"
+"     -x (--hitFormat) : Hit list format: `text` (default) or `binary`\n"
+"     -b (--build) : Build veto events from the built data's QDC/scaler packets (needs -S part number)\n"
+"                  : Writes ./output/Name_built/ and the mismatch counts in ./output/vetoBuilt_Name.txt\n"
+"     -c (--coinMask) : Hit list entries: bitmask of CoinTypes to list (default 1 = CoinType[0])\n"
 "     -L (--vetoList) : Create veto hit list for DEMONSTRATOR Veto Cut\n"
+"                     : (-F takes a muFinder manifest or ROOT file)\n"
 "     -s (--muSimple) : Run a simplified version of muFinder\n"
+"     -j (--threads) : Number of worker threads for the parallel routines (default: all cores)\n"
+"                   : (muFinder uses them inside each run: decoding in parallel, cuts in order)\n"
+"     -k (--split) : Split muFinder output into shards of N runs (1 = one shard per run)\n"
+"                  : Writes ./output/Name_manifest.txt for muMerge and vetoList.\n"
+"     -M (--muMerge) : Merge muFinder shards (-F Name_manifest.txt) and build the muon list\n"
+"     -w (--follow) : Follow a data directory and process runs as they finish (with -m or -p).\n"
+"                   : Appends to the muon list / VP summary after each run.  Touch DIR/STOP to end.\n"
+"     -W (--since) : When following, ignore runs below this run number.\n"
+"     -R (--resume) : Continue an interrupted muFinder or perfCheck job from its last checkpoint.\n"
+"     -I (--isolate) : Run muFinder with one worker process per run, killing workers after N seconds.\n"
+"                    : Failed runs are quarantined (./output/Name_quarantine.txt).  Writes a shard manifest.\n"
+"     -n (--shard) : i/N: run the selected routines on piece i (0 to N-1) of N of the -F list.\n"
+"                  : The pieces are contiguous and have about the same number of entries.\n"
+"                  : N alone: just write the plan (./output/Name_shardplan.txt), e.g. before submitting an array job.\n"
+"     -q (--merge) : Merge the shard outputs of the -F list into the usual ./output/ files.\n"
+"     -a (--launch) : Run N shards as local processes (the -j threads are split between them), then merge.\n"
 "\n";
 
 int main(int argc, char** argv) 
@@ -52,9 +84,23 @@ int main(int argc, char** argv)
 	//
 	string file = "", partNum = "", threshName = "";
 	bool findMuons=0, perfCheck=0, fileCheck=0, findTime=0,findLED=0,findThresh=0,deadTime=0,durationCheck=0;
-	bool muPlot=0, muParse=0,checkBuilt=0,checkGAT=0,checkGDS=0,root=0,list=0;
+	bool muPlot=0, muParse=0,checkBuilt=0,checkGAT=0,checkGDS=0,root=0,list=0,openFiles=1;
 	bool runBreakdowns=0,geCoins=0,muList=0,vetoCutList=0;
-	bool muSimp=0;
+	bool muSimp=0,muMrg=0;
+	int runsPerShard=0;
+	string followDir = "";
+	int sinceRun = 0;
+	bool resume=0;
+	int isoTimeout=0;
+	string rateBin = "day";
+	string plotSpec = "";
+	bool hitBinary=0;
+	unsigned int coinMask=1;
+	bool buildEvents=0;
+	string policyName = "";
+	int shard=-1, nShards=0, nLaunch=0;
+	bool mergeShards=0;
+	bool twoPass=0;
 	//
 	int c;
 	int option_index = 0;
@@ -78,11 +124,28 @@ int main(int argc, char** argv)
 			{"geCoins", required_argument, 0, 'G'},
 			{"dispList", no_argument,0,'D'},
 			{"vetoList", no_argument, 0, 'L'},
-			{"muSimple", no_argument, 0, 's'}
+			{"muSimple", no_argument, 0, 's'},
+			{"threads", required_argument, 0, 'j'},
+			{"split", required_argument, 0, 'k'},
+			{"muMerge", no_argument, 0, 'M'},
+			{"follow", required_argument, 0, 'w'},
+			{"since", required_argument, 0, 'W'},
+			{"resume", no_argument, 0, 'R'},
+			{"isolate", required_argument, 0, 'I'},
+			{"rateBin", required_argument, 0, 'B'},
+			{"plotSpec", required_argument, 0, 'P'},
+			{"hitFormat", required_argument, 0, 'x'},
+			{"coinMask", required_argument, 0, 'c'},
+			{"build", no_argument, 0, 'b'},
+			{"errPolicy", required_argument, 0, 'e'},
+			{"shard", required_argument, 0, 'n'},
+			{"merge", no_argument, 0, 'q'},
+			{"launch", required_argument, 0, 'a'},
+			{"twoPass", no_argument, 0, 'y'}
 		};
 
 		// don't forget to add a new option here too!
-		c = getopt_long (argc, argv, "hF:S:f:H:T:m:p:tldorGDLsu",long_options,&option_index);
+		c = getopt_long (argc, argv, "hF:S:f:H:T:m:p:tldorGDLsuj:k:Mw:W:RI:B:P:x:c:be:n:qa:y",long_options,&option_index);
 		if (c == -1) break;
 
 		switch (c)
@@ -105,6 +168,7 @@ int main(int argc, char** argv)
 			else if (string(optarg) == "checkGDS")		checkGDS=1;
 			else if (string(optarg) == "checkBoth") {	checkBuilt=1; checkGAT=1; }
 			else if (string(optarg) == "checkAll")  {	checkBuilt=1; checkGAT=1; checkGDS=1; }
+			else if (string(optarg) == "checkQuick") {	checkBuilt=1; checkGAT=1; openFiles=0; }
 			printf("Checking for ... built? %i  gatified? %i  GATDataSet? %i\n",checkBuilt,checkGAT,checkGDS);
 			break;
 		case 'H':
@@ -137,6 +201,25 @@ int main(int argc, char** argv)
 		case 'D': muList=1; break;
 		case 'L': vetoCutList=1; break;
 		case 's': muSimp=1; break;
+		case 'j': SetNumThreads(atoi(optarg)); break;
+		case 'k': runsPerShard=atoi(optarg); break;
+		case 'M': muMrg=1; break;
+		case 'w': followDir = string(optarg); break;
+		case 'W': sinceRun = atoi(optarg); break;
+		case 'R': resume=1; break;
+		case 'I': isoTimeout = atoi(optarg); break;
+		case 'B': rateBin = string(optarg); break;
+		case 'P': plotSpec = string(optarg); break;
+		case 'x': hitBinary = (string(optarg) == "binary"); break;
+		case 'b': buildEvents=1; break;
+		case 'c': coinMask = (unsigned int)strtoul(optarg,NULL,0); break;
+		case 'e': policyName = string(optarg); break;
+		case 'n':
+			if (sscanf(optarg,"%i/%i",&shard,&nShards) != 2) { shard = -1; nShards = atoi(optarg); }
+			break;
+		case 'q': mergeShards=1; break;
+		case 'a': nLaunch = atoi(optarg); break;
+		case 'y': twoPass=1; break;
 		case '?':
 		    if (isprint (optopt))  fprintf (stderr, "Unknown option `-%c'.\n", optopt);
 		    else fprintf (stderr,"Unknown option character `\\x%x'.\n",optopt);
@@ -152,20 +235,76 @@ int main(int argc, char** argv)
 	//
 	int thresh[32] = {0};
 
-	if (fileCheck) 	vetoFileCheck(file,partNum,checkBuilt,checkGAT,checkGDS);
+	// Live-follow mode.  The outputs are named after -F if given.
+	if (followDir != "" && file == "") file = "LiveFollow.txt";
+
+	// Which errors make an entry unusable, per data set.  It's looked up once,
+	// by the whole list's name, and kept for everything below: the shards, the
+	// isolated workers (forked, with their own per-run lists) and the follower.
+	if (policyName == "") {
+		policyName = file;
+		if (policyName.find_last_of(".") != string::npos) policyName.erase(policyName.find_last_of("."),string::npos);
+		policyName.erase(0,policyName.find_last_of("\\/")+1);
+	}
+	if (GetErrorPolicy().Load(policyName)) cout << "Using error policy: " << GetErrorPolicy().GetName() << endl;
+	else cout << "No \"" << policyName << "\" or default error policy in vetoErrorPolicy.txt, using the built-in one." << endl;
+
+	// Sharded scans.  Each shard runs the routines on its own piece of the list,
+	// so the outputs are named after the piece.  The thresholds (like the error
+	// policy above) still come from the whole list's name.
+	if (mergeShards) {
+		vetoShardMerge(file);
+		cout << "\nCletus codes good." << endl;
+		return 0;
+	}
+	if (nLaunch > 0) {
+		// the children carry on below with their shard, the parent merges
+		shard = LaunchShards(file,nLaunch);
+		if (shard == -2) return 1;
+		if (shard == -1) {
+			vetoShardMerge(file);
+			cout << "\nCletus codes good." << endl;
+			return 0;
+		}
+		nShards = nLaunch;
+	}
+	if (nShards > 0)
+	{
+		if (shard < 0) return MakeShardPlan(file,nShards) ? 0 : 1;
+		if (threshName == "") {
+			threshName = file;
+			if (threshName.find_last_of(".") != string::npos) threshName.erase(threshName.find_last_of("."),string::npos);
+			threshName.erase(0,threshName.find_last_of("\\/")+1);
+		}
+		file = GetShardList(file,shard,nShards);
+		if (file == "") return 0;	// nothing in this shard
+	}
+
+	RunWatcher *follow = NULL;
+	if (followDir != "") {
+		follow = new RunWatcher(followDir,sinceRun);
+		if (perfCheck && findMuons) {
+			cout << "Warning: only one routine can follow at a time.  Running perfCheck.\n";
+			findMuons = 0;
+		}
+	}
+
+	if (fileCheck) 	vetoFileCheck(file,partNum,checkBuilt,checkGAT,checkGDS,openFiles);
+	if (buildEvents) vetoBuilder(file,partNum);
 	if (findTime)	vetoTimeFinder(file);
 	if (findThresh)	vetoThreshFinder(file,runBreakdowns);
 	if (perfCheck)	
 	{	
 		if (threshName != "") GetQDCThreshold(file,thresh,threshName);
 		else GetQDCThreshold(file,thresh);
-		vetoPerformance(file,thresh,runBreakdowns);
+		vetoPerformance(file,thresh,runBreakdowns,follow,resume);
 	}
 	if (findMuons) 
 	{  	
 		if (threshName != "") GetQDCThreshold(file,thresh,threshName);
 		else GetQDCThreshold(file,thresh);
-		muFinder(file,thresh,root,list);
+		if (isoTimeout > 0 && follow == NULL) muFinderIsolated(file,thresh,list,isoTimeout);
+		else muFinder(file,thresh,root,list,runsPerShard,follow,resume,twoPass);
 	}
 	if (muSimp) 
 	{  	
@@ -176,11 +315,14 @@ int main(int argc, char** argv)
 	if (findLED) 	vetoLEDFinder(file);
 	if (deadTime) 	muonDeadTime(file);
 	if (durationCheck) durationChecker(file);
-	if (muPlot)		muPlotter(file);
-	if (muParse)	muParser(file);
+	if (muPlot)		muPlotter(file,plotSpec);
+	if (muParse)	muParser(file,rateBin);
 	if (geCoins)	muGeCoins(file);
-	if (muList)		muDisplayList(file);
+	if (muList)		muDisplayList(file,hitBinary,coinMask);
 	if (vetoCutList) muListGen(file);
+	if (muMrg)		muMerge(file);
+	if (follow != NULL) delete follow;
+	GetErrorPolicy().PrintCounts();
 
 	// =======================================================
 
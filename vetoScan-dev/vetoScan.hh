@@ -14,6 +14,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <string>
+#include <vector>
+#include <functional>
 #include "getopt.h"
 
 #include "TFile.h"
@@ -44,26 +46,48 @@ int GetNumFiles(string arg);
 int color(int i);
 int PanelMap(int i);
 int* GetQDCThreshold(string file, int *arr, string name = "");
-bool CheckForBadErrors(MJVetoEvent veto, int entry, int isGood, bool deactivate);
 int FindQDCThreshold(TH1F *qdcHist, int panel, bool verbose);
 double InterpTime(int entry, vector<double> times, vector<double> entries, vector<bool> badScaler);
+void SetNumThreads(int n);
+int GetNumThreads();
+void RunParallel(int nJobs, function<void(int)> job);
+vector<string> GetShardFiles(string manifest);
+void SetActiveBranches(TTree *t, vector<string> names);
+void WriteCheckpoint(string file, vector<double> vals);
+vector<double> ReadCheckpoint(string file);
+long GetFileSize(string file);
+vector<int> RunIsolated(string Input, function<void(string)> job, int timeout, function<string(int)> output = nullptr);
+class RunWatcher;	// code/RunWatcher.hh
+class VetoErrorPolicy;	// code/vetoErrorPolicy.hh
+VetoErrorPolicy& GetErrorPolicy();
 
 // Analysis
-void vetoFileCheck(string file = "", string partNum = "", bool checkBuilt = true, bool checkGat = true, bool checkGDS = false);
-void vetoPerformance(string file, int *thresh = NULL, bool runBreakdowns = false);
+void vetoFileCheck(string file = "", string partNum = "", bool checkBuilt = true, bool checkGat = true, bool checkGDS = false, bool openFiles = true);
+void vetoPerformance(string file, int *thresh = NULL, bool runBreakdowns = false, RunWatcher *follow = NULL, bool resume = false);
+void vetoPerformanceMerge(string file);
 void vetoThreshFinder(string arg, bool runHistos = false);
-void muFinder(string file, int *thresh = NULL, bool root = false, bool list = false);
+void vetoThreshMerge(string file);
+void muFinder(string file, int *thresh = NULL, bool root = false, bool list = false, int runsPerShard = 0, RunWatcher *follow = NULL, bool resume = false, bool twoPass = false);
+void muMerge(string manifest);
+void muFinderIsolated(string file, int *thresh = NULL, bool list = false, int timeout = 3600);
+void vetoBuilder(string file, string partNum, int window = 64);
+
+// Batch arrays (code/vetoShards.cc)
+bool MakeShardPlan(string Input, int nShards);
+string GetShardList(string Input, int shard, int nShards);
+int LaunchShards(string Input, int nShards);
+void vetoShardMerge(string Input);
 
 // In development
 void GrabVetoTree(string file);
 void muGeCoins(string Input);
-void muParser(string arg);
+void muParser(string arg, string binning = "day");
 void durationChecker(string file);
 void muonDeadTime(string file);
-void muPlotter(string arg);
+void muPlotter(string arg, string specFile = "");
 void vetoLEDFinder(string file);
 void vetoTimeFinder(string file);
-void muDisplayList(string file);
+void muDisplayList(string file, bool binary = false, unsigned int coinMask = 1);
 void muListGen(string file);
 void muSimple(string file, int *thresh = NULL);
 